@@ -3,9 +3,13 @@
 #include <fc/io/raw.hpp>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/sync/lock_options.hpp>
 
+#include <atomic>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
@@ -15,7 +19,66 @@ namespace voilk { namespace chain {
 
    boost::interprocess::defer_lock_type defer_lock;
 
+   namespace bip = boost::interprocess;
+
    namespace detail {
+      /**
+       * An immutable, memory mapped view of the block log and its index covering blocks 1 through head_num.
+       *
+       * Views are shared between readers through an atomic shared_ptr. A reader that needs a block newer
+       * than the current view's head asks the block log for a fresh view. Old views stay valid until the
+       * last reader holding them lets go, so readers never wait on the writer.
+       */
+      class block_log_view
+      {
+         public:
+            block_log_view( const fc::path& block_file, uint64_t block_size, const fc::path& index_file, uint64_t index_size, uint32_t head_num ) :
+               _block_mapping( block_file.generic_string().c_str(), bip::read_only ),
+               _block_region( _block_mapping, bip::read_only, 0, block_size ),
+               _index_mapping( index_file.generic_string().c_str(), bip::read_only ),
+               _index_region( _index_mapping, bip::read_only, 0, index_size ),
+               _block_size( block_size ),
+               _head_num( head_num )
+            {
+               FC_ASSERT( index_size >= sizeof( uint64_t ) * head_num, "Block log index is incomplete.",
+                  ("index_size", index_size)("head_num", head_num) );
+            }
+
+            uint32_t head_num()const { return _head_num; }
+            uint64_t size()const { return _block_size; }
+
+            const char* data( uint64_t pos )const
+            {
+               return static_cast< const char* >( _block_region.get_address() ) + pos;
+            }
+
+            uint64_t get_block_pos( uint32_t block_num )const
+            {
+               uint64_t pos;
+               memcpy( (char*)&pos, static_cast< const char* >( _index_region.get_address() ) + sizeof( uint64_t ) * ( block_num - 1 ), sizeof( pos ) );
+               return pos;
+            }
+
+            /// Each block is followed by its 8 byte position, so a block ends 8 bytes before the next one begins.
+            uint64_t get_block_end( uint32_t block_num )const
+            {
+               if( block_num == _head_num )
+                  return _block_size - sizeof( uint64_t );
+
+               return get_block_pos( block_num + 1 ) - sizeof( uint64_t );
+            }
+
+         private:
+            bip::file_mapping    _block_mapping;
+            bip::mapped_region   _block_region;
+            bip::file_mapping    _index_mapping;
+            bip::mapped_region   _index_region;
+            uint64_t             _block_size = 0;
+            uint32_t             _head_num = 0;
+      };
+
+      typedef std::shared_ptr< const block_log_view > block_log_view_ptr;
+
       class block_log_impl {
          public:
             optional< signed_block > head;
@@ -24,69 +87,96 @@ namespace voilk { namespace chain {
             std::fstream             index_stream;
             fc::path                 block_file;
             fc::path                 index_file;
-            bool                     block_write = false;
-            bool                     index_write = false;
+
+            /// Sizes of the files as of the last completed append, guarded by mtx
+            uint64_t                 block_size = 0;
+            uint64_t                 index_size = 0;
+
+            /// Head block number of the last completed append, readable without mtx
+            std::atomic< uint32_t >  committed_head_num;
+
+            block_log_view_ptr       view;
 
             bool                     use_locking = true;
 
             boost::mutex             mtx;
 
-            inline void check_block_read()
-            {
-               try
-               {
-                  if( block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_READ );
-                     block_write = false;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
-            }
+            block_log_impl() : committed_head_num( 0 ) {}
 
-            inline void check_block_write()
+            /**
+             * Return a view containing block_num if the block exists, otherwise the current view.
+             * The returned pointer may be null when the log is empty.
+             */
+            block_log_view_ptr get_view( uint32_t block_num )
             {
-               try
-               {
-                  if( !block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_WRITE );
-                     block_write = true;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               auto v = std::atomic_load( &view );
+
+               if( block_num == 0 || ( v && block_num <= v->head_num() ) || block_num > committed_head_num.load( std::memory_order_acquire ) )
+                  return v;
+
+               return remap();
             }
 
-            inline void check_index_read()
+            block_log_view_ptr remap()
             {
-               try
-               {
-                  if( index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_READ );
-                     index_write = false;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               scoped_lock lock( mtx );
+
+               // Another reader may have remapped while we waited for the lock
+               auto v = std::atomic_load( &view );
+               uint32_t head_num = committed_head_num.load( std::memory_order_relaxed );
+
+               if( head_num == 0 || ( v && v->head_num() == head_num ) )
+                  return v;
+
+               v = std::make_shared< block_log_view >( block_file, block_size, index_file, index_size, head_num );
+               std::atomic_store( &view, v );
+               return v;
             }
 
-            inline void check_index_write()
+            void commit_head()
             {
-               try
-               {
-                  if( !index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_WRITE );
-                     index_write = true;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               block_size = fc::file_size( block_file );
+               index_size = fc::file_size( index_file );
+               committed_head_num.store( head ? head->block_num() : 0, std::memory_order_release );
             }
       };
+
+      signed_block read_block_from_view( const block_log_view& v, uint64_t pos, uint64_t& next_pos )
+      {
+         FC_ASSERT( pos < v.size(), "Block position is past the end of the block log.", ("pos", pos)("size", v.size()) );
+
+         fc::datastream< const char* > ds( v.data( pos ), v.size() - pos );
+         signed_block b;
+         fc::raw::unpack( ds, b );
+         next_pos = pos + ds.tellp() + sizeof( uint64_t );
+         return b;
+      }
+
+      signed_block read_head_from_file( const fc::path& block_file )
+      {
+         std::ifstream in( block_file.generic_string().c_str(), LOG_READ );
+         in.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+         uint64_t pos;
+         in.seekg( -sizeof( pos ), std::ios::end );
+         in.read( (char*)&pos, sizeof( pos ) );
+         in.seekg( pos );
+
+         signed_block b;
+         fc::raw::unpack( in, b );
+         return b;
+      }
+
+      uint64_t read_tail_pos( const fc::path& file )
+      {
+         std::ifstream in( file.generic_string().c_str(), LOG_READ );
+         in.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+         uint64_t pos;
+         in.seekg( -sizeof( pos ), std::ios::end );
+         in.read( (char*)&pos, sizeof( pos ) );
+         return pos;
+      }
    }
 
    block_log::block_log()
@@ -108,13 +198,14 @@ namespace voilk { namespace chain {
       if( my->index_stream.is_open() )
          my->index_stream.close();
 
+      std::atomic_store( &my->view, detail::block_log_view_ptr() );
+
       my->block_file = file;
       my->index_file = fc::path( file.generic_string() + ".index" );
 
+      // The streams are only ever used for appending. All reads go through memory mapped views.
       my->block_stream.open( my->block_file.generic_string().c_str(), LOG_WRITE );
       my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-      my->block_write = true;
-      my->index_write = true;
 
       /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to eachother.
@@ -140,22 +231,14 @@ namespace voilk { namespace chain {
       if( log_size )
       {
          ilog( "Log is nonempty" );
-         my->head = read_head();
+         my->head = detail::read_head_from_file( my->block_file );
          my->head_id = my->head->id();
 
          if( index_size )
          {
-            my->check_block_read();
-            my->check_index_read();
-
             ilog( "Index is nonempty" );
-            uint64_t block_pos;
-            my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->block_stream.read( (char*)&block_pos, sizeof( block_pos ) );
-
-            uint64_t index_pos;
-            my->index_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->index_stream.read( (char*)&index_pos, sizeof( index_pos ) );
+            uint64_t block_pos = detail::read_tail_pos( my->block_file );
+            uint64_t index_pos = detail::read_tail_pos( my->index_file );
 
             if( block_pos < index_pos )
             {
@@ -180,8 +263,9 @@ namespace voilk { namespace chain {
          my->index_stream.close();
          fc::remove_all( my->index_file );
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
       }
+
+      my->commit_head();
    }
 
    void block_log::close()
@@ -205,19 +289,24 @@ namespace voilk { namespace chain {
             lock.lock();;
          }
 
-         my->check_block_write();
-         my->check_index_write();
-
-         uint64_t pos = my->block_stream.tellp();
-         FC_ASSERT( static_cast<uint64_t>(my->index_stream.tellp()) == sizeof( uint64_t ) * ( b.block_num() - 1 ),
+         uint64_t pos = my->block_size;
+         FC_ASSERT( my->index_size == sizeof( uint64_t ) * ( b.block_num() - 1 ),
             "Append to index file occuring at wrong position.",
-            ( "position", (uint64_t) my->index_stream.tellp() )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
+            ( "position", my->index_size )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
          auto data = fc::raw::pack_to_vector( b );
          my->block_stream.write( data.data(), data.size() );
          my->block_stream.write( (char*)&pos, sizeof( pos ) );
          my->index_stream.write( (char*)&pos, sizeof( pos ) );
+
+         // Readers map the files directly, so the data must reach the file before the new head is published.
+         my->block_stream.flush();
+         my->index_stream.flush();
+
          my->head = b;
          my->head_id = b.id();
+         my->block_size += data.size() + sizeof( pos );
+         my->index_size += sizeof( pos );
+         my->committed_head_num.store( b.block_num(), std::memory_order_release );
 
          return pos;
       }
@@ -239,26 +328,17 @@ namespace voilk { namespace chain {
 
    std::pair< signed_block, uint64_t > block_log::read_block( uint64_t pos )const
    {
-      scoped_lock lock( my->mtx, defer_lock );
-
-      if( my->use_locking )
+      try
       {
-         lock.lock();;
-      }
+         auto v = std::atomic_load( &my->view );
 
-      return read_block_helper( pos );
-   }
+         if( !v || pos >= v->size() )
+            v = my->remap();
 
-   std::pair< signed_block, uint64_t > block_log::read_block_helper( uint64_t pos )const
-   {
-      try
-      {
-         my->check_block_read();
+         FC_ASSERT( v, "Block log is empty." );
 
-         my->block_stream.seekg( pos );
-         std::pair<signed_block,uint64_t> result;
-         fc::raw::unpack( my->block_stream, result.first );
-         result.second = uint64_t(my->block_stream.tellg()) + 8;
+         std::pair< signed_block, uint64_t > result;
+         result.first = detail::read_block_from_view( *v, pos, result.second );
          return result;
       }
       FC_LOG_AND_RETHROW()
@@ -268,18 +348,13 @@ namespace voilk { namespace chain {
    {
       try
       {
-         scoped_lock lock( my->mtx, defer_lock );
-
-         if( my->use_locking )
-         {
-            lock.lock();;
-         }
-
          optional< signed_block > b;
-         uint64_t pos = get_block_pos_helper( block_num );
-         if( pos != npos )
+         auto v = my->get_view( block_num );
+
+         if( v && block_num > 0 && block_num <= v->head_num() )
          {
-            b = read_block_helper( pos ).first;
+            uint64_t next_pos;
+            b = detail::read_block_from_view( *v, v->get_block_pos( block_num ), next_pos );
             FC_ASSERT( b->block_num() == block_num , "Wrong block was read from block log.", ( "returned", b->block_num() )( "expected", block_num ));
          }
          return b;
@@ -287,30 +362,37 @@ namespace voilk { namespace chain {
       FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   std::vector< char > block_log::read_raw_block_by_num( uint32_t block_num )const
    {
-      scoped_lock lock( my->mtx, defer_lock );
-
-      if( my->use_locking )
+      try
       {
-         lock.lock();;
-      }
+         std::vector< char > data;
+         auto v = my->get_view( block_num );
 
-      return get_block_pos_helper( block_num );
+         if( v && block_num > 0 && block_num <= v->head_num() )
+         {
+            uint64_t pos = v->get_block_pos( block_num );
+            uint64_t end_pos = v->get_block_end( block_num );
+            FC_ASSERT( end_pos > pos && end_pos <= v->size(), "Block log index is corrupt.",
+               ("block_num", block_num)("pos", pos)("end_pos", end_pos) );
+
+            data.assign( v->data( pos ), v->data( end_pos ) );
+         }
+         return data;
+      }
+      FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos_helper( uint32_t block_num ) const
+   uint64_t block_log::get_block_pos( uint32_t block_num ) const
    {
       try
       {
-         my->check_index_read();
+         auto v = my->get_view( block_num );
 
-         if( !( my->head.valid() && block_num <= protocol::block_header::num_from_id( my->head_id ) && block_num > 0 ) )
+         if( !( v && block_num <= v->head_num() && block_num > 0 ) )
             return npos;
-         my->index_stream.seekg( sizeof( uint64_t ) * ( block_num - 1 ) );
-         uint64_t pos;
-         my->index_stream.read( (char*)&pos, sizeof( pos ) );
-         return pos;
+
+         return v->get_block_pos( block_num );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -319,19 +401,11 @@ namespace voilk { namespace chain {
    {
       try
       {
-         scoped_lock lock( my->mtx, defer_lock );
-
-         if( my->use_locking )
-         {
-            lock.lock();;
-         }
-
-         my->check_block_read();
+         auto v = my->get_view( my->committed_head_num.load( std::memory_order_acquire ) );
+         FC_ASSERT( v, "Block log is empty." );
 
-         uint64_t pos;
-         my->block_stream.seekg( -sizeof(pos), std::ios::end );
-         my->block_stream.read( (char*)&pos, sizeof(pos) );
-         return read_block_helper( pos ).first;
+         uint64_t next_pos;
+         return detail::read_block_from_view( *v, v->get_block_pos( v->head_num() ), next_pos );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -356,24 +430,27 @@ namespace voilk { namespace chain {
          my->index_stream.close();
          fc::remove_all( my->index_file );
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
+
+         std::ifstream block_stream( my->block_file.generic_string().c_str(), LOG_READ );
+         block_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
 
          uint64_t pos = 0;
          uint64_t end_pos;
-         my->check_block_read();
 
-         my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-         my->block_stream.read( (char*)&end_pos, sizeof( end_pos ) );
+         block_stream.seekg( -sizeof( uint64_t), std::ios::end );
+         block_stream.read( (char*)&end_pos, sizeof( end_pos ) );
          signed_block tmp;
 
-         my->block_stream.seekg( pos );
+         block_stream.seekg( pos );
 
          while( pos < end_pos )
          {
-            fc::raw::unpack( my->block_stream, tmp );
-            my->block_stream.read( (char*)&pos, sizeof( pos ) );
+            fc::raw::unpack( block_stream, tmp );
+            block_stream.read( (char*)&pos, sizeof( pos ) );
             my->index_stream.write( (char*)&pos, sizeof( pos ) );
          }
+
+         my->index_stream.flush();
       }
       FC_LOG_AND_RETHROW()
    }
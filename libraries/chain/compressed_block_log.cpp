@@ -0,0 +1,404 @@
+#include <voilk/chain/compressed_block_log.hpp>
+#include <fstream>
+#include <fc/compress/zlib.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::trunc)
+
+namespace voilk { namespace chain {
+
+   typedef boost::interprocess::scoped_lock< boost::mutex > scoped_lock;
+
+   namespace bip = boost::interprocess;
+
+   namespace detail {
+      struct compressed_log_header
+      {
+         uint32_t magic = compressed_block_log::magic;
+         uint32_t version = compressed_block_log::version;
+         uint32_t blocks_per_chunk = 0;
+         uint32_t compression = compressed_block_log::none;
+      };
+
+      struct chunk_header
+      {
+         uint32_t payload_size = 0;
+         uint32_t block_count = 0;
+      };
+
+      /// A decompressed chunk, shared with readers so the lock is not held while they copy blocks out of it
+      struct decoded_chunk
+      {
+         uint32_t            chunk_num = 0;
+         uint32_t            block_count = 0;
+         std::string         payload;
+
+         uint32_t offset( uint32_t i )const
+         {
+            uint32_t o;
+            memcpy( (char*)&o, payload.data() + sizeof( uint32_t ) * i, sizeof( o ) );
+            return o;
+         }
+
+         const char* block_begin( uint32_t i )const { return payload.data() + offset( i ); }
+         const char* block_end( uint32_t i )const   { return payload.data() + offset( i + 1 ); }
+      };
+
+      class compressed_block_log_impl {
+         public:
+            fc::path                                  block_file;
+            fc::path                                  index_file;
+            compressed_log_header                     header;
+            uint32_t                                  head_block_num = 0;
+            uint32_t                                  num_chunks = 0;
+
+            std::unique_ptr< bip::file_mapping >      block_mapping;
+            std::unique_ptr< bip::mapped_region >     block_region;
+            std::unique_ptr< bip::file_mapping >      index_mapping;
+            std::unique_ptr< bip::mapped_region >     index_region;
+
+            boost::mutex                              mtx;
+            std::shared_ptr< const decoded_chunk >    last_chunk;
+
+            const char* block_data()const { return static_cast< const char* >( block_region->get_address() ); }
+            uint64_t block_size()const { return block_region->get_size(); }
+
+            uint64_t get_chunk_pos( uint32_t chunk_num )const
+            {
+               uint64_t pos;
+               memcpy( (char*)&pos, static_cast< const char* >( index_region->get_address() ) + sizeof( uint64_t ) * chunk_num, sizeof( pos ) );
+               return pos;
+            }
+
+            /// Returns false when pos, which may come from a corrupt index, leaves no room for a chunk header
+            bool peek_chunk_header( uint64_t pos, chunk_header& h )const
+            {
+               if( pos < sizeof( compressed_log_header ) || pos > block_size() || block_size() - pos < sizeof( h ) )
+                  return false;
+
+               memcpy( (char*)&h, block_data() + pos, sizeof( h ) );
+               return true;
+            }
+
+            chunk_header read_chunk_header( uint64_t pos )const
+            {
+               chunk_header h;
+               FC_ASSERT( peek_chunk_header( pos, h ), "Chunk header is outside of the compressed block log.", ("pos", pos)("size", block_size()) );
+               FC_ASSERT( block_size() - pos - sizeof( h ) >= h.payload_size, "Chunk is truncated.", ("pos", pos)("size", h.payload_size) );
+               FC_ASSERT( h.block_count > 0 && h.block_count <= header.blocks_per_chunk, "Chunk at ${pos} holds ${n} blocks.",
+                  ("pos", pos)("n", h.block_count) );
+               return h;
+            }
+
+            std::shared_ptr< const decoded_chunk > get_chunk( uint32_t chunk_num )
+            {
+               {
+                  scoped_lock lock( mtx );
+                  if( last_chunk && last_chunk->chunk_num == chunk_num )
+                     return last_chunk;
+               }
+
+               uint64_t pos = get_chunk_pos( chunk_num );
+               chunk_header h = read_chunk_header( pos );
+
+               auto chunk = std::make_shared< decoded_chunk >();
+               chunk->chunk_num = chunk_num;
+               chunk->block_count = h.block_count;
+
+               std::string payload( block_data() + pos + sizeof( h ), h.payload_size );
+
+               switch( header.compression )
+               {
+                  case compressed_block_log::none:
+                     chunk->payload = std::move( payload );
+                     break;
+                  case compressed_block_log::zlib:
+                     // Empty both when the stream is corrupt and when it holds nothing, a chunk never does
+                     chunk->payload = fc::zlib_decompress( payload );
+                     FC_ASSERT( chunk->payload.size(), "Chunk ${n} could not be decompressed.", ("n", chunk_num) );
+                     break;
+                  default:
+                     FC_ASSERT( false, "Unknown compression type ${c}", ("c", header.compression) );
+               }
+
+               // Blocks are copied out by their offsets, which must lie within the payload and follow each other
+               uint32_t table_size = sizeof( uint32_t ) * ( h.block_count + 1 );
+               FC_ASSERT( chunk->payload.size() >= table_size, "Chunk ${n} is corrupt.", ("n", chunk_num) );
+               FC_ASSERT( chunk->offset( 0 ) == table_size && chunk->offset( h.block_count ) == chunk->payload.size(),
+                  "Chunk ${n} is ${s} bytes, its offsets expect ${e}.", ("n", chunk_num)("s", chunk->payload.size())("e", chunk->offset( h.block_count )) );
+
+               for( uint32_t i = 0; i < h.block_count; ++i )
+                  FC_ASSERT( chunk->offset( i ) < chunk->offset( i + 1 ), "Chunk ${n} is corrupt.", ("n", chunk_num) );
+
+               scoped_lock lock( mtx );
+               last_chunk = chunk;
+               return chunk;
+            }
+      };
+
+      class compressed_block_log_writer_impl {
+         public:
+            std::ofstream           block_stream;
+            std::ofstream           index_stream;
+            compressed_log_header   header;
+            uint32_t                next_block_num = 1;
+            uint64_t                pos = 0;
+            std::vector< std::vector< char > > pending;
+
+            void write_chunk()
+            {
+               if( pending.empty() )
+                  return;
+
+               uint32_t count = pending.size();
+               uint32_t offset = sizeof( uint32_t ) * ( count + 1 );
+               std::string payload;
+               payload.resize( offset );
+
+               for( uint32_t i = 0; i < count; ++i )
+               {
+                  memcpy( &payload[ sizeof( uint32_t ) * i ], (char*)&offset, sizeof( offset ) );
+                  offset += pending[i].size();
+               }
+               memcpy( &payload[ sizeof( uint32_t ) * count ], (char*)&offset, sizeof( offset ) );
+
+               payload.reserve( offset );
+               for( const auto& b : pending )
+                  payload.append( b.data(), b.size() );
+
+               if( header.compression == compressed_block_log::zlib )
+                  payload = fc::zlib_compress( payload );
+
+               chunk_header h;
+               h.payload_size = payload.size();
+               h.block_count = count;
+
+               index_stream.write( (char*)&pos, sizeof( pos ) );
+               block_stream.write( (char*)&h, sizeof( h ) );
+               block_stream.write( payload.data(), payload.size() );
+               pos += sizeof( h ) + payload.size();
+
+               pending.clear();
+            }
+      };
+   }
+
+   compressed_block_log::compressed_block_log()
+   :my( new detail::compressed_block_log_impl() ) {}
+
+   compressed_block_log::~compressed_block_log() {}
+
+   void compressed_block_log::open( const fc::path& file )
+   {
+      try
+      {
+         close();
+
+         my->block_file = file;
+         my->index_file = fc::path( file.generic_string() + ".index" );
+
+         FC_ASSERT( fc::exists( my->block_file ) && fc::file_size( my->block_file ) >= sizeof( detail::compressed_log_header ),
+            "Compressed block log ${f} does not exist or is truncated.", ("f", my->block_file) );
+
+         my->block_mapping.reset( new bip::file_mapping( my->block_file.generic_string().c_str(), bip::read_only ) );
+         my->block_region.reset( new bip::mapped_region( *my->block_mapping, bip::read_only ) );
+
+         memcpy( (char*)&my->header, my->block_data(), sizeof( my->header ) );
+         FC_ASSERT( my->header.magic == magic, "${f} is not a compressed block log.", ("f", my->block_file) );
+         FC_ASSERT( my->header.version == version, "Unsupported compressed block log version ${v}.", ("v", my->header.version) );
+         FC_ASSERT( my->header.blocks_per_chunk > 0, "Compressed block log header is corrupt." );
+
+         if( !fc::exists( my->index_file ) )
+         {
+            ilog( "Compressed block log index is missing" );
+            construct_index();
+         }
+
+         uint64_t index_size = fc::file_size( my->index_file );
+         my->num_chunks = index_size / sizeof( uint64_t );
+
+         // An empty index only matches a log without chunks
+         bool index_matches = index_size % sizeof( uint64_t ) == 0
+            && ( my->num_chunks > 0 ) == ( my->block_size() > sizeof( detail::compressed_log_header ) );
+         detail::chunk_header h;
+
+         if( index_matches && my->num_chunks )
+         {
+            my->index_mapping.reset( new bip::file_mapping( my->index_file.generic_string().c_str(), bip::read_only ) );
+            my->index_region.reset( new bip::mapped_region( *my->index_mapping, bip::read_only ) );
+
+            uint64_t last_pos = my->get_chunk_pos( my->num_chunks - 1 );
+            index_matches = my->peek_chunk_header( last_pos, h )
+               && my->block_size() - last_pos - sizeof( h ) == h.payload_size;
+         }
+
+         if( !index_matches )
+         {
+            ilog( "Compressed block log index does not match the log" );
+            my->index_region.reset();
+            my->index_mapping.reset();
+            construct_index();
+            open( file );
+            return;
+         }
+
+         if( my->num_chunks )
+         {
+            h = my->read_chunk_header( my->get_chunk_pos( my->num_chunks - 1 ) );
+            my->head_block_num = ( my->num_chunks - 1 ) * my->header.blocks_per_chunk + h.block_count;
+         }
+      }
+      FC_CAPTURE_AND_RETHROW( (file) )
+   }
+
+   void compressed_block_log::close()
+   {
+      my.reset( new detail::compressed_block_log_impl() );
+   }
+
+   bool compressed_block_log::is_open()const
+   {
+      return my->block_region != nullptr;
+   }
+
+   uint32_t compressed_block_log::head_block_num()const
+   {
+      return my->head_block_num;
+   }
+
+   uint32_t compressed_block_log::blocks_per_chunk()const
+   {
+      return my->header.blocks_per_chunk;
+   }
+
+   compressed_block_log::compression_type compressed_block_log::compression()const
+   {
+      return compression_type( my->header.compression );
+   }
+
+   std::vector< char > compressed_block_log::read_raw_block_by_num( uint32_t block_num )const
+   {
+      try
+      {
+         std::vector< char > data;
+
+         if( block_num == 0 || block_num > my->head_block_num )
+            return data;
+
+         uint32_t chunk_num = ( block_num - 1 ) / my->header.blocks_per_chunk;
+         uint32_t i = ( block_num - 1 ) % my->header.blocks_per_chunk;
+         auto chunk = my->get_chunk( chunk_num );
+
+         FC_ASSERT( i < chunk->block_count, "Block ${b} is missing from chunk ${c}.", ("b", block_num)("c", chunk_num) );
+         data.assign( chunk->block_begin( i ), chunk->block_end( i ) );
+         return data;
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   optional< signed_block > compressed_block_log::read_block_by_num( uint32_t block_num )const
+   {
+      try
+      {
+         optional< signed_block > b;
+         auto data = read_raw_block_by_num( block_num );
+
+         if( data.size() )
+         {
+            b = fc::raw::unpack_from_vector< signed_block >( data );
+            FC_ASSERT( b->block_num() == block_num , "Wrong block was read from compressed block log.", ( "returned", b->block_num() )( "expected", block_num ));
+         }
+         return b;
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   void compressed_block_log::construct_index()
+   {
+      try
+      {
+         ilog( "Reconstructing Compressed Block Log Index..." );
+         std::ofstream index_stream( my->index_file.generic_string().c_str(), LOG_WRITE );
+         index_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+         uint64_t pos = sizeof( detail::compressed_log_header );
+
+         while( pos < my->block_size() )
+         {
+            auto h = my->read_chunk_header( pos );
+            index_stream.write( (char*)&pos, sizeof( pos ) );
+            pos += sizeof( h ) + h.payload_size;
+         }
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   compressed_block_log_writer::compressed_block_log_writer( const fc::path& file, uint32_t blocks_per_chunk, compressed_block_log::compression_type compression )
+   :my( new detail::compressed_block_log_writer_impl() )
+   {
+      FC_ASSERT( blocks_per_chunk > 0, "Chunks must hold at least one block." );
+
+      my->block_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+      my->index_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+      my->block_stream.open( file.generic_string().c_str(), LOG_WRITE );
+      my->index_stream.open( ( file.generic_string() + ".index" ).c_str(), LOG_WRITE );
+
+      my->header.blocks_per_chunk = blocks_per_chunk;
+      my->header.compression = compression;
+      my->block_stream.write( (char*)&my->header, sizeof( my->header ) );
+      my->pos = sizeof( my->header );
+      my->pending.reserve( blocks_per_chunk );
+   }
+
+   compressed_block_log_writer::~compressed_block_log_writer()
+   {
+      try
+      {
+         close();
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Error closing compressed block log: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+
+   void compressed_block_log_writer::append( const signed_block& b )
+   {
+      append_raw( b.block_num(), fc::raw::pack_to_vector( b ) );
+   }
+
+   void compressed_block_log_writer::append_raw( uint32_t block_num, const std::vector< char >& data )
+   {
+      try
+      {
+         FC_ASSERT( my->block_stream.is_open(), "Compressed block log writer is closed." );
+         FC_ASSERT( block_num == my->next_block_num, "Blocks must be appended in order.",
+            ("block_num", block_num)("expected", my->next_block_num) );
+         FC_ASSERT( data.size(), "Cannot append an empty block." );
+
+         my->pending.push_back( data );
+         ++my->next_block_num;
+
+         if( my->pending.size() == my->header.blocks_per_chunk )
+            my->write_chunk();
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   void compressed_block_log_writer::close()
+   {
+      if( !my->block_stream.is_open() )
+         return;
+
+      my->write_chunk();
+      my->block_stream.close();
+      my->index_stream.close();
+   }
+
+} } // voilk::chain
@@ -24,6 +24,7 @@
 #include <voilk/chain/util/uint256.hpp>
 #include <voilk/chain/util/reward.hpp>
 #include <voilk/chain/util/manabar.hpp>
+#include <voilk/chain/util/replay_pipeline.hpp>
 #include <voilk/chain/util/rd_setup.hpp>
 
 #include <fc/smart_ref_impl.hpp>
@@ -112,7 +113,16 @@ void database::open( const open_args& args )
       if( !find< dynamic_global_property_object >() )
          with_write_lock( [&]()
          {
-            init_genesis( args.initial_supply );
+            if( args.snapshot_dir == fc::path() )
+            {
+               init_genesis( args.initial_supply );
+            }
+            else
+            {
+               auto manifest = util::read_snapshot( *this, args.snapshot_dir, args.snapshot_threads );
+               FC_ASSERT( head_block_id() == manifest.head_block_id, "Snapshot manifest does not match its state" );
+               set_revision( head_block_num() );
+            }
          });
 
       _benchmark_dumper.set_enabled( args.benchmark_is_enabled );
@@ -170,6 +180,19 @@ void database::open( const open_args& args )
    FC_CAPTURE_LOG_AND_RETHROW( (args.data_dir)(args.shared_mem_dir)(args.shared_file_size) )
 }
 
+/// Blocks read back from our own block log were validated when they were first applied
+static const uint32_t block_log_replay_skip_flags =
+   database::skip_witness_signature |
+   database::skip_transaction_signatures |
+   database::skip_transaction_dupe_check |
+   database::skip_tapos_check |
+   database::skip_merkle_check |
+   database::skip_witness_schedule_check |
+   database::skip_authority_check |
+   database::skip_validate | /// no need to validate operations
+   database::skip_validate_invariants |
+   database::skip_block_log;
+
 uint32_t database::reindex( const open_args& args )
 {
    reindex_notification note;
@@ -192,50 +215,70 @@ uint32_t database::reindex( const open_args& args )
 
       ilog( "Replaying blocks..." );
 
-      uint64_t skip_flags =
-         skip_witness_signature |
-         skip_transaction_signatures |
-         skip_transaction_dupe_check |
-         skip_tapos_check |
-         skip_merkle_check |
-         skip_witness_schedule_check |
-         skip_authority_check |
-         skip_validate | /// no need to validate operations
-         skip_validate_invariants |
-         skip_block_log;
+      uint64_t skip_flags = block_log_replay_skip_flags;
 
       with_write_lock( [&]()
       {
-         _block_log.set_locking( false );
-         auto itr = _block_log.read_block( 0 );
-         auto last_block_num = _block_log.head()->block_num();
-         if( args.stop_replay_at > 0 && args.stop_replay_at < last_block_num )
-            last_block_num = args.stop_replay_at;
-         if( args.benchmark.first > 0 )
+         // Every block in the block log is irreversible, make sure nothing records or relies on undo history
+         detail::without_undo( *this, [&]()
          {
-            args.benchmark.second( 0, get_abstract_index_cntr() );
-         }
+            _block_log.set_locking( false );
+            auto last_block_num = _block_log.head()->block_num();
+            if( args.stop_replay_at > 0 && args.stop_replay_at < last_block_num )
+               last_block_num = args.stop_replay_at;
+            if( args.benchmark.first > 0 )
+            {
+               args.benchmark.second( 0, get_abstract_index_cntr() );
+            }
 
-         while( itr.first.block_num() != last_block_num )
-         {
-            auto cur_block_num = itr.first.block_num();
-            if( cur_block_num % 100000 == 0 )
-               std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
-               "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
-            apply_block( itr.first, skip_flags );
-
-            if( (args.benchmark.first > 0) && (cur_block_num % args.benchmark.first == 0) )
-               args.benchmark.second( cur_block_num, get_abstract_index_cntr() );
-            itr = _block_log.read_block( itr.second );
-         }
+            auto replay_block = [&]( const signed_block& block )
+            {
+               auto cur_block_num = block.block_num();
+               if( cur_block_num % 100000 == 0 )
+                  std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
+                  "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
+               apply_block( block, skip_flags );
 
-         apply_block( itr.first, skip_flags );
-         note.last_block_number = itr.first.block_num();
+               if( (args.benchmark.first > 0) && (cur_block_num % args.benchmark.first == 0) )
+                  args.benchmark.second( cur_block_num, get_abstract_index_cntr() );
+            };
 
-         if( (args.benchmark.first > 0) && (note.last_block_number % args.benchmark.first == 0) )
-            args.benchmark.second( note.last_block_number, get_abstract_index_cntr() );
-         set_revision( head_block_num() );
-         _block_log.set_locking( true );
+            if( args.replay_queue_depth > 0 )
+            {
+               ilog( "Replaying with a pipeline of depth ${d} and ${t} decode threads",
+                  ("d", args.replay_queue_depth)("t", args.replay_decode_threads) );
+
+               util::replay_pipeline pipeline( _block_log, 1, last_block_num, args.replay_queue_depth, args.replay_decode_threads );
+               signed_block block;
+
+               while( pipeline.next( block ) )
+               {
+                  replay_block( block );
+                  note.last_block_number = block.block_num();
+               }
+
+               auto stats = pipeline.get_stats();
+               ilog( "Replay pipeline stalls: reader ${r} ms, decode ${d} ms, apply ${a} ms",
+                  ("r", stats.reader_stall.count() / 1000)
+                  ("d", stats.decode_stall.count() / 1000)
+                  ("a", stats.apply_stall.count() / 1000) );
+            }
+            else
+            {
+               auto itr = _block_log.read_block( 0 );
+
+               while( itr.first.block_num() != last_block_num )
+               {
+                  replay_block( itr.first );
+                  itr = _block_log.read_block( itr.second );
+               }
+
+               replay_block( itr.first );
+               note.last_block_number = itr.first.block_num();
+            }
+
+            _block_log.set_locking( true );
+         });
       });
 
       if( _block_log.head()->block_num() )
@@ -252,6 +295,72 @@ uint32_t database::reindex( const open_args& args )
 
 }
 
+uint32_t database::load_snapshot( const open_args& args )
+{
+   try
+   {
+      ilog( "Loading state from snapshot ${d}", ("d", args.snapshot_dir) );
+      auto start = fc::time_point::now();
+
+      wipe( args.data_dir, args.shared_mem_dir, false );
+      open( args );
+      _fork_db.reset();    // override effect of _fork_db.start_block() call in open()
+
+      ilog( "Loaded state at block ${n} in ${t} sec", ("n", head_block_num())("t", double((fc::time_point::now()-start).count())/1000000.0) );
+
+      with_write_lock( [&]()
+      {
+         auto last_block_num = _block_log.head()->block_num();
+         if( args.stop_replay_at > 0 && args.stop_replay_at < last_block_num )
+            last_block_num = args.stop_replay_at;
+
+         if( last_block_num > head_block_num() )
+            ilog( "Replaying blocks ${f} to ${l}...", ("f", head_block_num() + 1)("l", last_block_num) );
+
+         // The blocks after the snapshot are irreversible too
+         detail::without_undo( *this, [&]()
+         {
+            _block_log.set_locking( false );
+
+            for( uint32_t block_num = head_block_num() + 1; block_num <= last_block_num; ++block_num )
+            {
+               auto block = _block_log.read_block_by_num( block_num );
+               FC_ASSERT( block.valid(), "Block ${n} is missing from the block log", ("n", block_num) );
+               apply_block( *block, block_log_replay_skip_flags );
+            }
+
+            _block_log.set_locking( true );
+         });
+      });
+
+      _fork_db.start_block( *_block_log.read_block_by_num( head_block_num() ) );
+
+      ilog( "Done loading snapshot, elapsed time: ${t} sec", ("t", double((fc::time_point::now()-start).count())/1000000.0) );
+
+      return head_block_num();
+   }
+   FC_CAPTURE_AND_RETHROW( (args.snapshot_dir)(args.data_dir)(args.shared_mem_dir) )
+}
+
+void database::export_snapshot( const fc::path& dir, uint32_t threads )
+{
+   with_read_lock( [&]()
+   {
+      FC_ASSERT( revision() == head_block_num(), "Cannot export a snapshot of reversible state",
+         ("rev", revision())("head_block", head_block_num()) );
+
+      auto start = fc::time_point::now();
+      auto manifest = util::write_snapshot( *this, dir, threads );
+
+      uint64_t objects = 0;
+      for( const auto& header : manifest.indices )
+         objects += header.object_count;
+
+      ilog( "Wrote ${o} objects at block ${n} to snapshot ${d} in ${t} sec",
+         ("o", objects)("n", manifest.head_block_num)("d", dir)("t", double((fc::time_point::now()-start).count())/1000000.0) );
+   });
+}
+
 void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks)
 {
    close();
@@ -368,6 +477,21 @@ optional<signed_block> database::fetch_block_by_number( uint32_t block_num )cons
    return b;
 } FC_LOG_AND_RETHROW() }
 
+std::vector<char> database::fetch_raw_block_by_number( uint32_t block_num )const
+{ try {
+   // Irreversible blocks are copied straight out of the block log without unpacking them
+   std::vector< char > data = _block_log.read_raw_block_by_num( block_num );
+
+   if( data.empty() )
+   {
+      shared_ptr< fork_item > fitem = _fork_db.fetch_block_on_main_branch_by_number( block_num );
+      if( fitem )
+         data = fc::raw::pack_to_vector( fitem->data );
+   }
+
+   return data;
+} FC_LOG_AND_RETHROW() }
+
 const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
 { try {
    auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
@@ -654,6 +778,12 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
               ;
    }
 
+   // Blocks covered by a checkpoint can never be popped, so when they extend the head their undo history is committed
+   // as soon as they have been applied. Unlike replay, they are not applied without undo: only the blocks at checkpoint
+   // heights are checked before they are applied, so a bad block in between has to be rolled back.
+   bool irreversible = _checkpoints.size() && _checkpoints.rbegin()->first >= block_num
+      && new_block.previous == head_block_id();
+
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -662,6 +792,8 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
          try
          {
             result = _push_block(new_block);
+            if( irreversible && head_block_id() == new_block.id() )
+               commit( head_block_num() );
          }
          FC_CAPTURE_AND_RETHROW( (new_block) )
 
@@ -934,13 +1066,13 @@ signed_block database::_generate_block(
 
    uint64_t postponed_tx_count = 0;
    // pop pending state (reset to head block state)
-   for( const signed_transaction& tx : _pending_tx )
+   auto include_transaction = [&]( const signed_transaction& tx )
    {
       // Only include transactions that have not expired yet for currently generating block,
       // this should clear problem transactions and allow block production to continue
 
       if( tx.expiration < when )
-         continue;
+         return;
 
       uint64_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
@@ -948,7 +1080,7 @@ signed_block database::_generate_block(
       if( new_total_size >= maximum_block_size )
       {
          postponed_tx_count++;
-         continue;
+         return;
       }
 
       try
@@ -966,7 +1098,15 @@ signed_block database::_generate_block(
          //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
          //wlog( "The transaction was ${t}", ("t", tx) );
       }
-   }
+   };
+
+   for( const signed_transaction& tx : _pending_tx )
+      include_transaction( tx );
+
+   // Transactions still waiting to be applied again after the last block are candidates as well
+   for( const signed_transaction& tx : _pending_tx_backlog )
+      include_transaction( tx );
+
    if( postponed_tx_count > 0 )
    {
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
@@ -1026,11 +1166,66 @@ void database::clear_pending()
    {
       assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
       _pending_tx.clear();
+      _pending_tx_backlog.clear();
       _pending_tx_session.reset();
    }
    FC_CAPTURE_AND_RETHROW()
 }
 
+size_t database::apply_pending_transaction_backlog( size_t max_count )
+{
+   fc::time_point start = fc::time_point::now();
+   fc::time_point_sec now = head_block_time();
+   bool check_expiration = head_block_num() > 0;
+   bool hf9 = has_hardfork( VOILK_HARDFORK_0_9 );
+   size_t applied = 0;
+
+   while( !_pending_tx_backlog.empty() && ( max_count == 0 || applied < max_count ) )
+   {
+      signed_transaction tx = std::move( _pending_tx_backlog.front() );
+      _pending_tx_backlog.pop_front();
+
+      if( is_known_transaction( tx.id() ) )
+      {
+         ++_pending_tx_stats.dropped_included;
+         continue;
+      }
+
+      // Same as the expiration check of _apply_transaction, which would reject the transaction
+      if( check_expiration && ( hf9 ? tx.expiration <= now : tx.expiration < now ) )
+      {
+         ++_pending_tx_stats.dropped_expired;
+         continue;
+      }
+
+      ++applied;
+
+      try
+      {
+         // since push_transaction() takes a signed_transaction,
+         // the operation_results field will be ignored.
+         _push_transaction( tx );
+         ++_pending_tx_stats.reapplied;
+      }
+      catch( const transaction_exception& e )
+      {
+         ++_pending_tx_stats.failed;
+         dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
+            ("b", head_block_id())("n", head_block_num())("t", head_block_time()) );
+         dlog( "The invalid transaction caused exception ${e}", ("e", e.to_detail_string()) );
+         dlog( "${t}", ("t", tx) );
+      }
+      catch( const fc::exception& )
+      {
+         ++_pending_tx_stats.failed;
+      }
+   }
+
+   _pending_tx_stats.reapply_time += fc::time_point::now() - start;
+
+   return _pending_tx_backlog.size();
+}
+
 void database::push_virtual_operation( const operation& op )
 {
    FC_ASSERT( is_virtual_operation( op ) );
@@ -3432,12 +3627,25 @@ void database::_apply_transaction(const signed_transaction& trx)
       auto get_owner   = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).owner );  };
       auto get_posting = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).posting );  };
 
+      uint32_t max_membership = has_hardfork( VOILK_HARDFORK_0_20 ) || is_producing() ? VOILK_MAX_AUTHORITY_MEMBERSHIP : 0;
+      uint32_t max_account_auths = has_hardfork( VOILK_HARDFORK_0_20 ) || is_producing() ? VOILK_MAX_SIG_CHECK_ACCOUNTS : 0;
+      auto canon_type = has_hardfork( VOILK_HARDFORK_0_20__1944 ) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical;
+
       try
       {
-         trx.verify_authority( chain_id, get_active, get_owner, get_posting, VOILK_MAX_SIG_CHECK_DEPTH,
-            has_hardfork( VOILK_HARDFORK_0_20 ) || is_producing() ? VOILK_MAX_AUTHORITY_MEMBERSHIP : 0,
-            has_hardfork( VOILK_HARDFORK_0_20 ) || is_producing() ? VOILK_MAX_SIG_CHECK_ACCOUNTS : 0,
-            has_hardfork( VOILK_HARDFORK_0_20__1944 ) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical );
+         auto signature_keys = _signature_key_cache.get( trx_id, trx.signatures, canon_type );
+
+         bool recovered = !signature_keys;
+
+         if( recovered )
+            signature_keys = trx.get_signature_keys( chain_id, canon_type );
+
+         trx.verify_authority( *signature_keys, get_active, get_owner, get_posting, VOILK_MAX_SIG_CHECK_DEPTH,
+            max_membership, max_account_auths );
+
+         // Pending transactions are applied again when they arrive in a block, keep their keys around for then.
+         if( recovered && is_pending_tx() )
+            _signature_key_cache.insert( trx_id, trx.signatures, *signature_keys );
       }
       catch( protocol::tx_missing_active_auth& e )
       {
@@ -31,6 +31,11 @@ namespace voilk { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Both files are written through append only streams. Reads are served from read only memory maps of
+    * the files and do not take the block log mutex, so any number of threads may read concurrently with
+    * each other and with the writer. A reader asking for a block past the currently mapped head remaps the
+    * files once, and every other reader shares the new mapping.
     */
 
    class block_log {
@@ -47,6 +52,12 @@ namespace voilk { namespace chain {
          std::pair< signed_block, uint64_t > read_block( uint64_t file_pos )const;
          optional< signed_block > read_block_by_num( uint32_t block_num )const;
 
+         /**
+          * Return the packed bytes of a block without deserializing them, or an empty vector if
+          * the block does not exist. The block's size is derived from the index file.
+          */
+         std::vector< char > read_raw_block_by_num( uint32_t block_num )const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -65,9 +76,6 @@ namespace voilk { namespace chain {
       private:
          void construct_index();
 
-         std::pair< signed_block, uint64_t > read_block_helper( uint64_t file_pos )const;
-         uint64_t get_block_pos_helper( uint32_t block_num ) const;
-
          std::unique_ptr<detail::block_log_impl> my;
    };
 
@@ -0,0 +1,87 @@
+#pragma once
+#include <fc/filesystem.hpp>
+#include <voilk/protocol/block.hpp>
+
+namespace voilk { namespace chain {
+
+   using namespace voilk::protocol;
+
+   namespace detail { class compressed_block_log_impl; class compressed_block_log_writer_impl; }
+
+   /* The compressed block log is an optional archive format for the block log. Consecutive blocks are grouped
+    * into chunks of a fixed number of blocks, and each chunk is compressed on its own. A secondary index of
+    * chunk positions keeps random access by block number O(1): one seek and one chunk decompression.
+    *
+    * +--------+---------+---------+-----+---------+
+    * | Header | Chunk 0 | Chunk 1 | ... | Chunk N |
+    * +--------+---------+---------+-----+---------+
+    *
+    * The header holds a magic number, the format version, the number of blocks per chunk and the
+    * compression type. Each chunk starts with the size of its payload and the number of blocks it holds,
+    * followed by the payload. Once decompressed the payload is a table of (block count + 1) 32 bit offsets
+    * followed by the packed blocks, so block i of the chunk spans [offset[i], offset[i+1]).
+    *
+    * +-----------------+--------------------+-------------+-----------------+-----+
+    * | Payload Size    | Block Count        | Offsets     | Block Data      | ... |
+    * +-----------------+--------------------+-------------+-----------------+-----+
+    *
+    * The index file contains one 64 bit position per chunk. Chunk k holds blocks k * blocks_per_chunk + 1
+    * through (k + 1) * blocks_per_chunk. Only the last chunk may be partially filled. Like the block log
+    * index, it can be rebuilt with a linear scan of the main file.
+    */
+
+   class compressed_block_log {
+      public:
+         enum compression_type : uint32_t
+         {
+            none = 0,
+            zlib = 1
+         };
+
+         compressed_block_log();
+         ~compressed_block_log();
+
+         void open( const fc::path& file );
+         void close();
+         bool is_open()const;
+
+         uint32_t head_block_num()const;
+         uint32_t blocks_per_chunk()const;
+         compression_type compression()const;
+
+         optional< signed_block > read_block_by_num( uint32_t block_num )const;
+         std::vector< char > read_raw_block_by_num( uint32_t block_num )const;
+
+         static const uint32_t magic = 0x4c424356; // "VCBL"
+         static const uint32_t version = 1;
+         static const uint32_t default_blocks_per_chunk = 100;
+
+      private:
+         void construct_index();
+
+         std::unique_ptr< detail::compressed_block_log_impl > my;
+   };
+
+   /**
+    * Writes a new compressed block log. Blocks must be appended in order starting from block 1.
+    * The last, partially filled chunk is written out by close() or the destructor.
+    */
+   class compressed_block_log_writer {
+      public:
+         compressed_block_log_writer( const fc::path& file,
+            uint32_t blocks_per_chunk = compressed_block_log::default_blocks_per_chunk,
+            compressed_block_log::compression_type compression = compressed_block_log::zlib );
+         ~compressed_block_log_writer();
+
+         void append( const signed_block& b );
+
+         /** Appends an already packed block, such as the bytes returned by block_log::read_raw_block_by_num */
+         void append_raw( uint32_t block_num, const std::vector< char >& data );
+
+         void close();
+
+      private:
+         std::unique_ptr< detail::compressed_block_log_writer_impl > my;
+   };
+
+} }
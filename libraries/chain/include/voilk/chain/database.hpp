@@ -10,6 +10,7 @@
 #include <voilk/chain/notifications.hpp>
 
 #include <voilk/chain/util/advanced_benchmark_dumper.hpp>
+#include <voilk/chain/util/signature_key_cache.hpp>
 #include <voilk/chain/util/signal.hpp>
 
 #include <voilk/protocol/protocol.hpp>
@@ -50,6 +51,15 @@ namespace voilk { namespace chain {
       uint32_t last_block_number = 0;
    };
 
+   struct pending_transaction_stats
+   {
+      uint64_t          reapplied = 0;          ///< Pending transactions applied again after a block
+      uint64_t          failed = 0;             ///< Pending transactions that no longer applied after a block
+      uint64_t          dropped_included = 0;   ///< Dropped because a block included them
+      uint64_t          dropped_expired = 0;    ///< Dropped without applying them because they expired
+      fc::microseconds  reapply_time;           ///< Time spent applying pending transactions again
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -109,7 +119,13 @@ namespace voilk { namespace chain {
 
             // The following fields are only used on reindexing
             uint32_t stop_replay_at = 0;
+            uint32_t replay_queue_depth = 0;    ///< Blocks decoded ahead of the apply stage, 0 replays serially
+            uint32_t replay_decode_threads = 1;
             TBenchmark benchmark = TBenchmark(0, []( uint32_t, const abstract_index_cntr_t& ){});
+
+            // The following fields are only used when loading a snapshot
+            fc::path snapshot_dir;              ///< When set, a new database is loaded from this snapshot instead of the genesis state
+            uint32_t snapshot_threads = 1;
          };
 
          /**
@@ -132,6 +148,23 @@ namespace voilk { namespace chain {
           */
          uint32_t reindex( const open_args& args );
 
+         /**
+          * @brief Load the object graph from the snapshot in args.snapshot_dir and open the database
+          *
+          * Replaces the current state with the snapshot, then replays the blocks of the block log after the
+          * snapshot's head block. The block log must contain the snapshot's head block.
+          *
+          * @return the last replayed block number.
+          */
+         uint32_t load_snapshot( const open_args& args );
+
+         /**
+          * @brief Write the current state to a snapshot in dir, see util::write_snapshot
+          *
+          * The state must not have undo history, so it only holds irreversible blocks.
+          */
+         void export_snapshot( const fc::path& dir, uint32_t threads );
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -155,6 +188,8 @@ namespace voilk { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /** The packed signed_block at num on the main chain, empty when there is none */
+         std::vector<char>          fetch_raw_block_by_number( uint32_t num )const;
          const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -162,6 +197,9 @@ namespace voilk { namespace chain {
          chain_id_type get_chain_id() const;
          void set_chain_id( const chain_id_type& chain_id );
 
+         /** Signing keys recovered ahead of time, consulted by transaction application before recovering keys itself */
+         util::signature_key_cache& get_signature_key_cache() { return _signature_key_cache; }
+
          /** Allows to visit all stored blocks until processor returns true. Caller is responsible for block disasembling
           * const signed_block_header& - header of previous block
           * const signed_block& - block to be processed currently
@@ -242,6 +280,25 @@ namespace voilk { namespace chain {
          void pop_block();
          void clear_pending();
 
+         /**
+          * Applies up to max_count of the pending transactions still waiting to be applied again after the
+          * last block, or all of them when max_count is 0. Transactions included in a block or expired are
+          * dropped without being applied and do not count towards max_count.
+          *
+          * @return the number of transactions left waiting
+          */
+         size_t apply_pending_transaction_backlog( size_t max_count = 0 );
+         size_t pending_transaction_backlog_size()const { return _pending_tx_backlog.size(); }
+
+         /**
+          * Limits how many pending transactions are applied again as part of pushing a block, the others wait
+          * for apply_pending_transaction_backlog. 0, the default, applies all of them with the block.
+          */
+         void set_pending_transaction_reapply_limit( size_t limit ) { _pending_tx_reapply_limit = limit; }
+         size_t get_pending_transaction_reapply_limit()const { return _pending_tx_reapply_limit; }
+
+         const pending_transaction_stats& get_pending_transaction_stats()const { return _pending_tx_stats; }
+
          void push_virtual_operation( const operation& op );
          void pre_push_virtual_operation( const operation& op );
          void post_push_virtual_operation( const operation& op );
@@ -445,6 +502,9 @@ namespace voilk { namespace chain {
          std::deque< signed_transaction >       _popped_tx;
          vector< signed_transaction >           _pending_tx;
 
+         /** pending transactions that still have to be applied again after the last block, in their original order */
+         std::deque< signed_transaction >       _pending_tx_backlog;
+
          bool apply_order( const limit_order_object& new_order_object );
          bool fill_order( const limit_order_object& order, const asset& pays, const asset& receives );
          void cancel_order( const limit_order_object& obj );
@@ -587,6 +647,10 @@ namespace voilk { namespace chain {
          std::string                   _json_schema;
 
          util::advanced_benchmark_dumper  _benchmark_dumper;
+         util::signature_key_cache        _signature_key_cache;
+
+         size_t                           _pending_tx_reapply_limit = 0;
+         pending_transaction_stats        _pending_tx_stats;
 
          fc::signal<void(const required_action_notification&)> _pre_apply_required_action_signal;
          fc::signal<void(const required_action_notification&)> _post_apply_required_action_signal;
@@ -46,57 +46,32 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<signed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ),
+        _backlog( std::move( db._pending_tx_backlog ) )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception&  ) {
-         }
-      }
+      // Transactions of popped blocks come first, then the applied pending ones, then the ones that were
+      // still waiting to be applied again after the previous block.
+      std::deque< signed_transaction > backlog( std::make_move_iterator( _db._popped_tx.begin() ),
+                                                std::make_move_iterator( _db._popped_tx.end() ) );
       _db._popped_tx.clear();
-      for( const signed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const transaction_exception& e )
-         {
-            dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
-               ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
-            dlog( "The invalid transaction caused exception ${e}", ("e", e.to_detail_string()) );
-            dlog( "${t}", ("t", tx) );
-         }
-         catch( const fc::exception& e )
-         {
 
-            /*
-            dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
-               ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
-            dlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
-            dlog( "${t}", ("t", tx) );
-            */
-         }
-      }
+      backlog.insert( backlog.end(), std::make_move_iterator( _pending_transactions.begin() ),
+                                     std::make_move_iterator( _pending_transactions.end() ) );
+      backlog.insert( backlog.end(), std::make_move_iterator( _backlog.begin() ),
+                                     std::make_move_iterator( _backlog.end() ) );
+      _db._pending_tx_backlog = std::move( backlog );
+
+      _db.apply_pending_transaction_backlog( _db.get_pending_transaction_reapply_limit() );
    }
 
    database& _db;
    std::vector< signed_transaction > _pending_transactions;
+   std::deque< signed_transaction >  _backlog;
 };
 
 /**
@@ -134,4 +109,30 @@ void without_pending_transactions(
     return;
 }
 
+/**
+ * Disable undo, call callback, then enable undo again with the
+ * revision set to the head block number.
+ *
+ * Changes made by callback cannot be undone, so it must only
+ * apply irreversible blocks.
+ */
+template< typename Lambda >
+void without_undo(
+   database& db,
+   Lambda callback )
+{
+   // enable_undo() can throw, so it is called here rather than from a destructor that may run during unwinding
+   db.disable_undo();
+   try
+   {
+      callback();
+   }
+   catch( ... )
+   {
+      db.enable_undo( db.head_block_num() );
+      throw;
+   }
+   db.enable_undo( db.head_block_num() );
+}
+
 } } } // voilk::chain::detail
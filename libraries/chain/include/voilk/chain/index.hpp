@@ -5,6 +5,7 @@
 #include <voilk/chain/schema_types.hpp>
 
 #include <voilk/chain/database.hpp>
+#include <voilk/chain/util/snapshot.hpp>
 
 namespace voilk { namespace chain {
 
@@ -16,6 +17,12 @@ struct index_info
    index_info();
    virtual ~index_info();
    virtual std::shared_ptr< abstract_schema > get_schema() = 0;
+
+   /** Writes every object of the index to out in id order */
+   virtual void write_snapshot( const database& db, util::snapshot_writer& out, util::snapshot_index_header& header ) = 0;
+
+   /** Creates the objects described by header from in, the index must be empty */
+   virtual void read_snapshot( database& db, util::snapshot_reader& in, const util::snapshot_index_header& header ) = 0;
 };
 
 template< typename MultiIndexType >
@@ -31,6 +38,31 @@ struct index_info_impl
    virtual std::shared_ptr< abstract_schema > get_schema() override
    {   return _schema;   }
 
+   virtual void write_snapshot( const database& db, util::snapshot_writer& out, util::snapshot_index_header& header ) override
+   {
+      const auto& idx = db.get_index< MultiIndexType >();
+
+      header.object_count = idx.indices().size();
+      header.next_id = idx.next_id()._id;
+
+      for( const auto& obj : idx.indices() )
+         fc::raw::pack( out, obj );
+   }
+
+   virtual void read_snapshot( database& db, util::snapshot_reader& in, const util::snapshot_index_header& header ) override
+   {
+      auto& idx = db.get_mutable_index< MultiIndexType >();
+      FC_ASSERT( idx.indices().size() == 0, "Cannot load ${t} from a snapshot into a non-empty index", ("t", header.type_name) );
+
+      for( uint64_t i = 0; i < header.object_count; ++i )
+      {
+         // The stored id replaces the one assigned by emplace
+         idx.emplace( [&]( value_type& obj ) { fc::raw::unpack( in, obj ); } );
+      }
+
+      idx.set_next_id( typename value_type::id_type( header.next_id ) );
+   }
+
    std::shared_ptr< abstract_schema > _schema;
 };
 
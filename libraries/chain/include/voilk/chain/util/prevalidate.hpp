@@ -0,0 +1,18 @@
+#pragma once
+
+#include <voilk/chain/util/signature_key_cache.hpp>
+
+namespace voilk { namespace chain { namespace util {
+
+/**
+ * Runs the checks of a pending transaction that need no database state, so malformed, oversized and expired
+ * transactions can be rejected before they are queued for the write thread. The recovered signing keys are
+ * inserted in cache. A head_time of zero skips the expiration checks, a max_block_size of zero the size check.
+ *
+ * The transaction can then be applied with database::skip_validate, the write thread repeats the size and
+ * expiration checks against the head block it is actually applied on.
+ */
+void prevalidate_transaction( const signed_transaction& trx, const chain_id_type& chain_id,
+   fc::time_point_sec head_time, uint32_t max_block_size, signature_key_cache& cache );
+
+} } } // voilk::chain::util
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <voilk/chain/block_log.hpp>
+
+#include <fc/time.hpp>
+
+#include <memory>
+
+namespace voilk { namespace chain { namespace util {
+
+namespace detail { class replay_pipeline_impl; }
+
+struct replay_pipeline_stats
+{
+   uint64_t          blocks_read = 0;
+   uint64_t          blocks_applied = 0;
+   fc::microseconds  reader_stall;     ///< Time the reader waited for a free queue slot
+   fc::microseconds  decode_stall;     ///< Time summed over all decode workers spent waiting for raw blocks
+   fc::microseconds  apply_stall;      ///< Time the apply stage waited for the next decoded block
+};
+
+/**
+ * A bounded, multi-stage pipeline used to replay the block log.
+ *
+ * A prefetch thread reads packed blocks from the block log, a pool of decode workers deserializes
+ * them and computes their IDs, and the caller consumes the decoded blocks strictly in order through
+ * next(). At most queue_depth blocks are in flight at any time, so memory use stays bounded regardless
+ * of how far the reader gets ahead of the apply stage.
+ */
+class replay_pipeline
+{
+   public:
+      replay_pipeline( const block_log& log, uint32_t first_block, uint32_t last_block, uint32_t queue_depth, uint32_t num_workers );
+      ~replay_pipeline();
+
+      /**
+       * Wait for the next block in order. Returns false once last_block has been returned.
+       * Any error encountered while reading or decoding the block is rethrown here.
+       */
+      bool next( signed_block& block );
+
+      replay_pipeline_stats get_stats()const;
+
+   private:
+      std::unique_ptr< detail::replay_pipeline_impl > my;
+};
+
+} } } // voilk::chain::util
+
+FC_REFLECT( voilk::chain::util::replay_pipeline_stats, (blocks_read)(blocks_applied)(reader_stall)(decode_stall)(apply_stall) )
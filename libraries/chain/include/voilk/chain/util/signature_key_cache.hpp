@@ -0,0 +1,100 @@
+#pragma once
+
+#include <voilk/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <mutex>
+
+namespace voilk { namespace chain { namespace util {
+
+using voilk::protocol::chain_id_type;
+using voilk::protocol::public_key_type;
+using voilk::protocol::signature_type;
+using voilk::protocol::signed_transaction;
+using voilk::protocol::transaction_id_type;
+using fc::ecc::canonical_signature_type;
+
+struct signature_key_cache_stats
+{
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t size = 0;
+};
+
+/**
+ * A bounded, least recently used cache of the signing keys of transactions.
+ *
+ * Public key recovery is the most expensive part of transaction application, and a transaction is
+ * usually applied more than once: when it is pushed as a pending transaction, when it arrives in a
+ * block, and again whenever the pending state is rebuilt. Keys are stored when a pending transaction
+ * is pushed and when incoming blocks and transactions are recovered ahead of time on a worker pool,
+ * so later applications of the same transaction only have to check authorities.
+ *
+ * Keys recovered by recover() skip the canonicality check because the required signature type depends
+ * on the hardfork state at the time the transaction is applied. get() performs that check instead, and
+ * only returns keys that were recovered from exactly the signatures the transaction carries.
+ * Transactions whose recovery fails are not cached, so the write thread recovers them again and raises
+ * the error.
+ */
+class signature_key_cache
+{
+   public:
+      signature_key_cache( size_t max_size = default_max_size );
+
+      /** Recover and cache the signing keys of a transaction. Safe to call from any thread. */
+      void recover( const signed_transaction& trx, const chain_id_type& chain_id );
+
+      void insert( const transaction_id_type& id, const vector< signature_type >& signatures,
+         const flat_set< public_key_type >& keys );
+
+      /**
+       * Returns the keys cached for a transaction and marks them as recently used. Returns an empty optional
+       * when the keys are missing, were recovered from different signatures, or a signature is not canonical
+       * under canon_type.
+       */
+      fc::optional< flat_set< public_key_type > > get( const transaction_id_type& id,
+         const vector< signature_type >& signatures, canonical_signature_type canon_type );
+
+      void   set_max_size( size_t max_size );
+      void   clear();
+      size_t size()const;
+
+      signature_key_cache_stats get_stats()const;
+
+      static const size_t default_max_size = 16384;
+
+   private:
+      struct entry
+      {
+         transaction_id_type           id;
+         vector< signature_type >      signatures;
+         flat_set< public_key_type >   keys;
+      };
+
+      struct by_id;
+
+      typedef boost::multi_index_container<
+         entry,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique< boost::multi_index::tag< by_id >,
+               boost::multi_index::member< entry, transaction_id_type, &entry::id >, std::hash< transaction_id_type > >
+         >
+      > entry_index_type;
+
+      void insert( entry&& e );
+
+      size_t               _max_size;
+      entry_index_type     _entries;
+      uint64_t             _hits = 0;
+      uint64_t             _misses = 0;
+      mutable std::mutex   _mutex;
+};
+
+} } } // voilk::chain::util
+
+FC_REFLECT( voilk::chain::util::signature_key_cache_stats, (hits)(misses)(size) )
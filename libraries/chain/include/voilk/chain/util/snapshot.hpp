@@ -0,0 +1,108 @@
+#pragma once
+
+#include <voilk/protocol/types.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/raw.hpp>
+
+#include <fstream>
+
+namespace voilk { namespace chain {
+
+class database;
+
+namespace util {
+
+using voilk::protocol::block_id_type;
+using voilk::protocol::chain_id_type;
+
+/**
+ * A state snapshot is a directory holding a manifest and one file per chainbase index.
+ *
+ * Each index file is the fc::raw serialization of every object in the index, in id order. Unlike
+ * shared_memory.bin it does not depend on the boost version, the allocator layout or the build, only
+ * on the reflected object layouts, which are checked through snapshot_format_version and the index
+ * type names.
+ */
+struct snapshot_index_header
+{
+   std::string       type_name;
+   std::string       file_name;
+   uint64_t          object_count = 0;
+   int64_t           next_id = 0;
+   fc::sha256        checksum;
+};
+
+struct snapshot_manifest
+{
+   uint32_t                         format_version = 0;
+   chain_id_type                    chain_id;
+   uint32_t                         head_block_num = 0;
+   block_id_type                    head_block_id;
+   std::vector< snapshot_index_header > indices;
+};
+
+static const uint32_t snapshot_format_version = 1;
+
+/**
+ * A buffered index file that hashes everything written to it, usable as an fc::raw stream
+ */
+class snapshot_writer
+{
+   public:
+      snapshot_writer( const fc::path& p );
+
+      void write( const char* d, size_t s );
+      void put( char c ) { write( &c, 1 ); }
+
+      /** Flushes and closes the file and returns the hash of its contents */
+      fc::sha256 finish();
+
+   private:
+      fc::path             _path;
+      std::ofstream        _out;
+      fc::sha256::encoder  _hash;
+};
+
+/**
+ * Reads an index file written by snapshot_writer, hashing everything read
+ */
+class snapshot_reader
+{
+   public:
+      snapshot_reader( const fc::path& p );
+
+      void read( char* d, size_t s );
+      void get( char& c ) { read( &c, 1 ); }
+
+      /** Returns the hash of everything read so far, asserting that the whole file has been read */
+      fc::sha256 finish();
+
+   private:
+      fc::path             _path;
+      std::ifstream        _in;
+      fc::sha256::encoder  _hash;
+};
+
+/**
+ * Writes the state of every index to a snapshot in dir, with up to threads indices written in parallel.
+ * Must be called with the read lock held.
+ */
+snapshot_manifest write_snapshot( const database& db, const fc::path& dir, uint32_t threads );
+
+snapshot_manifest read_snapshot_manifest( const fc::path& dir );
+
+/**
+ * Loads every index from the snapshot in dir into an empty database, with up to threads indices loaded
+ * in parallel. Every index of the database must be in the snapshot and the other way around. Must be
+ * called with the write lock held.
+ */
+snapshot_manifest read_snapshot( database& db, const fc::path& dir, uint32_t threads );
+
+} } } // voilk::chain::util
+
+FC_REFLECT( voilk::chain::util::snapshot_index_header, (type_name)(file_name)(object_count)(next_id)(checksum) )
+FC_REFLECT( voilk::chain::util::snapshot_manifest, (format_version)(chain_id)(head_block_num)(head_block_id)(indices) )
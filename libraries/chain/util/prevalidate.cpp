@@ -0,0 +1,24 @@
+#include <voilk/chain/util/prevalidate.hpp>
+#include <voilk/chain/database_exceptions.hpp>
+
+namespace voilk { namespace chain { namespace util {
+
+void prevalidate_transaction( const signed_transaction& trx, const chain_id_type& chain_id,
+   fc::time_point_sec head_time, uint32_t max_block_size, signature_key_cache& cache )
+{
+   trx.validate();
+
+   if( max_block_size > 0 )
+      FC_ASSERT( fc::raw::pack_size( trx ) <= max_block_size - 256 );
+
+   if( head_time > fc::time_point_sec() )
+   {
+      VOILK_ASSERT( trx.expiration <= head_time + fc::seconds( VOILK_MAX_TIME_UNTIL_EXPIRATION ), transaction_expiration_exception,
+                  "", ("trx.expiration",trx.expiration)("now",head_time)("max_til_exp",VOILK_MAX_TIME_UNTIL_EXPIRATION) );
+      VOILK_ASSERT( head_time <= trx.expiration, transaction_expiration_exception, "", ("now",head_time)("trx.exp",trx.expiration) );
+   }
+
+   cache.insert( trx.id(), trx.signatures, trx.get_signature_keys( chain_id, fc::ecc::non_canonical ) );
+}
+
+} } } // voilk::chain::util
@@ -0,0 +1,271 @@
+#include <voilk/chain/util/replay_pipeline.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace voilk { namespace chain { namespace util {
+
+namespace detail {
+
+class replay_pipeline_impl
+{
+   public:
+      enum slot_state
+      {
+         slot_empty,
+         slot_raw,
+         slot_decoding,
+         slot_ready
+      };
+
+      struct slot
+      {
+         slot_state                    state = slot_empty;
+         uint32_t                      block_num = 0;
+         std::vector< char >           raw;
+         signed_block                  block;
+         block_id_type                 id;
+         fc::optional< fc::exception > except;
+      };
+
+      replay_pipeline_impl( const block_log& log, uint32_t first_block, uint32_t last_block, uint32_t queue_depth, uint32_t num_workers );
+      ~replay_pipeline_impl();
+
+      void read_loop();
+      void decode_loop();
+
+      bool next( signed_block& block );
+
+      slot& slot_for( uint32_t block_num ) { return slots[ block_num % slots.size() ]; }
+
+      const block_log&              log;
+      const uint32_t                first_block;
+      const uint32_t                last_block;
+
+      std::vector< slot >           slots;
+      std::deque< uint32_t >        raw_queue;
+      uint32_t                      next_block = 0;
+      block_id_type                 last_id;
+      bool                          reading_done = false;
+      bool                          running = true;
+
+      mutable std::mutex            mtx;
+      std::condition_variable       slot_free_cv;
+      std::condition_variable       raw_ready_cv;
+      std::condition_variable       decoded_cv;
+
+      replay_pipeline_stats         stats;
+
+      std::thread                   reader;
+      std::vector< std::thread >    workers;
+};
+
+replay_pipeline_impl::replay_pipeline_impl( const block_log& l, uint32_t first, uint32_t last, uint32_t queue_depth, uint32_t num_workers )
+   : log( l ), first_block( first ), last_block( last ), slots( std::max( queue_depth, 1u ) ), next_block( first )
+{
+   FC_ASSERT( first_block > 0 && first_block <= last_block, "Invalid replay range", ("first", first_block)("last", last_block) );
+
+   reader = std::thread( [this]() { read_loop(); } );
+
+   for( uint32_t i = 0; i < std::max( num_workers, 1u ); ++i )
+      workers.emplace_back( [this]() { decode_loop(); } );
+}
+
+replay_pipeline_impl::~replay_pipeline_impl()
+{
+   {
+      std::lock_guard< std::mutex > lock( mtx );
+      running = false;
+   }
+
+   slot_free_cv.notify_all();
+   raw_ready_cv.notify_all();
+   decoded_cv.notify_all();
+
+   if( reader.joinable() )
+      reader.join();
+
+   for( auto& w : workers )
+      if( w.joinable() )
+         w.join();
+}
+
+void replay_pipeline_impl::read_loop()
+{
+   for( uint32_t block_num = first_block; block_num <= last_block; ++block_num )
+   {
+      slot& s = slot_for( block_num );
+
+      {
+         std::unique_lock< std::mutex > lock( mtx );
+         if( s.state != slot_empty )
+         {
+            auto start = fc::time_point::now();
+            slot_free_cv.wait( lock, [&]() { return s.state == slot_empty || !running; } );
+            stats.reader_stall += fc::time_point::now() - start;
+         }
+
+         if( !running )
+            return;
+      }
+
+      std::vector< char > raw;
+      fc::optional< fc::exception > except;
+
+      try
+      {
+         raw = log.read_raw_block_by_num( block_num );
+         FC_ASSERT( raw.size(), "Block ${n} is missing from the block log", ("n", block_num) );
+      }
+      catch( const fc::exception& e )
+      {
+         except = e;
+      }
+      catch( ... )
+      {
+         except = fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unexpected exception while reading block." ),
+                                           std::current_exception() );
+      }
+
+      {
+         std::lock_guard< std::mutex > lock( mtx );
+         s.block_num = block_num;
+         ++stats.blocks_read;
+
+         if( except )
+         {
+            // Hand the error to the apply stage and stop reading, there is nothing sensible to do past it.
+            s.except = except;
+            s.state = slot_ready;
+            reading_done = true;
+            decoded_cv.notify_all();
+            raw_ready_cv.notify_all();
+            return;
+         }
+
+         s.raw = std::move( raw );
+         s.state = slot_raw;
+         raw_queue.push_back( block_num );
+      }
+
+      raw_ready_cv.notify_one();
+   }
+
+   {
+      std::lock_guard< std::mutex > lock( mtx );
+      reading_done = true;
+   }
+
+   raw_ready_cv.notify_all();
+}
+
+void replay_pipeline_impl::decode_loop()
+{
+   while( true )
+   {
+      slot* s = nullptr;
+
+      {
+         std::unique_lock< std::mutex > lock( mtx );
+         if( raw_queue.empty() && !reading_done && running )
+         {
+            auto start = fc::time_point::now();
+            raw_ready_cv.wait( lock, [&]() { return !raw_queue.empty() || reading_done || !running; } );
+            stats.decode_stall += fc::time_point::now() - start;
+         }
+
+         if( !running || raw_queue.empty() )
+            return;
+
+         s = &slot_for( raw_queue.front() );
+         raw_queue.pop_front();
+         s->state = slot_decoding;
+      }
+
+      try
+      {
+         fc::raw::unpack_from_vector( s->raw, s->block );
+         s->id = s->block.id();
+         FC_ASSERT( block_header::num_from_id( s->id ) == s->block_num, "Wrong block was read from block log.",
+            ("returned", block_header::num_from_id( s->id ))("expected", s->block_num) );
+      }
+      catch( const fc::exception& e )
+      {
+         s->except = e;
+      }
+      catch( ... )
+      {
+         s->except = fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unexpected exception while decoding block." ),
+                                              std::current_exception() );
+      }
+
+      {
+         std::lock_guard< std::mutex > lock( mtx );
+         s->raw = std::vector< char >();
+         s->state = slot_ready;
+      }
+
+      decoded_cv.notify_all();
+   }
+}
+
+bool replay_pipeline_impl::next( signed_block& block )
+{
+   if( next_block > last_block )
+      return false;
+
+   slot& s = slot_for( next_block );
+
+   {
+      std::unique_lock< std::mutex > lock( mtx );
+      if( s.state != slot_ready || s.block_num != next_block )
+      {
+         auto start = fc::time_point::now();
+         decoded_cv.wait( lock, [&]() { return ( s.state == slot_ready && s.block_num == next_block ) || !running; } );
+         stats.apply_stall += fc::time_point::now() - start;
+      }
+
+      FC_ASSERT( running, "Replay pipeline was stopped" );
+
+      if( s.except )
+         throw *s.except;
+
+      // The decode workers hash every block, so the apply stage can check chain linkage for the price of a compare.
+      FC_ASSERT( next_block == first_block || s.block.previous == last_id, "Block log is not a chain",
+         ("block_num", next_block)("previous", s.block.previous)("expected", last_id) );
+
+      block = std::move( s.block );
+      last_id = s.id;
+      s.block = signed_block();
+      s.state = slot_empty;
+      ++stats.blocks_applied;
+   }
+
+   slot_free_cv.notify_one();
+   ++next_block;
+   return true;
+}
+
+} // detail
+
+replay_pipeline::replay_pipeline( const block_log& log, uint32_t first_block, uint32_t last_block, uint32_t queue_depth, uint32_t num_workers )
+   : my( new detail::replay_pipeline_impl( log, first_block, last_block, queue_depth, num_workers ) ) {}
+
+replay_pipeline::~replay_pipeline() {}
+
+bool replay_pipeline::next( signed_block& block )
+{
+   return my->next( block );
+}
+
+replay_pipeline_stats replay_pipeline::get_stats()const
+{
+   std::lock_guard< std::mutex > lock( my->mtx );
+   return my->stats;
+}
+
+} } } // voilk::chain::util
@@ -0,0 +1,118 @@
+#include <voilk/chain/util/signature_key_cache.hpp>
+
+namespace voilk { namespace chain { namespace util {
+
+signature_key_cache::signature_key_cache( size_t max_size ) : _max_size( std::max< size_t >( max_size, 1 ) ) {}
+
+void signature_key_cache::recover( const signed_transaction& trx, const chain_id_type& chain_id )
+{
+   entry e;
+
+   try
+   {
+      e.id = trx.id();
+      e.signatures = trx.signatures;
+      e.keys = trx.get_signature_keys( chain_id, fc::ecc::non_canonical );
+   }
+   catch( ... )
+   {
+      // Leave invalid transactions to the write thread, which recovers them again and reports the error.
+      return;
+   }
+
+   insert( std::move( e ) );
+}
+
+void signature_key_cache::insert( const transaction_id_type& id, const vector< signature_type >& signatures,
+   const flat_set< public_key_type >& keys )
+{
+   entry e;
+   e.id = id;
+   e.signatures = signatures;
+   e.keys = keys;
+   insert( std::move( e ) );
+}
+
+void signature_key_cache::insert( entry&& e )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   auto& idx = _entries.get< by_id >();
+   auto itr = idx.find( e.id );
+   if( itr != idx.end() )
+      idx.erase( itr );
+
+   _entries.push_back( std::move( e ) );
+
+   while( _entries.size() > _max_size )
+      _entries.pop_front();
+}
+
+fc::optional< flat_set< public_key_type > > signature_key_cache::get( const transaction_id_type& id,
+   const vector< signature_type >& signatures, canonical_signature_type canon_type )
+{
+   fc::optional< flat_set< public_key_type > > result;
+
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+
+      auto& idx = _entries.get< by_id >();
+      auto itr = idx.find( id );
+
+      // The transaction id does not cover signatures, a malleated copy must not pick up these keys.
+      if( itr == idx.end() || itr->signatures != signatures )
+      {
+         ++_misses;
+         return result;
+      }
+
+      ++_hits;
+      result = itr->keys;
+      _entries.relocate( _entries.end(), _entries.project< 0 >( itr ) );
+   }
+
+   for( const auto& sig : signatures )
+   {
+      if( !fc::ecc::public_key::is_canonical( sig, canon_type ) )
+      {
+         result.reset();
+         break;
+      }
+   }
+
+   return result;
+}
+
+void signature_key_cache::set_max_size( size_t max_size )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   _max_size = std::max< size_t >( max_size, 1 );
+
+   while( _entries.size() > _max_size )
+      _entries.pop_front();
+}
+
+void signature_key_cache::clear()
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   _entries.clear();
+}
+
+size_t signature_key_cache::size()const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   return _entries.size();
+}
+
+signature_key_cache_stats signature_key_cache::get_stats()const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   signature_key_cache_stats stats;
+   stats.hits = _hits;
+   stats.misses = _misses;
+   stats.size = _entries.size();
+   return stats;
+}
+
+} } } // voilk::chain::util
@@ -0,0 +1,223 @@
+#include <voilk/chain/util/snapshot.hpp>
+
+#include <voilk/chain/database.hpp>
+#include <voilk/chain/index.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace voilk { namespace chain { namespace util {
+
+namespace detail {
+
+std::shared_ptr< index_info > get_index_info( const chainbase::abstract_index& idx )
+{
+   for( const auto& ext : idx.get_index_extensions() )
+   {
+      auto info = std::dynamic_pointer_cast< index_info >( ext );
+      if( info )
+         return info;
+   }
+
+   FC_THROW_EXCEPTION( fc::assert_exception, "Index with type id ${t} has no index_info extension and cannot be used in a snapshot", ("t", idx.type_id()) );
+}
+
+std::string get_type_name( index_info& info )
+{
+   std::string name;
+   info.get_schema()->get_name( name );
+   return name;
+}
+
+/**
+ * Calls work( i ) for every i in [0, count), spread over up to num_threads threads including the
+ * calling one. Rethrows the error of the lowest failing i once all work is done.
+ */
+template< typename Lambda >
+void parallel_for( size_t count, uint32_t num_threads, Lambda&& work )
+{
+   std::atomic< size_t > next( 0 );
+   std::vector< fc::optional< fc::exception > > errors( count );
+
+   auto worker = [&]()
+   {
+      for( size_t i = next++; i < count; i = next++ )
+      {
+         try
+         {
+            work( i );
+         }
+         catch( const fc::exception& e )
+         {
+            errors[i] = e;
+         }
+         catch( ... )
+         {
+            errors[i] = fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unexpected exception in snapshot worker." ),
+                                                 std::current_exception() );
+         }
+      }
+   };
+
+   std::vector< std::thread > threads;
+   for( size_t t = 1; t < std::min< size_t >( std::max< uint32_t >( num_threads, 1 ), count ); ++t )
+      threads.emplace_back( worker );
+
+   worker();
+
+   for( auto& t : threads )
+      t.join();
+
+   for( const auto& e : errors )
+      if( e )
+         e->dynamic_rethrow_exception();
+}
+
+} // detail
+
+snapshot_writer::snapshot_writer( const fc::path& p ) : _path( p )
+{
+   _out.open( p.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   FC_ASSERT( _out.good(), "Could not open ${p} for writing", ("p", p) );
+}
+
+void snapshot_writer::write( const char* d, size_t s )
+{
+   _out.write( d, s );
+   _hash.write( d, s );
+}
+
+fc::sha256 snapshot_writer::finish()
+{
+   _out.close();
+   FC_ASSERT( !_out.fail(), "Error writing ${p}", ("p", _path) );
+   return _hash.result();
+}
+
+snapshot_reader::snapshot_reader( const fc::path& p ) : _path( p )
+{
+   _in.open( p.generic_string(), std::ios::in | std::ios::binary );
+   FC_ASSERT( _in.good(), "Could not open ${p} for reading", ("p", p) );
+}
+
+void snapshot_reader::read( char* d, size_t s )
+{
+   _in.read( d, s );
+   FC_ASSERT( size_t( _in.gcount() ) == s, "Unexpected end of ${p}", ("p", _path) );
+   _hash.write( d, s );
+}
+
+fc::sha256 snapshot_reader::finish()
+{
+   FC_ASSERT( _in.peek() == std::ifstream::traits_type::eof(), "Unexpected data at the end of ${p}", ("p", _path) );
+   return _hash.result();
+}
+
+snapshot_manifest write_snapshot( const database& db, const fc::path& dir, uint32_t threads )
+{ try {
+   FC_ASSERT( !fc::exists( dir / "manifest" ), "Refusing to overwrite the snapshot in ${d}", ("d", dir) );
+   fc::create_directories( dir );
+
+   const auto& indices = db.get_abstract_index_cntr();
+   std::vector< std::shared_ptr< index_info > > infos;
+
+   snapshot_manifest manifest;
+   manifest.format_version = snapshot_format_version;
+   manifest.chain_id = db.get_chain_id();
+   manifest.head_block_num = db.head_block_num();
+   manifest.head_block_id = db.head_block_id();
+   manifest.indices.resize( indices.size() );
+
+   for( size_t i = 0; i < indices.size(); ++i )
+   {
+      infos.push_back( detail::get_index_info( *indices[i] ) );
+
+      auto& header = manifest.indices[i];
+      header.type_name = detail::get_type_name( *infos[i] );
+
+      std::stringstream file_name;
+      file_name << std::setw( 3 ) << std::setfill( '0' ) << i << '_'
+                << header.type_name.substr( header.type_name.rfind( ':' ) + 1 ) << ".bin";
+      header.file_name = file_name.str();
+   }
+
+   detail::parallel_for( indices.size(), threads, [&]( size_t i )
+   {
+      auto& header = manifest.indices[i];
+      snapshot_writer out( dir / header.file_name );
+      infos[i]->write_snapshot( db, out, header );
+      header.checksum = out.finish();
+   });
+
+   // The manifest is written last, a snapshot without one is incomplete
+   auto packed = fc::raw::pack_to_vector( manifest );
+   std::ofstream out( ( dir / "manifest" ).generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   out.write( packed.data(), packed.size() );
+   out.close();
+   FC_ASSERT( !out.fail(), "Error writing the snapshot manifest to ${d}", ("d", dir) );
+
+   return manifest;
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+snapshot_manifest read_snapshot_manifest( const fc::path& dir )
+{ try {
+   FC_ASSERT( fc::exists( dir / "manifest" ), "No snapshot found in ${d}", ("d", dir) );
+
+   std::ifstream in( ( dir / "manifest" ).generic_string(), std::ios::in | std::ios::binary );
+   FC_ASSERT( in.good(), "Could not open ${p} for reading", ("p", dir / "manifest") );
+
+   std::vector< char > packed( fc::file_size( dir / "manifest" ) );
+   if( packed.size() )
+      in.read( packed.data(), packed.size() );
+   FC_ASSERT( in.good() && size_t( in.gcount() ) == packed.size(), "Error reading ${p}", ("p", dir / "manifest") );
+
+   auto manifest = fc::raw::unpack_from_vector< snapshot_manifest >( packed );
+   FC_ASSERT( manifest.format_version == snapshot_format_version, "Snapshot format version ${v} is not supported, expected ${e}",
+      ("v", manifest.format_version)("e", snapshot_format_version) );
+
+   return manifest;
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+snapshot_manifest read_snapshot( database& db, const fc::path& dir, uint32_t threads )
+{ try {
+   auto manifest = read_snapshot_manifest( dir );
+   FC_ASSERT( manifest.chain_id == db.get_chain_id(), "Snapshot is for chain ${s}, not ${c}",
+      ("s", manifest.chain_id)("c", db.get_chain_id()) );
+
+   std::map< std::string, const snapshot_index_header* > headers;
+   for( const auto& header : manifest.indices )
+      headers[ header.type_name ] = &header;
+
+   const auto& indices = db.get_abstract_index_cntr();
+   std::vector< std::shared_ptr< index_info > > infos;
+   std::vector< const snapshot_index_header* > index_headers;
+
+   for( const auto* idx : indices )
+   {
+      infos.push_back( detail::get_index_info( *idx ) );
+      std::string type_name = detail::get_type_name( *infos.back() );
+
+      auto itr = headers.find( type_name );
+      FC_ASSERT( itr != headers.end(), "Snapshot does not contain ${t}, it was written by a node without the plugin that adds it", ("t", type_name) );
+      index_headers.push_back( itr->second );
+      headers.erase( itr );
+   }
+
+   FC_ASSERT( headers.empty(), "Snapshot contains ${t}, enable the plugin that adds it", ("t", headers.begin()->first) );
+
+   detail::parallel_for( indices.size(), threads, [&]( size_t i )
+   {
+      const auto& header = *index_headers[i];
+      snapshot_reader in( dir / header.file_name );
+      infos[i]->read_snapshot( db, in, header );
+      FC_ASSERT( in.finish() == header.checksum, "Checksum mismatch in ${f}", ("f", header.file_name) );
+   });
+
+   return manifest;
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+} } } // voilk::chain::util
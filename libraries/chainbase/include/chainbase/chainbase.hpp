@@ -21,12 +21,17 @@
 #include <boost/throw_exception.hpp>
 
 #include <chainbase/allocators.hpp>
+#include <chainbase/flat_undo_log.hpp>
+#include <chainbase/instrumentation.hpp>
 #include <chainbase/util/object_id.hpp>
 
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <typeindex>
 #include <typeinfo>
@@ -161,6 +166,226 @@ namespace chainbase {
          int64_t                      revision = 0;
    };
 
+   /**
+    * The default undo log. Each undo session keeps an undo_state holding ordered maps of the values
+    * it must restore, the values it must re-insert and the ids it must erase.
+    */
+   template< typename value_type >
+   class undo_state_stack
+   {
+      public:
+         typedef typename value_type::id_type   id_type;
+         typedef undo_state< value_type >       undo_state_type;
+
+         template< typename T >
+         undo_state_stack( allocator< T > a )
+         :_stack( allocator< undo_state_type >( a ) ){}
+
+         bool   enabled()const { return _stack.size(); }
+         size_t size()const { return _stack.size(); }
+
+         void start( int64_t revision, id_type next_id )
+         {
+            _stack.emplace_back( _stack.get_allocator() );
+            _stack.back().old_next_id = next_id;
+            _stack.back().revision = revision;
+         }
+
+         /**
+          * Restores the objects changed by the most recent session and returns the next id from
+          * before the session was started.
+          */
+         template< typename IndexType >
+         id_type undo( IndexType& indices )
+         {
+            auto& head = _stack.back();
+
+            for( auto& item : head.old_values ) {
+               auto ok = indices.modify( indices.find( item.second.id ), [&]( value_type& v ) {
+                  v = std::move( item.second );
+               });
+               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            }
+
+            for( const auto& id : head.new_ids )
+            {
+               indices.erase( indices.find( id ) );
+            }
+
+            for( auto& item : head.removed_values ) {
+               bool ok = indices.emplace( std::move( item.second ) ).second;
+               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not restore object, most likely a uniqueness constraint was violated" ) );
+            }
+
+            id_type old_next_id = head.old_next_id;
+            _stack.pop_back();
+            return old_next_id;
+         }
+
+         /**
+          * Merges the two most recent sessions into one.
+          */
+         void squash()
+         {
+            auto& state = _stack.back();
+            auto& prev_state = _stack[_stack.size()-2];
+
+            // An object's relationship to a state can be:
+            // in new_ids            : new
+            // in old_values (was=X) : upd(was=X)
+            // in removed (was=X)    : del(was=X)
+            // not in any of above   : nop
+            //
+            // When merging A=prev_state and B=state we have a 4x4 matrix of all possibilities:
+            //
+            //                   |--------------------- B ----------------------|
+            //
+            //                +------------+------------+------------+------------+
+            //                | new        | upd(was=Y) | del(was=Y) | nop        |
+            //   +------------+------------+------------+------------+------------+
+            // / | new        | N/A        | new       A| nop       C| new       A|
+            // | +------------+------------+------------+------------+------------+
+            // | | upd(was=X) | N/A        | upd(was=X)A| del(was=X)C| upd(was=X)A|
+            // A +------------+------------+------------+------------+------------+
+            // | | del(was=X) | N/A        | N/A        | N/A        | del(was=X)A|
+            // | +------------+------------+------------+------------+------------+
+            // \ | nop        | new       B| upd(was=Y)B| del(was=Y)B| nop      AB|
+            //   +------------+------------+------------+------------+------------+
+            //
+            // Each entry was composed by labelling what should occur in the given case.
+            //
+            // Type A means the composition of states contains the same entry as the first of the two merged states for that object.
+            // Type B means the composition of states contains the same entry as the second of the two merged states for that object.
+            // Type C means the composition of states contains an entry different from either of the merged states for that object.
+            // Type N/A means the composition of states violates causal timing.
+            // Type AB means both type A and type B simultaneously.
+            //
+            // The merge() operation is defined as modifying prev_state in-place to be the state object which represents the composition of
+            // state A and B.
+            //
+            // Type A (and AB) can be implemented as a no-op; prev_state already contains the correct value for the merged state.
+            // Type B (and AB) can be implemented by copying from state to prev_state.
+            // Type C needs special case-by-case logic.
+            // Type N/A can be ignored or assert(false) as it can only occur if prev_state and state have illegal values
+            // (a serious logic error which should never happen).
+            //
+
+            // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
+
+            for( const auto& item : state.old_values )
+            {
+               if( prev_state.new_ids.find( item.second.id ) != prev_state.new_ids.end() )
+               {
+                  // new+upd -> new, type A
+                  continue;
+               }
+               if( prev_state.old_values.find( item.second.id ) != prev_state.old_values.end() )
+               {
+                  // upd(was=X) + upd(was=Y) -> upd(was=X), type A
+                  continue;
+               }
+               // del+upd -> N/A
+               assert( prev_state.removed_values.find(item.second.id) == prev_state.removed_values.end() );
+               // nop+upd(was=Y) -> upd(was=Y), type B
+               prev_state.old_values.emplace( std::move(item) );
+            }
+
+            // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
+            for( const auto& id : state.new_ids )
+               prev_state.new_ids.insert(id);
+
+            // *+del
+            for( auto& obj : state.removed_values )
+            {
+               if( prev_state.new_ids.find(obj.second.id) != prev_state.new_ids.end() )
+               {
+                  // new + del -> nop (type C)
+                  prev_state.new_ids.erase(obj.second.id);
+                  continue;
+               }
+               auto it = prev_state.old_values.find(obj.second.id);
+               if( it != prev_state.old_values.end() )
+               {
+                  // upd(was=X) + del(was=Y) -> del(was=X)
+                  prev_state.removed_values.emplace( std::move(*it) );
+                  prev_state.old_values.erase(obj.second.id);
+                  continue;
+               }
+               // del + del -> N/A
+               assert( prev_state.removed_values.find( obj.second.id ) == prev_state.removed_values.end() );
+               // nop + del(was=Y) -> del(was=Y)
+               prev_state.removed_values.emplace( std::move(obj) ); //[obj.second->id] = std::move(obj.second);
+            }
+
+            _stack.pop_back();
+         }
+
+         /**
+          * Discards all sessions up to and including revision
+          */
+         void commit( int64_t revision )
+         {
+            while( _stack.size() && _stack[0].revision <= revision )
+            {
+               _stack.pop_front();
+            }
+         }
+
+         /** Returns true when a copy of v was saved */
+         bool on_modify( const value_type& v ) {
+            auto& head = _stack.back();
+
+            if( head.new_ids.find( v.id ) != head.new_ids.end() )
+               return false;
+
+            auto itr = head.old_values.find( v.id );
+            if( itr != head.old_values.end() )
+               return false;
+
+            head.old_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+            return true;
+         }
+
+         /** Returns true when a copy of v was saved */
+         bool on_remove( const value_type& v ) {
+            auto& head = _stack.back();
+            if( head.new_ids.count(v.id) ) {
+               head.new_ids.erase( v.id );
+               return false;
+            }
+
+            auto itr = head.old_values.find( v.id );
+            if( itr != head.old_values.end() ) {
+               head.removed_values.emplace( std::move( *itr ) );
+               head.old_values.erase( v.id );
+               return false;
+            }
+
+            if( head.removed_values.count( v.id ) )
+               return false;
+
+            head.removed_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+            return true;
+         }
+
+         void on_create( const value_type& v ) {
+            auto& head = _stack.back();
+
+            head.new_ids.insert( v.id );
+         }
+
+      private:
+         boost::interprocess::deque< undo_state_type, allocator<undo_state_type> > _stack;
+   };
+
+#ifdef CHAINBASE_FLAT_UNDO_LOG
+   template< typename value_type >
+   using default_undo_log = flat_undo_log< value_type >;
+#else
+   template< typename value_type >
+   using default_undo_log = undo_state_stack< value_type >;
+#endif
+
    /**
     * The code we want to implement is this:
     *
@@ -193,18 +418,20 @@ namespace chainbase {
     *  be the primary key and it will be assigned and managed by generic_index.
     *
     *  Additionally, the constructor for value_type must take an allocator
+    *
+    *  UndoLog records the changes made in each undo session, see undo_state_stack and flat_undo_log.
     */
-   template<typename MultiIndexType>
+   template<typename MultiIndexType, typename UndoLog = default_undo_log< typename MultiIndexType::value_type > >
    class generic_index
    {
       public:
          typedef MultiIndexType                                        index_type;
          typedef typename index_type::value_type                       value_type;
          typedef allocator< generic_index >                            allocator_type;
-         typedef undo_state< value_type >                              undo_state_type;
+         typedef UndoLog                                               undo_log_type;
 
          generic_index( allocator<value_type> a )
-         :_stack(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::node_type) ),_size_of_this(sizeof(*this)){}
+         :_undo_log(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::node_type) ),_size_of_this(sizeof(*this)){}
 
          void validate()const {
             if( sizeof(typename MultiIndexType::node_type) != _size_of_value_type || sizeof(*this) != _size_of_this )
@@ -235,16 +462,20 @@ namespace chainbase {
             return *insert_result.first;
          }
 
+         /** Returns true when a copy of obj was saved for undo */
          template<typename Modifier>
-         void modify( const value_type& obj, Modifier&& m ) {
-            on_modify( obj );
+         bool modify( const value_type& obj, Modifier&& m ) {
+            bool saved = on_modify( obj );
             auto ok = _indices.modify( _indices.iterator_to( obj ), m );
             if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            return saved;
          }
 
-         void remove( const value_type& obj ) {
-            on_remove( obj );
+         /** Returns true when a copy of obj was saved for undo */
+         bool remove( const value_type& obj ) {
+            bool saved = on_remove( obj );
             _indices.erase( _indices.iterator_to( obj ) );
+            return saved;
          }
 
          template<typename CompatibleKey>
@@ -306,9 +537,7 @@ namespace chainbase {
 
          session start_undo_session()
          {
-            _stack.emplace_back( _indices.get_allocator() );
-            _stack.back().old_next_id = _next_id;
-            _stack.back().revision = ++_revision;
+            _undo_log.start( ++_revision, _next_id );
             return session( *this, _revision );
          }
 
@@ -323,27 +552,7 @@ namespace chainbase {
          void undo() {
             if( !enabled() ) return;
 
-            const auto& head = _stack.back();
-
-            for( auto& item : head.old_values ) {
-               auto ok = _indices.modify( _indices.find( item.second.id ), [&]( value_type& v ) {
-                  v = std::move( item.second );
-               });
-               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
-            }
-
-            for( const auto& id : head.new_ids )
-            {
-               _indices.erase( _indices.find( id ) );
-            }
-            _next_id = head.old_next_id;
-
-            for( auto& item : head.removed_values ) {
-               bool ok = _indices.emplace( std::move( item.second ) ).second;
-               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not restore object, most likely a uniqueness constraint was violated" ) );
-            }
-
-            _stack.pop_back();
+            _next_id = _undo_log.undo( _indices );
             --_revision;
          }
 
@@ -356,102 +565,12 @@ namespace chainbase {
          void squash()
          {
             if( !enabled() ) return;
-            if( _stack.size() == 1 ) {
-               _stack.pop_front();
+            if( _undo_log.size() == 1 ) {
+               _undo_log.commit( _revision );
                return;
             }
 
-            auto& state = _stack.back();
-            auto& prev_state = _stack[_stack.size()-2];
-
-            // An object's relationship to a state can be:
-            // in new_ids            : new
-            // in old_values (was=X) : upd(was=X)
-            // in removed (was=X)    : del(was=X)
-            // not in any of above   : nop
-            //
-            // When merging A=prev_state and B=state we have a 4x4 matrix of all possibilities:
-            //
-            //                   |--------------------- B ----------------------|
-            //
-            //                +------------+------------+------------+------------+
-            //                | new        | upd(was=Y) | del(was=Y) | nop        |
-            //   +------------+------------+------------+------------+------------+
-            // / | new        | N/A        | new       A| nop       C| new       A|
-            // | +------------+------------+------------+------------+------------+
-            // | | upd(was=X) | N/A        | upd(was=X)A| del(was=X)C| upd(was=X)A|
-            // A +------------+------------+------------+------------+------------+
-            // | | del(was=X) | N/A        | N/A        | N/A        | del(was=X)A|
-            // | +------------+------------+------------+------------+------------+
-            // \ | nop        | new       B| upd(was=Y)B| del(was=Y)B| nop      AB|
-            //   +------------+------------+------------+------------+------------+
-            //
-            // Each entry was composed by labelling what should occur in the given case.
-            //
-            // Type A means the composition of states contains the same entry as the first of the two merged states for that object.
-            // Type B means the composition of states contains the same entry as the second of the two merged states for that object.
-            // Type C means the composition of states contains an entry different from either of the merged states for that object.
-            // Type N/A means the composition of states violates causal timing.
-            // Type AB means both type A and type B simultaneously.
-            //
-            // The merge() operation is defined as modifying prev_state in-place to be the state object which represents the composition of
-            // state A and B.
-            //
-            // Type A (and AB) can be implemented as a no-op; prev_state already contains the correct value for the merged state.
-            // Type B (and AB) can be implemented by copying from state to prev_state.
-            // Type C needs special case-by-case logic.
-            // Type N/A can be ignored or assert(false) as it can only occur if prev_state and state have illegal values
-            // (a serious logic error which should never happen).
-            //
-
-            // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
-
-            for( const auto& item : state.old_values )
-            {
-               if( prev_state.new_ids.find( item.second.id ) != prev_state.new_ids.end() )
-               {
-                  // new+upd -> new, type A
-                  continue;
-               }
-               if( prev_state.old_values.find( item.second.id ) != prev_state.old_values.end() )
-               {
-                  // upd(was=X) + upd(was=Y) -> upd(was=X), type A
-                  continue;
-               }
-               // del+upd -> N/A
-               assert( prev_state.removed_values.find(item.second.id) == prev_state.removed_values.end() );
-               // nop+upd(was=Y) -> upd(was=Y), type B
-               prev_state.old_values.emplace( std::move(item) );
-            }
-
-            // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
-            for( const auto& id : state.new_ids )
-               prev_state.new_ids.insert(id);
-
-            // *+del
-            for( auto& obj : state.removed_values )
-            {
-               if( prev_state.new_ids.find(obj.second.id) != prev_state.new_ids.end() )
-               {
-                  // new + del -> nop (type C)
-                  prev_state.new_ids.erase(obj.second.id);
-                  continue;
-               }
-               auto it = prev_state.old_values.find(obj.second.id);
-               if( it != prev_state.old_values.end() )
-               {
-                  // upd(was=X) + del(was=Y) -> del(was=X)
-                  prev_state.removed_values.emplace( std::move(*it) );
-                  prev_state.old_values.erase(obj.second.id);
-                  continue;
-               }
-               // del + del -> N/A
-               assert( prev_state.removed_values.find( obj.second.id ) == prev_state.removed_values.end() );
-               // nop + del(was=Y) -> del(was=Y)
-               prev_state.removed_values.emplace( std::move(obj) ); //[obj.second->id] = std::move(obj.second);
-            }
-
-            _stack.pop_back();
+            _undo_log.squash();
             --_revision;
          }
 
@@ -460,10 +579,7 @@ namespace chainbase {
           */
          void commit( int64_t revision )
          {
-            while( _stack.size() && _stack[0].revision <= revision )
-            {
-               _stack.pop_front();
-            }
+            _undo_log.commit( revision );
          }
 
          /**
@@ -477,58 +593,41 @@ namespace chainbase {
 
          void set_revision( int64_t revision )
          {
-            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set revision while there is an existing undo stack") );
+            if( _undo_log.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set revision while there is an existing undo stack") );
             _revision = revision;
          }
 
-      private:
-         bool enabled()const { return _stack.size(); }
+         /** The id the next created object will get */
+         typename value_type::id_type next_id()const { return _next_id; }
 
-         void on_modify( const value_type& v ) {
-            if( !enabled() ) return;
-
-            auto& head = _stack.back();
-
-            if( head.new_ids.find( v.id ) != head.new_ids.end() )
-               return;
-
-            auto itr = head.old_values.find( v.id );
-            if( itr != head.old_values.end() )
-               return;
-
-            head.old_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+         /**
+          * Sets the id of the next created object, used when objects are loaded with ids that were assigned elsewhere.
+          */
+         void set_next_id( typename value_type::id_type next_id )
+         {
+            if( _undo_log.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set next id while there is an existing undo stack") );
+            _next_id = next_id;
          }
 
-         void on_remove( const value_type& v ) {
-            if( !enabled() ) return;
-
-            auto& head = _stack.back();
-            if( head.new_ids.count(v.id) ) {
-               head.new_ids.erase( v.id );
-               return;
-            }
-
-            auto itr = head.old_values.find( v.id );
-            if( itr != head.old_values.end() ) {
-               head.removed_values.emplace( std::move( *itr ) );
-               head.old_values.erase( v.id );
-               return;
-            }
+      private:
+         bool enabled()const { return _undo_log.enabled(); }
 
-            if( head.removed_values.count( v.id ) )
-               return;
+         bool on_modify( const value_type& v ) {
+            if( !enabled() ) return false;
+            return _undo_log.on_modify( v );
+         }
 
-            head.removed_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+         bool on_remove( const value_type& v ) {
+            if( !enabled() ) return false;
+            return _undo_log.on_remove( v );
          }
 
          void on_create( const value_type& v ) {
             if( !enabled() ) return;
-            auto& head = _stack.back();
-
-            head.new_ids.insert( v.id );
+            _undo_log.on_create( v );
          }
 
-         boost::interprocess::deque< undo_state_type, allocator<undo_state_type> > _stack;
+         undo_log_type                   _undo_log;
 
          /**
           *  Each new session increments the revision, a squash will decrement the revision by combining
@@ -598,9 +697,13 @@ namespace chainbase {
          void add_index_extension( std::shared_ptr< index_extension > ext )  { _extensions.push_back( ext ); }
          const index_extensions& get_index_extensions()const  { return _extensions; }
          void* get()const { return _idx_ptr; }
+
+         index_activity& get_activity() { return _activity; }
+         const index_activity& get_activity()const { return _activity; }
       private:
          void*              _idx_ptr;
          index_extensions   _extensions;
+         index_activity     _activity;
    };
 
    template<typename BaseIndex>
@@ -648,6 +751,7 @@ namespace chainbase {
          read_write_mutex_manager()
          {
             _current_lock = 0;
+            _waiting_readers = 0;
          }
 
          ~read_write_mutex_manager(){}
@@ -668,9 +772,69 @@ namespace chainbase {
             return _current_lock;
          }
 
+         /**
+          * Number of readers blocked waiting for the current lock. A writer holding the lock for a batch of
+          * writes can check this between writes and release the lock early, so readers are served from the
+          * state between two writes instead of waiting for the whole batch.
+          *
+          * This only shortens the wait. Readers and the writer still exclude each other, readers see whatever
+          * state the last write left rather than a snapshot of the last applied block, and a reader can still
+          * time out with lock_exception.
+          */
+         uint32_t waiting_readers()const
+         {
+            return _waiting_readers;
+         }
+
+         /**
+          * Blocks the writer that just released the lock until every waiting reader got it, deadline passes or
+          * stop_waiting_for_readers() is called. Returns true when no reader is waiting anymore.
+          */
+         bool wait_for_waiting_readers( const std::chrono::steady_clock::time_point& deadline )
+         {
+            std::unique_lock< std::mutex > lock( _wait_mutex );
+            _wait_cond.wait_until( lock, deadline, [&]() { return _waiting_readers == 0 || _stop_waiting; } );
+            _stop_waiting = false;
+            return _waiting_readers == 0;
+         }
+
+         /** Wakes the writer blocked in wait_for_waiting_readers(), when it has something more urgent to do */
+         void stop_waiting_for_readers()
+         {
+            {
+               std::lock_guard< std::mutex > lock( _wait_mutex );
+               _stop_waiting = true;
+            }
+
+            _wait_cond.notify_all();
+         }
+
+         class read_wait
+         {
+            public:
+               read_wait( read_write_mutex_manager& m ) : _manager( m ) { ++_manager._waiting_readers; }
+               ~read_wait()
+               {
+                  {
+                     std::lock_guard< std::mutex > lock( _manager._wait_mutex );
+                     --_manager._waiting_readers;
+                  }
+
+                  _manager._wait_cond.notify_all();
+               }
+
+            private:
+               read_write_mutex_manager& _manager;
+         };
+
       private:
          std::array< read_write_mutex, CHAINBASE_NUM_RW_LOCKS >     _locks;
          std::atomic< uint32_t >                                    _current_lock;
+         std::atomic< uint32_t >                                    _waiting_readers;
+
+         std::mutex                                                 _wait_mutex;
+         std::condition_variable                                    _wait_cond;
+         bool                                                       _stop_waiting = false;
    };
 
    struct lock_exception : public std::exception
@@ -788,6 +952,22 @@ namespace chainbase {
          void commit( int64_t revision );
          void undo_all();
 
+         /**
+          *  Applies all following changes without recording undo history, for changes that can never be undone.
+          *
+          *  Existing undo history is committed, which requires that no undo sessions are open. Until enable_undo()
+          *  is called, start_undo_session() returns an empty session that neither allocates undo state nor
+          *  increments the revision, and undo() and undo_all() throw.
+          */
+         void disable_undo();
+
+         /**
+          *  Resumes recording undo history, starting from revision.
+          */
+         void enable_undo( int64_t revision );
+
+         bool is_undo_disabled()const { return _undo_disabled; }
+
 
          void set_revision( int64_t revision )
          {
@@ -948,7 +1128,10 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("modify", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
-             get_mutable_index<index_type>().modify( obj, m );
+             index_activity* activity = get_activity_if_enabled< ObjectType >();
+             index_activity_timer timer( activity, &index_activity::modifies );
+             if( get_mutable_index<index_type>().modify( obj, m ) && activity )
+                activity->undo_bytes += sizeof( ObjectType );
          }
 
          template<typename ObjectType>
@@ -956,7 +1139,10 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("remove", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
-             return get_mutable_index<index_type>().remove( obj );
+             index_activity* activity = get_activity_if_enabled< ObjectType >();
+             index_activity_timer timer( activity, &index_activity::removes );
+             if( get_mutable_index<index_type>().remove( obj ) && activity )
+                activity->undo_bytes += sizeof( ObjectType );
          }
 
          template<typename ObjectType, typename Constructor>
@@ -964,6 +1150,7 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("create", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
+             index_activity_timer timer( get_activity_if_enabled< ObjectType >(), &index_activity::creates );
              return get_mutable_index<index_type>().emplace( std::forward<Constructor>(con) );
          }
 
@@ -988,14 +1175,24 @@ namespace chainbase {
             int_incrementer ii( _read_lock_count );
 #endif
 
-            if( !wait_micro )
+            if( lock.try_lock() )
             {
-               lock.lock();
+               if( _enable_instrumentation ) _read_lock_waits.record( 0 );
             }
             else
             {
-               if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
-                  BOOST_THROW_EXCEPTION( lock_exception() );
+               read_write_mutex_manager::read_wait wait( _rw_manager );
+               lock_wait_timer timer( _enable_instrumentation ? &_read_lock_waits : nullptr );
+
+               if( !wait_micro )
+               {
+                  lock.lock();
+               }
+               else
+               {
+                  if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                     BOOST_THROW_EXCEPTION( lock_exception() );
+               }
             }
 
             return callback();
@@ -1010,6 +1207,8 @@ namespace chainbase {
             int_incrementer ii( _write_lock_count );
 #endif
 
+            lock_wait_timer timer( _enable_instrumentation ? &_write_lock_waits : nullptr );
+
             if( !wait_micro )
             {
                lock.lock();
@@ -1024,9 +1223,38 @@ namespace chainbase {
                }
             }
 
+            timer.stop();
             return callback();
          }
 
+         uint32_t waiting_readers()const
+         {
+            return _rw_manager.waiting_readers();
+         }
+
+         bool wait_for_waiting_readers( const std::chrono::steady_clock::time_point& deadline )
+         {
+            return _rw_manager.wait_for_waiting_readers( deadline );
+         }
+
+         void stop_waiting_for_readers()
+         {
+            _rw_manager.stop_waiting_for_readers();
+         }
+
+         /**
+          * Enables counting and timing of the writes to each index, counting of the bytes saved for undo and
+          * timing of lock acquisition.
+          */
+         void set_instrumentation( bool enable_instrumentation ) { _enable_instrumentation = enable_instrumentation; }
+         bool is_instrumentation_enabled()const { return _enable_instrumentation; }
+
+         /** Returns the activity of every index, must be called with a read or write lock held */
+         vector< index_activity_info > get_index_activity()const;
+
+         lock_wait_stats get_read_lock_wait_stats()const { return _read_lock_waits.get_stats(); }
+         lock_wait_stats get_write_lock_wait_stats()const { return _write_lock_waits.get_stats(); }
+
          template< typename IndexExtensionType, typename Lambda >
          void for_each_index_extension( Lambda&& callback )const
          {
@@ -1076,6 +1304,40 @@ namespace chainbase {
              _index_list.push_back( new_index );
          }
 
+         class lock_wait_timer
+         {
+            public:
+               lock_wait_timer( lock_wait_histogram* histogram ) : _histogram( histogram )
+               {
+                  if( _histogram )
+                     _start = std::chrono::steady_clock::now();
+               }
+
+               ~lock_wait_timer() { stop(); }
+
+               void stop()
+               {
+                  if( _histogram )
+                  {
+                     _histogram->record( std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - _start ).count() );
+                     _histogram = nullptr;
+                  }
+               }
+
+            private:
+               lock_wait_histogram*                    _histogram;
+               std::chrono::steady_clock::time_point   _start;
+         };
+
+         template< typename ObjectType >
+         index_activity* get_activity_if_enabled()
+         {
+            if( BOOST_LIKELY( !_enable_instrumentation ) )
+               return nullptr;
+
+            return &_index_map[ ObjectType::type_id ]->get_activity();
+         }
+
          read_write_mutex_manager                                    _rw_manager;
 #ifndef ENABLE_STD_ALLOCATOR
          unique_ptr<bip::managed_mapped_file>                        _segment;
@@ -1102,6 +1364,10 @@ namespace chainbase {
          bool                                                        _enable_require_locking = false;
 
          int32_t                                                     _undo_session_count = 0;
+         bool                                                        _undo_disabled = false;
+         bool                                                        _enable_instrumentation = false;
+         lock_wait_histogram                                         _read_lock_waits;
+         lock_wait_histogram                                         _write_lock_waits;
          size_t                                                      _file_size = 0;
    };
 
@@ -0,0 +1,439 @@
+#pragma once
+
+#include <chainbase/allocators.hpp>
+
+#include <boost/throw_exception.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace chainbase {
+
+   /**
+    * An append-only undo log.
+    *
+    * Instead of a set of ordered maps per undo session, all sessions of an index share three append-only
+    * arenas: the undo records, the saved object copies and the session frames, which mark where each
+    * session starts in the other two. An open addressing hash table maps object ids to their most recent
+    * undo record, so checking whether an object was already saved by the head session is a single probe.
+    *
+    * Each session holds at most one live record per object:
+    *
+    *   op_create : the object was created by the session and is erased on undo
+    *   op_modify : the object existed before the session, the record holds its value from before the session
+    *   op_remove : the object was removed by the session, the record holds its value from before the session
+    *
+    * Records are replayed backwards on undo. Squash folds the head session into the previous one with a single
+    * pass over the head session's records, then compacts them in place. Commit drops whole sessions off the
+    * front of the arenas.
+    */
+   template< typename value_type >
+   class flat_undo_log
+   {
+      public:
+         typedef typename value_type::id_type   id_type;
+
+         template< typename T >
+         flat_undo_log( allocator< T > a )
+         :_frames( allocator< frame >( a ) ),
+          _records( allocator< record >( a ) ),
+          _values( allocator< value_type >( a ) ),
+          _slots( allocator< slot >( a ) ){}
+
+         bool   enabled()const { return _frames.size(); }
+         size_t size()const { return _frames.size(); }
+
+         void start( int64_t revision, id_type next_id )
+         {
+            frame f;
+            f.revision = revision;
+            f.old_next_id = next_id;
+            f.first_record = end_record();
+            f.first_value = end_value();
+            _frames.push_back( f );
+         }
+
+         /**
+          * Restores the objects changed by the most recent session and returns the next id from
+          * before the session was started.
+          */
+         template< typename IndexType >
+         id_type undo( IndexType& indices )
+         {
+            const frame head = _frames.back();
+
+            for( uint64_t seq = end_record(); seq-- > head.first_record; )
+            {
+               record& r = get_record( seq );
+
+               switch( r.op )
+               {
+                  case op_create:
+                  {
+                     indices.erase( indices.find( r.id ) );
+                     break;
+                  }
+                  case op_modify:
+                  {
+                     auto ok = indices.modify( indices.find( r.id ), [&]( value_type& v ) {
+                        v = std::move( get_value( r.value ) );
+                     });
+                     if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+                     break;
+                  }
+                  case op_remove:
+                  {
+                     bool ok = indices.emplace( std::move( get_value( r.value ) ) ).second;
+                     if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not restore object, most likely a uniqueness constraint was violated" ) );
+                     break;
+                  }
+                  default:
+                     continue;
+               }
+
+               restore_saved( r.id, r.prev );
+            }
+
+            truncate( head.first_record, head.first_value );
+            _frames.pop_back();
+            return head.old_next_id;
+         }
+
+         /**
+          * Merges the two most recent sessions into one.
+          *
+          * A record of the head session whose object also has a live record in the previous session is
+          * folded into that record, following the same rules as undo_state_stack::squash:
+          *
+          *   new        + upd(was=Y) -> new
+          *   new        + del(was=Y) -> nop
+          *   upd(was=X) + upd(was=Y) -> upd(was=X)
+          *   upd(was=X) + del(was=Y) -> del(was=X)
+          *
+          * Every other record of the head session is kept as it is.
+          */
+         void squash()
+         {
+            const frame head = _frames.back();
+            const frame& prev = _frames[ _frames.size() - 2 ];
+
+            for( uint64_t seq = head.first_record; seq < end_record(); ++seq )
+            {
+               record& r = get_record( seq );
+               if( r.op == op_none || r.prev == npos || r.prev < prev.first_record || r.prev >= head.first_record )
+                  continue;
+
+               record& p = get_record( r.prev );
+               if( p.op == op_none )
+                  continue;
+
+               if( r.op == op_remove )
+               {
+                  if( p.op == op_create )
+                  {
+                     p.op = op_none;
+                     restore_saved( r.id, p.prev );
+                     r.op = op_none;
+                     continue;
+                  }
+
+                  p.op = op_remove;
+               }
+
+               set_saved( r.id, r.prev );
+               r.op = op_none;
+            }
+
+            // Compact the surviving records and values of the head session in place
+            uint64_t record_pos = head.first_record;
+            uint64_t value_pos = head.first_value;
+
+            for( uint64_t seq = head.first_record; seq < end_record(); ++seq )
+            {
+               record& r = get_record( seq );
+               if( r.op == op_none )
+                  continue;
+
+               if( r.value != npos )
+               {
+                  if( r.value != value_pos )
+                     get_value( value_pos ) = std::move( get_value( r.value ) );
+
+                  r.value = value_pos++;
+               }
+
+               if( seq != record_pos )
+               {
+                  get_record( record_pos ) = r;
+                  set_saved( r.id, record_pos );
+               }
+
+               ++record_pos;
+            }
+
+            truncate( record_pos, value_pos );
+            _frames.pop_back();
+         }
+
+         /**
+          * Discards all sessions up to and including revision
+          */
+         void commit( int64_t revision )
+         {
+            while( _frames.size() && _frames.front().revision <= revision )
+            {
+               uint64_t end = _frames.size() > 1 ? _frames[1].first_record : end_record();
+               uint64_t value_end = _frames.size() > 1 ? _frames[1].first_value : end_value();
+
+               for( ; _record_base < end; ++_record_base )
+               {
+                  const record& r = _records.front();
+                  if( r.op != op_none )
+                  {
+                     slot* s = find_slot( r.id );
+                     if( s && s->record == _record_base )
+                        erase_slot( s );
+                  }
+
+                  _records.pop_front();
+               }
+
+               for( ; _value_base < value_end; ++_value_base )
+                  _values.pop_front();
+
+               _frames.pop_front();
+            }
+         }
+
+         void on_create( const value_type& v )
+         {
+            append( v.id, op_create, nullptr );
+         }
+
+         /** Returns true when a copy of v was saved */
+         bool on_modify( const value_type& v )
+         {
+            if( head_record( v.id ) )
+               return false;
+
+            append( v.id, op_modify, &v );
+            return true;
+         }
+
+         /** Returns true when a copy of v was saved */
+         bool on_remove( const value_type& v )
+         {
+            record* r = head_record( v.id );
+
+            if( r == nullptr )
+            {
+               append( v.id, op_remove, &v );
+               return true;
+            }
+
+            if( r->op == op_create )
+            {
+               r->op = op_none;
+               restore_saved( v.id, r->prev );
+            }
+            else
+            {
+               // The record already holds the value from before the session
+               r->op = op_remove;
+            }
+
+            return false;
+         }
+
+      private:
+         static constexpr uint64_t npos = std::numeric_limits< uint64_t >::max();
+         static constexpr int64_t  empty_slot = -1;
+         static constexpr int64_t  erased_slot = -2;
+
+         enum op_type : uint8_t
+         {
+            op_none,
+            op_create,
+            op_modify,
+            op_remove
+         };
+
+         struct record
+         {
+            id_type     id;
+            uint64_t    prev = npos;   ///< The object's previous live record, from an older session
+            uint64_t    value = npos;  ///< Position of the saved copy in the value arena
+            op_type     op = op_none;
+         };
+
+         struct frame
+         {
+            int64_t     revision = 0;
+            id_type     old_next_id = 0;
+            uint64_t    first_record = 0;
+            uint64_t    first_value = 0;
+         };
+
+         struct slot
+         {
+            int64_t     id = empty_slot;
+            uint64_t    record = npos;
+         };
+
+         /* Records and values are addressed by sequence number, which stays stable while commit drops
+          * entries off the front of the arenas. */
+         uint64_t end_record()const { return _record_base + _records.size(); }
+         uint64_t end_value()const { return _value_base + _values.size(); }
+         record& get_record( uint64_t seq ) { return _records[ seq - _record_base ]; }
+         value_type& get_value( uint64_t seq ) { return _values[ seq - _value_base ]; }
+
+         void truncate( uint64_t record_end, uint64_t value_end )
+         {
+            while( end_record() > record_end )
+               _records.pop_back();
+
+            while( end_value() > value_end )
+               _values.pop_back();
+         }
+
+         /** Returns the live record of the head session for id, if there is one */
+         record* head_record( const id_type& id )
+         {
+            const slot* s = find_slot( id );
+            if( s == nullptr || s->record < _frames.back().first_record )
+               return nullptr;
+
+            return &get_record( s->record );
+         }
+
+         void append( const id_type& id, op_type op, const value_type* v )
+         {
+            record r;
+            r.id = id;
+            r.op = op;
+
+            const slot* s = find_slot( id );
+            if( s && s->record >= _record_base )
+               r.prev = s->record;
+
+            if( v )
+            {
+               r.value = end_value();
+               _values.emplace_back( *v );
+            }
+
+            set_saved( id, end_record() );
+            _records.push_back( r );
+         }
+
+         void restore_saved( const id_type& id, uint64_t prev )
+         {
+            if( prev != npos && prev >= _record_base )
+            {
+               set_saved( id, prev );
+            }
+            else
+            {
+               slot* s = find_slot( id );
+               if( s )
+                  erase_slot( s );
+            }
+         }
+
+         size_t slot_pos( int64_t id )const
+         {
+            return ( uint64_t( id ) * 0x9E3779B97F4A7C15ull ) >> _slot_shift;
+         }
+
+         slot* find_slot( const id_type& oid )
+         {
+            if( _slots.empty() )
+               return nullptr;
+
+            int64_t id = oid._id;
+            size_t mask = _slots.size() - 1;
+
+            for( size_t pos = slot_pos( id );; pos = ( pos + 1 ) & mask )
+            {
+               slot& s = _slots[ pos ];
+               if( s.id == id )
+                  return &s;
+               if( s.id == empty_slot )
+                  return nullptr;
+            }
+         }
+
+         void set_saved( const id_type& oid, uint64_t seq )
+         {
+            slot* s = find_slot( oid );
+            if( s )
+            {
+               s->record = seq;
+               return;
+            }
+
+            if( ( _used_slots + 1 ) * 2 > _slots.size() )
+               rehash();
+
+            insert_slot( oid._id, seq );
+         }
+
+         void insert_slot( int64_t id, uint64_t seq )
+         {
+            size_t mask = _slots.size() - 1;
+            size_t pos = slot_pos( id );
+
+            while( _slots[ pos ].id >= 0 )
+               pos = ( pos + 1 ) & mask;
+
+            if( _slots[ pos ].id == empty_slot )
+               ++_used_slots;
+
+            _slots[ pos ].id = id;
+            _slots[ pos ].record = seq;
+            ++_live_slots;
+         }
+
+         void erase_slot( slot* s )
+         {
+            s->id = erased_slot;
+            s->record = npos;
+            --_live_slots;
+         }
+
+         /** Grows the table to keep it at most a quarter full after the rehash, dropping erased slots */
+         void rehash()
+         {
+            size_t new_size = 64;
+            uint32_t new_shift = 58;
+            while( new_size < ( _live_slots + 1 ) * 4 )
+            {
+               new_size *= 2;
+               --new_shift;
+            }
+
+            t_vector< slot > old_slots( new_size, slot(), _slots.get_allocator() );
+            old_slots.swap( _slots );
+            _slot_shift = new_shift;
+            _used_slots = 0;
+            _live_slots = 0;
+
+            for( const auto& s : old_slots )
+               if( s.id >= 0 )
+                  insert_slot( s.id, s.record );
+         }
+
+         t_deque< frame >        _frames;
+         t_deque< record >       _records;
+         t_deque< value_type >   _values;
+         t_vector< slot >        _slots;
+
+         uint64_t                _record_base = 0;
+         uint64_t                _value_base = 0;
+         uint64_t                _used_slots = 0;   ///< Slots that are not empty, including erased ones
+         uint64_t                _live_slots = 0;
+         uint32_t                _slot_shift = 64;
+   };
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chainbase {
+
+   /**
+    * Writes made to one index while instrumentation is enabled.
+    *
+    * time_ns is the time spent in create, modify and remove, including the constructor and modifier
+    * callbacks and the undo bookkeeping. The counters are only updated by the thread holding the write lock.
+    */
+   struct index_activity
+   {
+      uint64_t creates = 0;
+      uint64_t modifies = 0;
+      uint64_t removes = 0;
+      uint64_t time_ns = 0;
+      uint64_t undo_bytes = 0;
+   };
+
+   /**
+    * A snapshot of the activity of one index, see database::get_index_activity()
+    */
+   struct index_activity_info
+   {
+      std::string    value_type_name;
+      uint64_t       creates = 0;
+      uint64_t       modifies = 0;
+      uint64_t       removes = 0;
+      uint64_t       time_ns = 0;
+      uint64_t       undo_bytes = 0;   ///< Bytes of object copies saved for undo
+   };
+
+   /**
+    * Times a single write and adds it to an index's activity. Does nothing when activity is null.
+    */
+   class index_activity_timer
+   {
+      public:
+         index_activity_timer( index_activity* activity, uint64_t index_activity::* counter )
+         :_activity( activity ), _counter( counter )
+         {
+            if( _activity )
+               _start = std::chrono::steady_clock::now();
+         }
+
+         ~index_activity_timer()
+         {
+            if( _activity )
+            {
+               ++( _activity->*_counter );
+               _activity->time_ns += std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - _start ).count();
+            }
+         }
+
+      private:
+         index_activity*                           _activity;
+         uint64_t index_activity::*                _counter;
+         std::chrono::steady_clock::time_point     _start;
+   };
+
+   /**
+    * A snapshot of a lock_wait_histogram.
+    *
+    * buckets[0] counts locks acquired without waiting a full microsecond, buckets[i] counts waits of
+    * [2^(i-1), 2^i) microseconds and the last bucket counts every longer wait.
+    */
+   struct lock_wait_stats
+   {
+      uint64_t                count = 0;
+      uint64_t                total_us = 0;
+      uint64_t                max_us = 0;
+      std::vector< uint64_t > buckets;
+   };
+
+   /**
+    * A log2 histogram of lock acquisition times, safe to update from any thread
+    */
+   class lock_wait_histogram
+   {
+      public:
+         static const size_t num_buckets = 24;
+
+         lock_wait_histogram()
+         {
+            for( auto& b : _buckets )
+               b = 0;
+         }
+
+         void record( uint64_t wait_us )
+         {
+            size_t bucket = wait_us ? 64 - __builtin_clzll( wait_us ) : 0;
+            if( bucket >= num_buckets )
+               bucket = num_buckets - 1;
+
+            _buckets[ bucket ].fetch_add( 1, std::memory_order_relaxed );
+            _count.fetch_add( 1, std::memory_order_relaxed );
+            _total_us.fetch_add( wait_us, std::memory_order_relaxed );
+
+            uint64_t max_us = _max_us.load( std::memory_order_relaxed );
+            while( wait_us > max_us && !_max_us.compare_exchange_weak( max_us, wait_us, std::memory_order_relaxed ) );
+         }
+
+         lock_wait_stats get_stats()const
+         {
+            lock_wait_stats stats;
+            stats.count = _count.load( std::memory_order_relaxed );
+            stats.total_us = _total_us.load( std::memory_order_relaxed );
+            stats.max_us = _max_us.load( std::memory_order_relaxed );
+            stats.buckets.reserve( num_buckets );
+
+            for( const auto& b : _buckets )
+               stats.buckets.push_back( b.load( std::memory_order_relaxed ) );
+
+            return stats;
+         }
+
+      private:
+         std::array< std::atomic< uint64_t >, num_buckets >   _buckets;
+         std::atomic< uint64_t >                               _count{ 0 };
+         std::atomic< uint64_t >                               _total_us{ 0 };
+         std::atomic< uint64_t >                               _max_us{ 0 };
+   };
+
+}
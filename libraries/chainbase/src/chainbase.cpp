@@ -141,6 +141,8 @@ namespace chainbase {
 
    void database::undo()
    {
+      if( _undo_disabled ) BOOST_THROW_EXCEPTION( std::logic_error( "cannot undo while undo is disabled" ) );
+
       for( auto& item : _index_list )
       {
          item->undo();
@@ -165,14 +167,55 @@ namespace chainbase {
 
    void database::undo_all()
    {
+      if( _undo_disabled ) BOOST_THROW_EXCEPTION( std::logic_error( "cannot undo while undo is disabled" ) );
+
       for( auto& item : _index_list )
       {
          item->undo_all();
       }
    }
 
+   void database::disable_undo()
+   {
+      if( _undo_session_count ) BOOST_THROW_EXCEPTION( std::logic_error( "cannot disable undo while there are open undo sessions" ) );
+
+      commit( revision() );
+      _undo_disabled = true;
+   }
+
+   void database::enable_undo( int64_t revision )
+   {
+      _undo_disabled = false;
+      set_revision( revision );
+   }
+
+   vector< index_activity_info > database::get_index_activity()const
+   {
+      vector< index_activity_info > result;
+      result.reserve( _index_list.size() );
+
+      for( const abstract_index* idx : _index_list )
+      {
+         const index_activity& activity = idx->get_activity();
+
+         index_activity_info info;
+         info.value_type_name = idx->get_statistics( true )._value_type_name;
+         info.creates = activity.creates;
+         info.modifies = activity.modifies;
+         info.removes = activity.removes;
+         info.time_ns = activity.time_ns;
+         info.undo_bytes = activity.undo_bytes;
+         result.push_back( std::move( info ) );
+      }
+
+      return result;
+   }
+
    database::session database::start_undo_session()
    {
+      if( _undo_disabled )
+         return session( vector< std::unique_ptr<abstract_session> >(), _undo_session_count );
+
       vector< std::unique_ptr<abstract_session> > _sub_sessions;
       _sub_sessions.reserve( _index_list.size() );
       for( auto& item : _index_list ) {
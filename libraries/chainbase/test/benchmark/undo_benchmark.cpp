@@ -0,0 +1,138 @@
+#include <chainbase/chainbase.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/**
+ * Compares the undo logs on a modify heavy workload shaped like block application: every block opens a
+ * session, every transaction opens a nested session that modifies a handful of objects and is squashed
+ * into the block, and blocks older than the undo window are committed.
+ *
+ * Usage: chainbase_undo_benchmark [objects] [blocks] [transactions per block] [modifies per transaction]
+ */
+
+using namespace chainbase;
+using namespace boost::multi_index;
+
+struct account : public chainbase::object< 0, account >
+{
+   CHAINBASE_DEFAULT_CONSTRUCTOR( account )
+
+   id_type  id;
+   int64_t  balance = 0;
+   int64_t  savings = 0;
+   int64_t  votes[8] = {};
+   uint32_t last_update = 0;
+};
+
+struct by_balance;
+
+typedef multi_index_container<
+   account,
+   indexed_by<
+      ordered_unique< member< account, account::id_type, &account::id > >,
+      ordered_non_unique< tag< by_balance >, member< account, int64_t, &account::balance > >
+   >,
+   chainbase::allocator< account >
+> account_index;
+
+struct workload
+{
+   uint32_t objects = 100000;
+   uint32_t blocks = 2000;
+   uint32_t transactions = 100;
+   uint32_t modifies = 8;
+   uint32_t undo_window = 21;
+};
+
+template< typename IndexType >
+double run( bip::managed_mapped_file& segment, const char* name, const workload& w )
+{
+   auto& idx = *segment.construct< IndexType >( name )( allocator< account >( segment.get_segment_manager() ) );
+
+   for( uint32_t i = 0; i < w.objects; ++i )
+      idx.emplace( [&]( account& a ) { a.balance = i; } );
+
+   std::vector< const account* > accounts;
+   for( const auto& a : idx.indices() )
+      accounts.push_back( &a );
+
+   // Skewed towards a small set of hot accounts, like exchanges and popular authors
+   std::mt19937 rng( 7 );
+   std::geometric_distribution< uint32_t > pick( 0.001 );
+
+   auto start = std::chrono::steady_clock::now();
+
+   for( uint32_t block = 1; block <= w.blocks; ++block )
+   {
+      idx.start_undo_session().push();
+
+      for( uint32_t trx = 0; trx < w.transactions; ++trx )
+      {
+         auto session = idx.start_undo_session();
+
+         for( uint32_t op = 0; op < w.modifies; ++op )
+         {
+            const account& a = *accounts[ pick( rng ) % accounts.size() ];
+            idx.modify( a, [&]( account& v )
+            {
+               v.balance += 1;
+               v.votes[ op % 8 ] += 1;
+               v.last_update = block;
+            });
+         }
+
+         session.squash();
+      }
+
+      if( idx.revision() > w.undo_window )
+         idx.commit( idx.revision() - w.undo_window );
+   }
+
+   idx.undo_all();
+
+   std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+   segment.destroy_ptr( &idx );
+   return elapsed.count();
+}
+
+int main( int argc, char** argv )
+{
+   workload w;
+   if( argc > 1 ) w.objects = std::stoul( argv[1] );
+   if( argc > 2 ) w.blocks = std::stoul( argv[2] );
+   if( argc > 3 ) w.transactions = std::stoul( argv[3] );
+   if( argc > 4 ) w.modifies = std::stoul( argv[4] );
+
+   bfs::path temp = bfs::temp_directory_path() / bfs::unique_path();
+
+   try
+   {
+      bip::managed_mapped_file segment( bip::create_only, temp.generic_string().c_str(), 1024ull * 1024 * 1024 );
+
+      uint64_t total = uint64_t( w.blocks ) * w.transactions * w.modifies;
+      std::cout << w.objects << " objects, " << w.blocks << " blocks, " << w.transactions << " transactions per block, "
+                << w.modifies << " modifies per transaction\n";
+
+      double tree = run< generic_index< account_index, undo_state_stack< account > > >( segment, "undo_state_stack", w );
+      std::cout << "undo_state_stack: " << tree << " s, " << uint64_t( total / tree ) << " modifies/s\n";
+
+      double flat = run< generic_index< account_index, flat_undo_log< account > > >( segment, "flat_undo_log", w );
+      std::cout << "flat_undo_log:    " << flat << " s, " << uint64_t( total / flat ) << " modifies/s\n";
+
+      std::cout << "speedup:          " << tree / flat << "x\n";
+   }
+   catch( ... )
+   {
+      bfs::remove_all( temp );
+      throw;
+   }
+
+   bfs::remove_all( temp );
+   return 0;
+}
@@ -7,7 +7,10 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
 
+#include <atomic>
 #include <iostream>
+#include <random>
+#include <thread>
 
 using namespace chainbase;
 using namespace boost::multi_index;
@@ -136,4 +139,320 @@ BOOST_AUTO_TEST_CASE( open_and_create ) {
    }
 }
 
+template< typename IndexA, typename IndexB >
+void require_same_books( const IndexA& a, const IndexB& b )
+{
+   BOOST_REQUIRE_EQUAL( a.revision(), b.revision() );
+   BOOST_REQUIRE_EQUAL( a.indices().size(), b.indices().size() );
+
+   auto itr = b.indices().begin();
+   for( const auto& book_a : a.indices() )
+   {
+      BOOST_REQUIRE( book_a.id == itr->id );
+      BOOST_REQUIRE_EQUAL( book_a.a, itr->a );
+      BOOST_REQUIRE_EQUAL( book_a.b, itr->b );
+      ++itr;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( flat_undo_log_matches_undo_state_stack ) {
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+   try {
+      typedef generic_index< book_index, undo_state_stack< book > > tree_index;
+      typedef generic_index< book_index, flat_undo_log< book > > flat_index;
+
+      bip::managed_mapped_file segment( bip::create_only, temp.generic_string().c_str(), 1024*1024*64 );
+      allocator< book > alloc( segment.get_segment_manager() );
+
+      auto& tree = *segment.construct< tree_index >( "tree" )( alloc );
+      auto& flat = *segment.construct< flat_index >( "flat" )( alloc );
+
+      // Replay the same random sequence of changes and sessions against both undo logs
+      std::mt19937 rng( 42 );
+      int64_t committed_revision = 0;
+      uint32_t open_sessions = 0;
+
+      for( uint32_t step = 0; step < 20000; ++step )
+      {
+         uint32_t action = rng() % 100;
+
+         if( action < 25 || tree.indices().size() == 0 )
+         {
+            int a = rng() % 1000;
+            tree.emplace( [&]( book& b ) { b.a = a; } );
+            flat.emplace( [&]( book& b ) { b.a = a; } );
+         }
+         else if( action < 80 )
+         {
+            auto itr = tree.indices().begin();
+            std::advance( itr, rng() % tree.indices().size() );
+            const auto& book_b = flat.get( itr->id );
+            int a = rng() % 1000;
+            int b = rng() % 1000;
+
+            if( action < 70 )
+            {
+               tree.modify( *itr, [&]( book& v ) { v.a = a; v.b = b; } );
+               flat.modify( book_b, [&]( book& v ) { v.a = a; v.b = b; } );
+            }
+            else
+            {
+               flat.remove( book_b );
+               tree.remove( *itr );
+            }
+         }
+         else if( action < 88 )
+         {
+            tree.start_undo_session().push();
+            flat.start_undo_session().push();
+            ++open_sessions;
+         }
+         else if( action < 92 && open_sessions )
+         {
+            tree.undo();
+            flat.undo();
+            --open_sessions;
+         }
+         else if( action < 97 && open_sessions )
+         {
+            tree.squash();
+            flat.squash();
+
+            // Squashing the only session commits it
+            if( --open_sessions == 0 )
+               committed_revision = tree.revision();
+         }
+         else if( open_sessions > 1 )
+         {
+            // Commit the oldest half of the sessions
+            int64_t revision = committed_revision + ( tree.revision() - committed_revision ) / 2;
+            tree.commit( revision );
+            flat.commit( revision );
+            open_sessions = tree.revision() - revision;
+            committed_revision = revision;
+         }
+
+         if( step % 50 == 0 )
+            require_same_books( tree, flat );
+      }
+
+      require_same_books( tree, flat );
+      tree.undo_all();
+      flat.undo_all();
+      require_same_books( tree, flat );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( disable_undo ) {
+   boost::filesystem::path temp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      const auto& first_book = db.create<book>( []( book& b ) {
+          b.a = 1;
+          b.b = 2;
+      } );
+
+      {
+          auto session = db.start_undo_session();
+          db.modify( first_book, [&]( book& b ) { b.a = 3; } );
+          session.push();
+      }
+      BOOST_REQUIRE_EQUAL( db.revision(), 1 );
+
+      BOOST_TEST_MESSAGE( "Disabling undo commits the existing undo history" );
+      {
+          auto session = db.start_undo_session();
+          BOOST_CHECK_THROW( db.disable_undo(), std::logic_error ); /// cannot disable undo with an open session
+      }
+      db.disable_undo();
+      BOOST_REQUIRE( db.is_undo_disabled() );
+
+      {
+          auto session = db.start_undo_session();
+          BOOST_REQUIRE_EQUAL( session.revision(), -1 );
+          db.modify( first_book, [&]( book& b ) { b.a = 4; } );
+          db.create<book>( []( book& b ) {
+              b.a = 5;
+              b.b = 6;
+          } );
+      }
+      BOOST_REQUIRE_EQUAL( first_book.a, 4 );
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), 2u );
+      BOOST_REQUIRE_EQUAL( db.revision(), 1 );
+
+      BOOST_CHECK_THROW( db.undo(), std::logic_error );
+      BOOST_CHECK_THROW( db.undo_all(), std::logic_error );
+      BOOST_REQUIRE_EQUAL( first_book.a, 4 );
+
+      db.enable_undo( 10 );
+      BOOST_REQUIRE( !db.is_undo_disabled() );
+      BOOST_REQUIRE_EQUAL( db.revision(), 10 );
+
+      {
+          auto session = db.start_undo_session();
+          BOOST_REQUIRE_EQUAL( db.revision(), 11 );
+          db.modify( first_book, [&]( book& b ) { b.a = 7; } );
+      }
+      BOOST_REQUIRE_EQUAL( first_book.a, 4 );
+      BOOST_REQUIRE_EQUAL( db.revision(), 10 );
+
+      /// the history from before undo was disabled is gone
+      db.undo_all();
+      BOOST_REQUIRE_EQUAL( first_book.a, 4 );
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), 2u );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( waiting_readers ) {
+   boost::filesystem::path temp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      BOOST_REQUIRE_EQUAL( db.waiting_readers(), 0u );
+      db.with_read_lock( [&]() { BOOST_REQUIRE_EQUAL( db.waiting_readers(), 0u ); } );
+
+      std::atomic< bool > read( false );
+      std::thread reader;
+
+      db.with_write_lock( [&]()
+      {
+         reader = std::thread( [&]()
+         {
+            db.with_read_lock( [&]() { read = true; }, 0 );
+         });
+
+         while( db.waiting_readers() == 0 )
+            std::this_thread::yield();
+
+         BOOST_REQUIRE( !read );
+      });
+
+      // the writer that released the lock is woken once the reader has it
+      BOOST_REQUIRE( db.wait_for_waiting_readers( std::chrono::steady_clock::now() + std::chrono::seconds( 10 ) ) );
+      reader.join();
+      BOOST_REQUIRE( read );
+      BOOST_REQUIRE_EQUAL( db.waiting_readers(), 0u );
+
+      // or when it is told to stop waiting, with the reader still waiting
+      read = false;
+      db.with_write_lock( [&]()
+      {
+         reader = std::thread( [&]()
+         {
+            db.with_read_lock( [&]() { read = true; }, 0 );
+         });
+
+         while( db.waiting_readers() == 0 )
+            std::this_thread::yield();
+
+         std::thread waker( [&]() { db.stop_waiting_for_readers(); } );
+         BOOST_REQUIRE( !db.wait_for_waiting_readers( std::chrono::steady_clock::now() + std::chrono::seconds( 10 ) ) );
+         waker.join();
+         BOOST_REQUIRE( !read );
+      });
+
+      reader.join();
+      BOOST_REQUIRE( read );
+
+      // and at the deadline
+      auto start = std::chrono::steady_clock::now();
+      db.with_write_lock( [&]()
+      {
+         reader = std::thread( [&]()
+         {
+            db.with_read_lock( [&]() {}, 0 );
+         });
+
+         while( db.waiting_readers() == 0 )
+            std::this_thread::yield();
+
+         BOOST_REQUIRE( !db.wait_for_waiting_readers( start + std::chrono::milliseconds( 20 ) ) );
+         BOOST_REQUIRE( std::chrono::steady_clock::now() >= start + std::chrono::milliseconds( 20 ) );
+      });
+
+      reader.join();
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( instrumentation ) {
+   boost::filesystem::path temp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      const auto& first_book = db.create<book>( []( book& b ) { b.a = 1; } );
+      BOOST_REQUIRE_EQUAL( db.get_index_activity()[0].creates, 0u ); /// not counted until enabled
+
+      db.set_instrumentation( true );
+
+      db.with_write_lock( [&]()
+      {
+         auto session = db.start_undo_session();
+         db.modify( first_book, [&]( book& b ) { b.a = 2; } );
+         db.modify( first_book, [&]( book& b ) { b.a = 3; } );
+         const auto& second_book = db.create<book>( []( book& b ) { b.a = 4; } );
+         db.remove( second_book );
+         session.push();
+      });
+
+      db.with_read_lock( [&]()
+      {
+         auto activity = db.get_index_activity();
+         BOOST_REQUIRE_EQUAL( activity.size(), 1u );
+         BOOST_REQUIRE_EQUAL( activity[0].value_type_name, "book" );
+         BOOST_REQUIRE_EQUAL( activity[0].creates, 1u );
+         BOOST_REQUIRE_EQUAL( activity[0].modifies, 2u );
+         BOOST_REQUIRE_EQUAL( activity[0].removes, 1u );
+         BOOST_REQUIRE_EQUAL( activity[0].undo_bytes, sizeof( book ) ); /// only the first modify saves a copy
+      });
+
+      auto reads = db.get_read_lock_wait_stats();
+      auto writes = db.get_write_lock_wait_stats();
+      BOOST_REQUIRE_EQUAL( reads.count, 1u );
+      BOOST_REQUIRE_EQUAL( writes.count, 1u );
+      BOOST_REQUIRE_EQUAL( reads.buckets.size(), size_t( lock_wait_histogram::num_buckets ) );
+
+      lock_wait_histogram histogram;
+      histogram.record( 0 );
+      histogram.record( 1 );
+      histogram.record( 3 );
+      histogram.record( 4 );
+      histogram.record( uint64_t(1) << 40 );
+      auto stats = histogram.get_stats();
+      BOOST_REQUIRE_EQUAL( stats.count, 5u );
+      BOOST_REQUIRE_EQUAL( stats.max_us, uint64_t(1) << 40 );
+      BOOST_REQUIRE_EQUAL( stats.buckets[0], 1u );
+      BOOST_REQUIRE_EQUAL( stats.buckets[1], 1u );
+      BOOST_REQUIRE_EQUAL( stats.buckets[2], 1u );
+      BOOST_REQUIRE_EQUAL( stats.buckets[3], 1u );
+      BOOST_REQUIRE_EQUAL( stats.buckets.back(), 1u );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+
+   bfs::remove_all( temp );
+}
+
 // BOOST_AUTO_TEST_SUITE_END()
@@ -6,5 +6,20 @@ namespace fc
 {
 
   string zlib_compress(const string& in);
+  string zlib_decompress(const string& in);
+
+  /**
+   *  Inflates at most max_size bytes, returns an empty string when in is not a valid stream or
+   *  inflates to more than max_size bytes. Use it on data from untrusted sources.
+   */
+  string zlib_decompress(const string& in, size_t max_size);
+
+  /**
+   *  gzip (RFC 1952) framing of the same deflate stream, as used by the gzip http content encoding.
+   *  gzip_decompress returns an empty string when the header, the crc or the length do not match,
+   *  or when the stream inflates to more than max_size bytes.
+   */
+  string gzip_compress(const string& in);
+  string gzip_decompress(const string& in, size_t max_size);
 
 } // namespace fc
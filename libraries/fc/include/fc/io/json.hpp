@@ -20,7 +20,9 @@ namespace fc
             legacy_parser         = 0,
             strict_parser         = 1,
             relaxed_parser        = 2,
-            legacy_parser_with_string_doubles = 3
+            legacy_parser_with_string_doubles = 3,
+            /** Same results as legacy_parser, but parses plain json without going through a stream, see json_fast.hpp */
+            fast_parser           = 4
          };
          enum output_formatting
          {
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <fc/variant.hpp>
+
+namespace fc { namespace json_fast
+{
+   /**
+    *  Instruction sets the fast parser can scan its input with, the best one supported by the
+    *  cpu is picked the first time it is needed.
+    */
+   enum simd_level
+   {
+      scalar   = 0,
+      sse2     = 1,
+      avx2     = 2
+   };
+
+   simd_level get_simd_level();
+
+   /** Returns the highest level supported by this cpu and build */
+   simd_level max_simd_level();
+
+   /** Selects the instruction set used by later parses, capped at max_simd_level() */
+   void set_simd_level( simd_level level );
+
+   /**
+    *  Parses the first json value in [begin, end) the same way as json::legacy_parser.
+    *
+    *  Returns false without touching result when the input is not plain json, i.e. whenever the
+    *  legacy parser would throw or fall back to one of its lenient rules such as unquoted strings,
+    *  numbers with exponents or partial tokens. Callers run the legacy parser in that case, which
+    *  keeps both the result and the errors the same as before.
+    *
+    *  When stop is not null it is set to the position after the parsed value.
+    */
+   bool try_parse( const char* begin, const char* end, variant& result, bool string_doubles = false,
+                   const char** stop = nullptr );
+
+   /**
+    *  Throws the same assert_exception as the legacy parser when brackets are nested 100 deep or more,
+    *  counting brackets inside strings too.
+    */
+   void check_depth( const char* begin, const char* end );
+
+} } // fc::json_fast
@@ -0,0 +1,309 @@
+#pragma once
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/container/flat.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/reflect/variant.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fc
+{
+   /**
+    *  Writes values as json straight into a string, without building a variant first.
+    *
+    *  The output is the same as json::to_string( variant( v ) ). Reflected structs and enums, strings, integers,
+    *  optionals and the standard containers are written directly. Values of any type with its own to_variant
+    *  overload, such as assets, keys or static_variants, are converted to a variant and written from that,
+    *  so every custom json format is kept.
+    */
+   class json_stream
+   {
+      public:
+         json_stream( std::string& out, json::output_formatting format = json::stringify_large_ints_and_doubles )
+            : _out( out ), _format( format ) {}
+
+         template< typename T >
+         json_stream& write( const T& v );
+
+         template< typename T >
+         static std::string to_string( const T& v, json::output_formatting format = json::stringify_large_ints_and_doubles )
+         {
+            std::string out;
+            json_stream( out, format ).write( v );
+            return out;
+         }
+
+         void write_raw( char c )                         { _out.push_back( c ); }
+         void write_raw( const char* s, size_t len )      { _out.append( s, len ); }
+         void write_raw( const std::string& s )           { _out.append( s ); }
+
+         void write_null()                                { write_raw( "null", 4 ); }
+         void write_bool( bool b )                        { b ? write_raw( "true", 4 ) : write_raw( "false", 5 ); }
+         void write_int( int64_t i );
+         void write_uint( uint64_t i );
+         void write_string( const std::string& s );
+         void write_variant( const variant& v );
+         void write_object( const variant_object& o );
+
+         json::output_formatting format()const            { return _format; }
+
+      private:
+         std::string&               _out;
+         json::output_formatting    _format;
+   };
+
+   namespace json_stream_detail
+   {
+      struct to_variant_probe : public variant {};
+
+      /**
+       *  Has the same signature as fc's catch-all to_variant template, so a call with a to_variant_probe is
+       *  ambiguous unless overload resolution finds a more specific to_variant for T. The probe derives from
+       *  variant, which puts both this namespace and fc in the lookup, just like the call made by variant( v ).
+       */
+      template< typename T >
+      void to_variant( const T& o, variant& v );
+
+      template< typename T, typename = void >
+      struct has_custom_to_variant : std::false_type {};
+
+      template< typename T >
+      struct has_custom_to_variant< T, decltype( to_variant( std::declval< const T& >(), std::declval< to_variant_probe& >() ) ) >
+         : std::true_type {};
+
+      template< typename T >
+      class object_visitor
+      {
+         public:
+            object_visitor( json_stream& s, const T& v ) : _s( s ), _val( v ) {}
+
+            template< typename Member, class Class, Member (Class::*member) >
+            void operator()( const char* name )const
+            {
+               add( name, _val.*member );
+            }
+
+         private:
+            template< typename M >
+            void add( const char* name, const optional< M >& v )const
+            {
+               if( v.valid() )
+                  add( name, *v );
+            }
+
+            template< typename M >
+            void add( const char* name, const M& v )const
+            {
+               if( _first )
+                  _first = false;
+               else
+                  _s.write_raw( ',' );
+
+               _s.write_string( name );
+               _s.write_raw( ':' );
+               _s.write( v );
+            }
+
+            json_stream&   _s;
+            const T&       _val;
+            mutable bool   _first = true;
+      };
+
+      template< typename Container >
+      void write_array( json_stream& s, const Container& c )
+      {
+         s.write_raw( '[' );
+
+         bool first = true;
+         for( const auto& item : c )
+         {
+            if( first )
+               first = false;
+            else
+               s.write_raw( ',' );
+
+            s.write( item );
+         }
+
+         s.write_raw( ']' );
+      }
+
+      template< typename T, typename Enable = void >
+      struct writer
+      {
+         static void write( json_stream& s, const T& v )
+         {
+            write( s, v, has_custom_to_variant< T >(), typename reflector< T >::is_enum() );
+         }
+
+         template< typename IsEnum >
+         static void write( json_stream& s, const T& v, std::true_type, IsEnum )
+         {
+            s.write_variant( variant( v ) );
+         }
+
+         static void write( json_stream& s, const T& v, std::false_type, fc::true_type )
+         {
+            s.write_string( reflector< T >::to_fc_string( v ) );
+         }
+
+         static void write( json_stream& s, const T& v, std::false_type, fc::false_type )
+         {
+            s.write_raw( '{' );
+            reflector< T >::visit( object_visitor< T >( s, v ) );
+            s.write_raw( '}' );
+         }
+      };
+
+      template<>
+      struct writer< std::string >
+      {
+         static void write( json_stream& s, const std::string& v ) { s.write_string( v ); }
+      };
+
+      template<>
+      struct writer< bool >
+      {
+         static void write( json_stream& s, bool v ) { s.write_bool( v ); }
+      };
+
+      template< typename T >
+      struct writer< T, typename std::enable_if< std::is_integral< T >::value && !std::is_same< T, bool >::value && !std::is_same< T, char >::value >::type >
+      {
+         static void write( json_stream& s, T v )
+         {
+            if( std::is_signed< T >::value )
+               s.write_int( int64_t( v ) );
+            else
+               s.write_uint( uint64_t( v ) );
+         }
+      };
+
+      template< typename T >
+      struct writer< T, typename std::enable_if< std::is_floating_point< T >::value >::type >
+      {
+         static void write( json_stream& s, T v ) { s.write_variant( variant( double( v ) ) ); }
+      };
+
+      template<>
+      struct writer< variant >
+      {
+         static void write( json_stream& s, const variant& v ) { s.write_variant( v ); }
+      };
+
+      template<>
+      struct writer< variant_object >
+      {
+         static void write( json_stream& s, const variant_object& v ) { s.write_object( v ); }
+      };
+
+      template<>
+      struct writer< mutable_variant_object >
+      {
+         static void write( json_stream& s, const mutable_variant_object& v ) { s.write_object( variant_object( v ) ); }
+      };
+
+      template< typename T >
+      struct writer< optional< T > >
+      {
+         static void write( json_stream& s, const optional< T >& v )
+         {
+            if( v.valid() )
+               s.write( *v );
+            else
+               s.write_null();
+         }
+      };
+
+      // std::vector< char > is written as hex by its own to_variant and goes through the default writer
+      template< typename T, typename A >
+      struct writer< std::vector< T, A >, typename std::enable_if< !std::is_same< T, char >::value >::type >
+      {
+         static void write( json_stream& s, const std::vector< T, A >& v ) { write_array( s, v ); }
+      };
+
+      template< typename T, typename A >
+      struct writer< std::deque< T, A > >
+      {
+         static void write( json_stream& s, const std::deque< T, A >& v ) { write_array( s, v ); }
+      };
+
+      template< typename T, typename... A >
+      struct writer< std::set< T, A... > >
+      {
+         static void write( json_stream& s, const std::set< T, A... >& v ) { write_array( s, v ); }
+      };
+
+      template< typename T, typename... A >
+      struct writer< flat_set< T, A... > >
+      {
+         static void write( json_stream& s, const flat_set< T, A... >& v ) { write_array( s, v ); }
+      };
+
+      template< typename K, typename V, typename... A >
+      struct writer< flat_map< K, V, A... > >
+      {
+         static void write( json_stream& s, const flat_map< K, V, A... >& v ) { write_array( s, v ); }
+      };
+
+      template< typename K, typename V, typename... A >
+      struct writer< std::map< K, V, A... > >
+      {
+         static void write( json_stream& s, const std::map< K, V, A... >& v ) { write_array( s, v ); }
+      };
+
+      // Maps with string keys are written as objects
+      template< typename V, typename... A >
+      struct writer< std::map< std::string, V, A... > >
+      {
+         static void write( json_stream& s, const std::map< std::string, V, A... >& v )
+         {
+            s.write_raw( '{' );
+
+            bool first = true;
+            for( const auto& item : v )
+            {
+               if( first )
+                  first = false;
+               else
+                  s.write_raw( ',' );
+
+               s.write_string( item.first );
+               s.write_raw( ':' );
+               s.write( item.second );
+            }
+
+            s.write_raw( '}' );
+         }
+      };
+
+      template< typename A, typename B >
+      struct writer< std::pair< A, B > >
+      {
+         static void write( json_stream& s, const std::pair< A, B >& v )
+         {
+            s.write_raw( '[' );
+            s.write( v.first );
+            s.write_raw( ',' );
+            s.write( v.second );
+            s.write_raw( ']' );
+         }
+      };
+   }
+
+   template< typename T >
+   json_stream& json_stream::write( const T& v )
+   {
+      json_stream_detail::writer< T >::write( *this, v );
+      return *this;
+   }
+
+} // fc
@@ -492,6 +492,38 @@ namespace fc {
       }
     }
 
+    template<typename Stream, typename T, typename A>
+    inline void pack( Stream& s, const boost::container::deque<T,A>& value ) {
+      fc::raw::pack( s, unsigned_int((uint32_t)value.size()) );
+      for( const auto& item : value )
+        fc::raw::pack( s, item );
+    }
+
+    template<typename Stream, typename T, typename A>
+    inline void unpack( Stream& s, boost::container::deque<T,A>& value ) {
+      unsigned_int size; fc::raw::unpack( s, size );
+      FC_ASSERT( size.value*sizeof(T) < MAX_ARRAY_ALLOC_SIZE );
+      value.clear();
+      value.resize(size.value);
+      for( auto& item : value )
+        fc::raw::unpack( s, item );
+    }
+
+    // boost::interprocess::basic_string, serialized the same way as fc::string
+    template<typename Stream, typename Tr, typename A>
+    inline void pack( Stream& s, const boost::container::basic_string<char,Tr,A>& value ) {
+      fc::raw::pack( s, unsigned_int((uint32_t)value.size()) );
+      if( value.size() ) s.write( value.data(), value.size() );
+    }
+
+    template<typename Stream, typename Tr, typename A>
+    inline void unpack( Stream& s, boost::container::basic_string<char,Tr,A>& value ) {
+      unsigned_int size; fc::raw::unpack( s, size );
+      FC_ASSERT( size.value < MAX_ARRAY_ALLOC_SIZE );
+      value.resize(size.value);
+      if( size.value ) s.read( &value[0], size.value );
+    }
+
     template<typename Stream, typename T>
     inline void pack( Stream& s, const std::vector<T>& value ) {
       fc::raw::pack( s, unsigned_int((uint32_t)value.size()) );
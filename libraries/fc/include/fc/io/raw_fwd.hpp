@@ -4,6 +4,7 @@
 #include <fc/io/varint.hpp>
 #include <fc/array.hpp>
 #include <fc/safe.hpp>
+#include <boost/container/container_fwd.hpp>
 #include <deque>
 #include <vector>
 #include <string>
@@ -13,6 +14,8 @@
 
 #define MAX_ARRAY_ALLOC_SIZE (1024*1024*10) 
 
+namespace chainbase { template<typename T> class oid; }
+
 namespace fc { 
    class time_point;
    class time_point_sec;
@@ -57,6 +60,14 @@ namespace fc {
 
     template<typename Stream, typename T> inline void pack( Stream& s, const std::deque<T>& value );
     template<typename Stream, typename T> inline void unpack( Stream& s, std::deque<T>& value );
+    template<typename Stream, typename T, typename A> inline void pack( Stream& s, const boost::container::deque<T,A>& value );
+    template<typename Stream, typename T, typename A> inline void unpack( Stream& s, boost::container::deque<T,A>& value );
+    template<typename Stream, typename Tr, typename A> inline void pack( Stream& s, const boost::container::basic_string<char,Tr,A>& value );
+    template<typename Stream, typename Tr, typename A> inline void unpack( Stream& s, boost::container::basic_string<char,Tr,A>& value );
+
+    // defined with the chain's object types
+    template<typename Stream, typename T> inline void pack( Stream& s, const chainbase::oid<T>& id );
+    template<typename Stream, typename T> inline void unpack( Stream& s, chainbase::oid<T>& id );
 
     template<typename Stream, typename K, typename V> inline void pack( Stream& s, const std::unordered_map<K,V>& value );
     template<typename Stream, typename K, typename V> inline void unpack( Stream& s, std::unordered_map<K,V>& value );
@@ -2,6 +2,8 @@
 
 #include "miniz.c"
 
+#include <algorithm>
+
 namespace fc
 {
   string zlib_compress(const string& in)
@@ -12,4 +14,131 @@ namespace fc
     free(compressed_message);
     return result;
   }
+
+  string zlib_decompress(const string& in)
+  {
+    size_t decompressed_message_length;
+    char* decompressed_message = (char*)tinfl_decompress_mem_to_heap(in.c_str(), in.size(), &decompressed_message_length, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    // miniz returns NULL both for an empty result and for a corrupt stream
+    if( decompressed_message == nullptr )
+      return string();
+    string result(decompressed_message, decompressed_message_length);
+    free(decompressed_message);
+    return result;
+  }
+
+  string zlib_decompress(const string& in, size_t max_size)
+  {
+    // The output grows as it is inflated, so max_size only bounds the memory a stream can make us allocate
+    tinfl_decompressor decomp;
+    tinfl_init(&decomp);
+
+    string result( std::min( max_size, std::max< size_t >( in.size() * 4, 4096 ) ), '\0' );
+    size_t in_pos = 0, out_len = 0;
+    for( ; ; )
+    {
+      size_t in_size = in.size() - in_pos, out_size = result.size() - out_len;
+      tinfl_status status = tinfl_decompress(&decomp, (const mz_uint8*)in.c_str() + in_pos, &in_size, (mz_uint8*)&result[0],
+        (mz_uint8*)&result[0] + out_len, &out_size, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+      in_pos += in_size;
+      out_len += out_size;
+
+      if( status == TINFL_STATUS_DONE )
+        break;
+      if( status != TINFL_STATUS_HAS_MORE_OUTPUT || result.size() == max_size )
+        return string();
+
+      result.resize( std::min( max_size, result.size() * 2 ) );
+    }
+
+    result.resize(out_len);
+    return result;
+  }
+
+  namespace
+  {
+    enum gzip_flags
+    {
+      gzip_fhcrc    = 0x02,
+      gzip_fextra   = 0x04,
+      gzip_fname    = 0x08,
+      gzip_fcomment = 0x10
+    };
+
+    void append_le32(string& out, uint32_t v)
+    {
+      for( int i = 0; i < 4; ++i )
+        out.push_back( char( ( v >> ( 8 * i ) ) & 0xff ) );
+    }
+
+    uint32_t read_le32(const unsigned char* p)
+    {
+      return uint32_t(p[0]) | ( uint32_t(p[1]) << 8 ) | ( uint32_t(p[2]) << 16 ) | ( uint32_t(p[3]) << 24 );
+    }
+  }
+
+  string gzip_compress(const string& in)
+  {
+    size_t deflated_length;
+    char* deflated = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &deflated_length, TDEFL_DEFAULT_MAX_PROBES);
+
+    // magic, deflate, no flags, no mtime, no extra flags, unknown os
+    static const char header[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+
+    string result;
+    result.reserve(sizeof(header) + deflated_length + 8);
+    result.append(header, sizeof(header));
+    result.append(deflated, deflated_length);
+    free(deflated);
+
+    append_le32(result, uint32_t(mz_crc32(MZ_CRC32_INIT, (const unsigned char*)in.c_str(), in.size())));
+    append_le32(result, uint32_t(in.size()));
+    return result;
+  }
+
+  string gzip_decompress(const string& in, size_t max_size)
+  {
+    const unsigned char* p = (const unsigned char*)in.c_str();
+    size_t size = in.size();
+
+    if( size < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 )
+      return string();
+
+    uint8_t flags = p[3];
+    size_t pos = 10;
+
+    if( flags & gzip_fextra )
+    {
+      if( pos + 2 > size )
+        return string();
+      pos += 2 + ( size_t(p[pos]) | ( size_t(p[pos + 1]) << 8 ) );
+    }
+
+    for( uint8_t zero_terminated : { uint8_t(gzip_fname), uint8_t(gzip_fcomment) } )
+    {
+      if( !( flags & zero_terminated ) )
+        continue;
+      while( pos < size && p[pos] != 0 )
+        ++pos;
+      ++pos;
+    }
+
+    if( flags & gzip_fhcrc )
+      pos += 2;
+
+    if( pos + 8 > size )
+      return string();
+
+    // The length in the trailer is chosen by the sender, check it before allocating anything
+    uint32_t length = read_le32(p + size - 4);
+    if( length > max_size )
+      return string();
+    string result(length, '\0');
+    size_t inflated = tinfl_decompress_mem_to_mem(&result[0], result.size(), p + pos, size - pos - 8, 0);
+    if( inflated != length
+        || read_le32(p + size - 8) != uint32_t(mz_crc32(MZ_CRC32_INIT, (const unsigned char*)result.c_str(), result.size())) )
+      return string();
+
+    return result;
+  }
 }
@@ -1,4 +1,5 @@
 #include <fc/io/json.hpp>
+#include <fc/io/json_fast.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/io/iostream.hpp>
 #include <fc/io/buffered_iostream.hpp>
@@ -441,31 +442,26 @@ namespace fc
    /** the purpose of this check is to verify that we will not get a stack overflow in the recursive descent parser */
    void check_string_depth( const string& utf8_str  )
    {
-      int32_t open_object = 0;
-      int32_t open_array  = 0;
-      for( auto c : utf8_str )
-      {
-         switch( c )
-         {
-            case '{': open_object++; break;
-            case '}': open_object--; break;
-            case '[': open_array++; break;
-            case ']': open_array--; break;
-            default: break;
-         }
-         FC_ASSERT( open_object < 100 && open_array < 100, "object graph too deep", ("object depth",open_object)("array depth", open_array) );
-      }
+      json_fast::check_depth( utf8_str.data(), utf8_str.data() + utf8_str.size() );
    }
    
    variant json::from_string( const std::string& utf8_str, parse_type ptype )
    { try {
       check_string_depth( utf8_str );
 
+      if( ptype == fast_parser )
+      {
+         variant result;
+         if( json_fast::try_parse( utf8_str.data(), utf8_str.data() + utf8_str.size(), result ) )
+            return result;
+      }
+
       fc::stringstream in( utf8_str );
       //in.exceptions( std::ifstream::eofbit );
       switch( ptype )
       {
           case legacy_parser:
+          case fast_parser:
               return variant_from_stream<fc::stringstream, legacy_parser>( in );
           case legacy_parser_with_string_doubles:
               return variant_from_stream<fc::stringstream, legacy_parser_with_string_doubles>( in );
@@ -801,10 +797,21 @@ namespace fc
       //auto tmp = std::make_shared<fc::ifstream>( p, ifstream::binary );
       //auto tmp = std::make_shared<std::ifstream>( p.generic_string().c_str(), std::ios::binary );
       //buffered_istream bi( tmp );
+      if( ptype == fast_parser )
+      {
+         std::ifstream in( p.generic_string().c_str(), std::ios::binary );
+         std::string content( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+
+         variant result;
+         if( json_fast::try_parse( content.data(), content.data() + content.size(), result ) )
+            return result;
+      }
+
       boost::filesystem::ifstream bi( p, std::ios::binary );
       switch( ptype )
       {
           case legacy_parser:
+          case fast_parser:
               return variant_from_stream<boost::filesystem::ifstream, legacy_parser>( bi );
           case legacy_parser_with_string_doubles:
               return variant_from_stream<boost::filesystem::ifstream, legacy_parser_with_string_doubles>( bi );
@@ -821,6 +828,7 @@ namespace fc
       switch( ptype )
       {
           case legacy_parser:
+          case fast_parser:
               return variant_from_stream<fc::buffered_istream, legacy_parser>( in );
           case legacy_parser_with_string_doubles:
               return variant_from_stream<fc::buffered_istream, legacy_parser_with_string_doubles>( in );
@@ -852,10 +860,20 @@ namespace fc
    bool json::is_valid( const std::string& utf8_str, parse_type ptype )
    {
       if( utf8_str.size() == 0 ) return false;
+
+      if( ptype == fast_parser )
+      {
+         variant result;
+         const char* stop = nullptr;
+         if( json_fast::try_parse( utf8_str.data(), utf8_str.data() + utf8_str.size(), result, false, &stop ) )
+            return stop == utf8_str.data() + utf8_str.size();
+      }
+
       fc::stringstream in( utf8_str );
       switch( ptype )
       {
           case legacy_parser:
+          case fast_parser:
               variant_from_stream<fc::stringstream, legacy_parser>( in );
               break;
           case legacy_parser_with_string_doubles:
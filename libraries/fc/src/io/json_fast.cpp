@@ -0,0 +1,479 @@
+#include <fc/io/json_fast.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/string.hpp>
+#include <fc/variant_object.hpp>
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define FC_JSON_FAST_X86
+#include <immintrin.h>
+#endif
+
+namespace fc { namespace json_fast
+{
+   namespace detail
+   {
+      typedef const char* (*scan_function)( const char* p, const char* end );
+
+      inline bool is_bracket( char c )
+      {
+         return c == '{' || c == '}' || c == '[' || c == ']';
+      }
+
+      /** Returns the first '"', '\\' or end of transmission character, the only ones that end a run of string characters */
+      const char* find_string_special_scalar( const char* p, const char* end )
+      {
+         for( ; p < end; ++p )
+            if( *p == '"' || *p == '\\' || *p == '\x04' )
+               return p;
+         return end;
+      }
+
+      const char* find_bracket_scalar( const char* p, const char* end )
+      {
+         for( ; p < end; ++p )
+            if( is_bracket( *p ) )
+               return p;
+         return end;
+      }
+
+#ifdef FC_JSON_FAST_X86
+      /*
+       * '[' and ']' are '{' and '}' with bit 0x20 cleared, so or-ing every byte with 0x20 finds all four
+       * brackets with two comparisons.
+       */
+      __attribute__((target("sse2")))
+      const char* find_string_special_sse2( const char* p, const char* end )
+      {
+         const __m128i quote = _mm_set1_epi8( '"' );
+         const __m128i backslash = _mm_set1_epi8( '\\' );
+         const __m128i eot = _mm_set1_epi8( '\x04' );
+
+         for( ; end - p >= 16; p += 16 )
+         {
+            __m128i v = _mm_loadu_si128( (const __m128i*)p );
+            int mask = _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, quote ), _mm_cmpeq_epi8( v, backslash ) ),
+                                                        _mm_cmpeq_epi8( v, eot ) ) );
+            if( mask )
+               return p + __builtin_ctz( mask );
+         }
+
+         return find_string_special_scalar( p, end );
+      }
+
+      __attribute__((target("sse2")))
+      const char* find_bracket_sse2( const char* p, const char* end )
+      {
+         const __m128i case_bit = _mm_set1_epi8( 0x20 );
+         const __m128i open = _mm_set1_epi8( '{' );
+         const __m128i close = _mm_set1_epi8( '}' );
+
+         for( ; end - p >= 16; p += 16 )
+         {
+            __m128i v = _mm_or_si128( _mm_loadu_si128( (const __m128i*)p ), case_bit );
+            int mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, open ), _mm_cmpeq_epi8( v, close ) ) );
+            if( mask )
+               return p + __builtin_ctz( mask );
+         }
+
+         return find_bracket_scalar( p, end );
+      }
+
+      __attribute__((target("avx2")))
+      const char* find_string_special_avx2( const char* p, const char* end )
+      {
+         const __m256i quote = _mm256_set1_epi8( '"' );
+         const __m256i backslash = _mm256_set1_epi8( '\\' );
+         const __m256i eot = _mm256_set1_epi8( '\x04' );
+
+         for( ; end - p >= 32; p += 32 )
+         {
+            __m256i v = _mm256_loadu_si256( (const __m256i*)p );
+            uint32_t mask = _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, quote ), _mm256_cmpeq_epi8( v, backslash ) ),
+                                                                   _mm256_cmpeq_epi8( v, eot ) ) );
+            if( mask )
+               return p + __builtin_ctz( mask );
+         }
+
+         return find_string_special_sse2( p, end );
+      }
+
+      __attribute__((target("avx2")))
+      const char* find_bracket_avx2( const char* p, const char* end )
+      {
+         const __m256i case_bit = _mm256_set1_epi8( 0x20 );
+         const __m256i open = _mm256_set1_epi8( '{' );
+         const __m256i close = _mm256_set1_epi8( '}' );
+
+         for( ; end - p >= 32; p += 32 )
+         {
+            __m256i v = _mm256_or_si256( _mm256_loadu_si256( (const __m256i*)p ), case_bit );
+            uint32_t mask = _mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8( v, open ), _mm256_cmpeq_epi8( v, close ) ) );
+            if( mask )
+               return p + __builtin_ctz( mask );
+         }
+
+         return find_bracket_sse2( p, end );
+      }
+#endif
+
+      simd_level detect_simd_level()
+      {
+#ifdef FC_JSON_FAST_X86
+         __builtin_cpu_init();
+         if( __builtin_cpu_supports( "avx2" ) )
+            return avx2;
+         if( __builtin_cpu_supports( "sse2" ) )
+            return sse2;
+#endif
+         return scalar;
+      }
+
+      std::atomic< int >& current_level()
+      {
+         static std::atomic< int > level( max_simd_level() );
+         return level;
+      }
+
+      scan_function get_string_scanner( simd_level level )
+      {
+#ifdef FC_JSON_FAST_X86
+         switch( level )
+         {
+            case avx2: return &find_string_special_avx2;
+            case sse2: return &find_string_special_sse2;
+            default: break;
+         }
+#endif
+         return &find_string_special_scalar;
+      }
+
+      scan_function get_bracket_scanner( simd_level level )
+      {
+#ifdef FC_JSON_FAST_X86
+         switch( level )
+         {
+            case avx2: return &find_bracket_avx2;
+            case sse2: return &find_bracket_sse2;
+            default: break;
+         }
+#endif
+         return &find_bracket_scalar;
+      }
+
+      /** Thrown when the input needs the legacy parser, never leaves try_parse */
+      struct use_legacy_parser {};
+
+      /**
+       * Follows the control flow of variant_from_stream in json.cpp over a contiguous buffer, but
+       * copies whole runs of string characters at a time and parses short integers without
+       * boost::lexical_cast. Every path where the legacy parser throws or returns something other
+       * than strict json gives up instead.
+       */
+      template< bool StringDoubles >
+      class parser
+      {
+         public:
+            parser( const char* begin, const char* end, scan_function string_scanner )
+               : _p( begin ), _end( end ), _find_string_special( string_scanner ) {}
+
+            variant parse_value()
+            {
+               skip_white_space();
+               if( _p == _end )
+                  throw use_legacy_parser();
+
+               switch( *_p )
+               {
+                  case '"':
+                     return parse_string();
+                  case '{':
+                     return parse_object();
+                  case '[':
+                     return parse_array();
+                  case '-':
+                  case '.':
+                  case '0':
+                  case '1':
+                  case '2':
+                  case '3':
+                  case '4':
+                  case '5':
+                  case '6':
+                  case '7':
+                  case '8':
+                  case '9':
+                     return parse_number();
+                  case 'n':
+                  case 't':
+                  case 'f':
+                     return parse_token();
+                  default:
+                     throw use_legacy_parser();
+               }
+            }
+
+            const char* position()const { return _p; }
+
+         private:
+            bool skip_white_space()
+            {
+               const char* start = _p;
+               while( _p < _end && ( *_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r' ) )
+                  ++_p;
+               return _p != start;
+            }
+
+            std::string parse_string()
+            {
+               if( _p == _end || *_p != '"' )
+                  throw use_legacy_parser();
+               ++_p;
+
+               std::string result;
+               while( true )
+               {
+                  const char* special = _find_string_special( _p, _end );
+                  if( special == _end )
+                     throw use_legacy_parser();
+
+                  result.append( _p, special );
+                  _p = special + 1;
+
+                  switch( *special )
+                  {
+                     case '"':
+                        return result;
+                     case '\\':
+                        if( _p == _end )
+                           throw use_legacy_parser();
+
+                        // Only these escapes are translated, any other escaped character is kept as it is
+                        switch( *_p )
+                        {
+                           case 't': result.push_back( '\t' ); break;
+                           case 'n': result.push_back( '\n' ); break;
+                           case 'r': result.push_back( '\r' ); break;
+                           default: result.push_back( *_p ); break;
+                        }
+                        ++_p;
+                        break;
+                     default:
+                        throw use_legacy_parser();
+                  }
+               }
+            }
+
+            variant parse_object()
+            {
+               mutable_variant_object obj;
+               ++_p;
+               skip_white_space();
+
+               while( true )
+               {
+                  if( _p == _end )
+                     throw use_legacy_parser();
+                  if( *_p == '}' )
+                     break;
+                  if( *_p == ',' )
+                  {
+                     ++_p;
+                     continue;
+                  }
+                  if( skip_white_space() )
+                     continue;
+
+                  std::string key = parse_string();
+                  skip_white_space();
+                  if( _p == _end || *_p != ':' )
+                     throw use_legacy_parser();
+                  ++_p;
+
+                  auto val = parse_value();
+                  obj( std::move( key ), std::move( val ) );
+                  skip_white_space();
+               }
+
+               ++_p;
+               return variant_object( std::move( obj ) );
+            }
+
+            variant parse_array()
+            {
+               variants ar;
+               ++_p;
+               skip_white_space();
+
+               while( true )
+               {
+                  if( _p == _end )
+                     throw use_legacy_parser();
+                  if( *_p == ']' )
+                     break;
+                  if( *_p == ',' )
+                  {
+                     ++_p;
+                     continue;
+                  }
+                  if( skip_white_space() )
+                     continue;
+
+                  ar.push_back( parse_value() );
+                  skip_white_space();
+               }
+
+               ++_p;
+               return variant( std::move( ar ) );
+            }
+
+            variant parse_number()
+            {
+               const char* start = _p;
+               bool neg = false;
+               bool dot = false;
+
+               if( *_p == '-' )
+               {
+                  neg = true;
+                  ++_p;
+               }
+
+               const char* digits = _p;
+               for( ; _p < _end; ++_p )
+               {
+                  char c = *_p;
+                  if( c == '.' )
+                  {
+                     if( dot )
+                        throw use_legacy_parser();
+                     dot = true;
+                  }
+                  else if( c < '0' || c > '9' )
+                  {
+                     // The legacy parser turns numbers followed by letters, such as 1e5, into strings
+                     if( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c & 0x80 ) )
+                        throw use_legacy_parser();
+                     break;
+                  }
+               }
+
+               size_t num_digits = _p - digits;
+               if( num_digits == 0 || ( dot && num_digits == 1 ) )
+                  throw use_legacy_parser();
+
+               if( dot )
+               {
+                  fc::string str( start, _p );
+                  if( StringDoubles )
+                     return variant( str );
+                  return variant( to_double( str ) );
+               }
+
+               // Up to 18 digits fit in an int64 either way, longer numbers are left to lexical_cast
+               if( num_digits <= 18 )
+               {
+                  uint64_t value = 0;
+                  for( const char* d = digits; d < _p; ++d )
+                     value = value * 10 + uint64_t( *d - '0' );
+
+                  if( neg )
+                     return variant( -int64_t( value ) );
+                  return variant( value );
+               }
+
+               if( neg )
+                  return variant( to_int64( fc::string( start, _p ) ) );
+               return variant( to_uint64( fc::string( start, _p ) ) );
+            }
+
+            variant parse_token()
+            {
+               static const char token_chars[] = "nultreafs";
+
+               const char* start = _p;
+               while( _p < _end && *_p && std::strchr( token_chars, *_p ) )
+                  ++_p;
+
+               size_t len = _p - start;
+               if( len == 4 && std::memcmp( start, "null", 4 ) == 0 )
+                  return variant();
+               if( len == 4 && std::memcmp( start, "true", 4 ) == 0 )
+                  return variant( true );
+               if( len == 5 && std::memcmp( start, "false", 5 ) == 0 )
+                  return variant( false );
+
+               throw use_legacy_parser();
+            }
+
+            const char*       _p;
+            const char*       _end;
+            scan_function     _find_string_special;
+      };
+
+      template< bool StringDoubles >
+      bool parse( const char* begin, const char* end, variant& result, const char** stop )
+      {
+         parser< StringDoubles > p( begin, end, get_string_scanner( get_simd_level() ) );
+
+         try
+         {
+            result = p.parse_value();
+         }
+         catch( ... )
+         {
+            return false;
+         }
+
+         if( stop )
+            *stop = p.position();
+         return true;
+      }
+   }
+
+   simd_level get_simd_level()
+   {
+      return simd_level( detail::current_level().load( std::memory_order_relaxed ) );
+   }
+
+   simd_level max_simd_level()
+   {
+      static const simd_level level = detail::detect_simd_level();
+      return level;
+   }
+
+   void set_simd_level( simd_level level )
+   {
+      detail::current_level().store( std::min( level, max_simd_level() ), std::memory_order_relaxed );
+   }
+
+   bool try_parse( const char* begin, const char* end, variant& result, bool string_doubles, const char** stop )
+   {
+      if( string_doubles )
+         return detail::parse< true >( begin, end, result, stop );
+      return detail::parse< false >( begin, end, result, stop );
+   }
+
+   void check_depth( const char* begin, const char* end )
+   {
+      auto find_bracket = detail::get_bracket_scanner( get_simd_level() );
+      int32_t open_object = 0;
+      int32_t open_array  = 0;
+
+      for( const char* p = find_bracket( begin, end ); p < end; p = find_bracket( p + 1, end ) )
+      {
+         switch( *p )
+         {
+            case '{': open_object++; break;
+            case '}': open_object--; break;
+            case '[': open_array++; break;
+            case ']': open_array--; break;
+            default: break;
+         }
+         FC_ASSERT( open_object < 100 && open_array < 100, "object graph too deep", ("object depth",open_object)("array depth", open_array) );
+      }
+   }
+
+} } // fc::json_fast
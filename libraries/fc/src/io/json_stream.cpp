@@ -0,0 +1,133 @@
+#include <fc/io/json_stream.hpp>
+
+namespace fc
+{
+   void json_stream::write_int( int64_t i )
+   {
+      if( _format == json::stringify_large_ints_and_doubles && i > 0xffffffff )
+      {
+         write_raw( '"' );
+         _out.append( std::to_string( i ) );
+         write_raw( '"' );
+      }
+      else
+      {
+         _out.append( std::to_string( i ) );
+      }
+   }
+
+   void json_stream::write_uint( uint64_t i )
+   {
+      if( _format == json::stringify_large_ints_and_doubles && i > 0xffffffff )
+      {
+         write_raw( '"' );
+         _out.append( std::to_string( i ) );
+         write_raw( '"' );
+      }
+      else
+      {
+         _out.append( std::to_string( i ) );
+      }
+   }
+
+   /**
+    *  Escapes the same characters as json::to_string, appending the runs of characters in between in one go.
+    */
+   void json_stream::write_string( const std::string& s )
+   {
+      static const char* hex = "0123456789abcdef";
+
+      write_raw( '"' );
+
+      const char* run = s.data();
+      const char* end = s.data() + s.size();
+
+      for( const char* itr = run; itr != end; ++itr )
+      {
+         unsigned char c = *itr;
+         if( c >= 0x20 && c != '"' && c != '\\' )
+            continue;
+
+         _out.append( run, itr - run );
+         run = itr + 1;
+
+         switch( c )
+         {
+            case '\b': write_raw( "\\b", 2 ); break;
+            case '\f': write_raw( "\\f", 2 ); break;
+            case '\n': write_raw( "\\n", 2 ); break;
+            case '\r': write_raw( "\\r", 2 ); break;
+            case '\t': write_raw( "\\t", 2 ); break;
+            case '\\': write_raw( "\\\\", 2 ); break;
+            case '"':  write_raw( "\\\"", 2 ); break;
+            default:
+               write_raw( "\\u00", 4 );
+               write_raw( hex[ c >> 4 ] );
+               write_raw( hex[ c & 0xf ] );
+         }
+      }
+
+      _out.append( run, end - run );
+      write_raw( '"' );
+   }
+
+   void json_stream::write_variant( const variant& v )
+   {
+      switch( v.get_type() )
+      {
+         case variant::null_type:
+            write_null();
+            return;
+         case variant::int64_type:
+            write_int( v.as_int64() );
+            return;
+         case variant::uint64_type:
+            write_uint( v.as_uint64() );
+            return;
+         case variant::double_type:
+            if( _format == json::stringify_large_ints_and_doubles )
+            {
+               write_raw( '"' );
+               write_raw( v.as_string() );
+               write_raw( '"' );
+            }
+            else
+            {
+               write_raw( v.as_string() );
+            }
+            return;
+         case variant::bool_type:
+            write_bool( v.as_bool() );
+            return;
+         case variant::string_type:
+            write_string( v.get_string() );
+            return;
+         case variant::blob_type:
+            write_string( v.as_string() );
+            return;
+         case variant::array_type:
+            json_stream_detail::write_array( *this, v.get_array() );
+            return;
+         case variant::object_type:
+            write_object( v.get_object() );
+            return;
+      }
+   }
+
+   void json_stream::write_object( const variant_object& o )
+   {
+      write_raw( '{' );
+
+      for( auto itr = o.begin(); itr != o.end(); ++itr )
+      {
+         if( itr != o.begin() )
+            write_raw( ',' );
+
+         write_string( itr->key() );
+         write_raw( ':' );
+         write_variant( itr->value() );
+      }
+
+      write_raw( '}' );
+   }
+}
@@ -39,29 +39,6 @@ BOOST_AUTO_TEST_CASE(smaz_test)
 }
 
 
-extern "C" {
-
-enum
-{
-  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
-  TINFL_FLAG_HAS_MORE_INPUT = 2,
-  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
-  TINFL_FLAG_COMPUTE_ADLER32 = 8
-};
-
-extern char* tinfl_decompress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, size_t *pOut_len, int flags);
-
-}
-
-static std::string zlib_decompress( const std::string compressed )
-{
-    size_t decomp_len;
-    char* decomp = tinfl_decompress_mem_to_heap( compressed.c_str(), compressed.length(), &decomp_len, TINFL_FLAG_PARSE_ZLIB_HEADER );
-    std::string result( decomp, decomp_len );
-    free( decomp );
-    return result;
-}
-
 BOOST_AUTO_TEST_CASE(zlib_test)
 {
     std::ifstream testfile;
@@ -74,7 +51,7 @@ BOOST_AUTO_TEST_CASE(zlib_test)
     {
         buffer << line << "\n";
         std::string compressed = fc::zlib_compress( line );
-        std::string decomp = zlib_decompress( compressed );
+        std::string decomp = fc::zlib_decompress( compressed );
         BOOST_CHECK_EQUAL( decomp, line );
 
         std::getline( testfile, line );
@@ -82,8 +59,63 @@ BOOST_AUTO_TEST_CASE(zlib_test)
 
     line = buffer.str();
     std::string compressed = fc::zlib_compress( line );
-    std::string decomp = zlib_decompress( compressed );
+    std::string decomp = fc::zlib_decompress( compressed );
     BOOST_CHECK_EQUAL( decomp, line );
 }
 
+BOOST_AUTO_TEST_CASE(zlib_bounded_test)
+{
+    std::string text = std::string( 5000, 'x' ) + "end";
+    std::string compressed = fc::zlib_compress( text );
+
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed, text.size() ), text );
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed, text.size() * 2 ), text );
+    // Nothing near the limit is allocated up front
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed, size_t(1) << 40 ), text );
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed, text.size() - 1 ), "" );
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed.substr( 0, compressed.size() / 2 ), text.size() * 2 ), "" );
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( fc::zlib_compress( "" ), 16 ), "" );
+}
+
+BOOST_AUTO_TEST_CASE(gzip_test)
+{
+    std::ifstream testfile;
+    testfile.open("README.md");
+
+    std::stringstream buffer;
+    buffer << testfile.rdbuf();
+    std::string text = buffer.str() + std::string( 5000, 'x' );
+
+    for( const std::string& in : { std::string(), std::string( "a" ), text } )
+    {
+        std::string compressed = fc::gzip_compress( in );
+        BOOST_REQUIRE_GE( compressed.size(), 18u );
+        BOOST_CHECK_EQUAL( (unsigned char)compressed[0], 0x1f );
+        BOOST_CHECK_EQUAL( (unsigned char)compressed[1], 0x8b );
+        BOOST_CHECK_EQUAL( fc::gzip_decompress( compressed, in.size() ), in );
+    }
+
+    std::string compressed = fc::gzip_compress( text );
+    BOOST_CHECK_LT( compressed.size(), text.size() );
+
+    // The trailer carries the crc and the length of the original data
+    std::string corrupt = compressed;
+    corrupt[ corrupt.size() - 5 ] ^= 1;
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( corrupt, text.size() ), "" );
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( compressed.substr( 0, compressed.size() - 1 ), text.size() ), "" );
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( fc::zlib_compress( text ), text.size() ), "" );
+
+    // The length in the trailer is checked against max_size before anything is allocated
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( compressed, text.size() - 1 ), "" );
+    std::string huge = compressed;
+    for( size_t i = huge.size() - 4; i < huge.size(); ++i )
+        huge[i] = '\xff';
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( huge, text.size() ), "" );
+
+    // A file name in the header is skipped
+    std::string named = compressed.substr( 0, 10 ) + "README.md" + '\0' + compressed.substr( 10 );
+    named[3] = 0x08;
+    BOOST_CHECK_EQUAL( fc::gzip_decompress( named, text.size() ), text );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
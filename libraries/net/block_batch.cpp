@@ -0,0 +1,67 @@
+#include <graphene/net/block_batch.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/compress/zlib.hpp>
+
+namespace graphene { namespace net {
+
+block_batch_requests split_block_batch_requests( const std::vector<item_hash_t>& items_to_request, uint32_t max_blocks_per_batch )
+{
+   block_batch_requests requests;
+   for( size_t run_start = 0; run_start < items_to_request.size(); )
+   {
+      size_t run_end = run_start + 1;
+      while( run_end < items_to_request.size() &&
+             run_end - run_start < max_blocks_per_batch &&
+             voilk::protocol::block_header::num_from_id( items_to_request[run_end] ) == voilk::protocol::block_header::num_from_id( items_to_request[run_end - 1] ) + 1 )
+         ++run_end;
+
+      if( run_end - run_start == 1 )
+         requests.single_items.push_back( items_to_request[run_start] );
+      else
+         requests.batches.emplace_back( items_to_request.begin() + run_start, items_to_request.begin() + run_end );
+      run_start = run_end;
+   }
+   return requests;
+}
+
+std::vector<block_message> unpack_block_batch( const block_batch_message& batch )
+{
+   FC_ASSERT( batch.count > 0 && batch.count <= GRAPHENE_NET_MAX_BLOCKS_PER_BATCH,
+              "Invalid number of blocks in the batch", ("count", batch.count) );
+
+   std::string packed_blocks( batch.data.begin(), batch.data.end() );
+   if( batch.compression == block_batch_compression::zlib )
+   {
+      // bounded, so a small message can't make us inflate more than a batch ever holds
+      packed_blocks = fc::zlib_decompress( packed_blocks, GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES );
+      FC_ASSERT( !packed_blocks.empty(), "Invalid compressed block batch" );
+   }
+   else
+      FC_ASSERT( batch.compression == block_batch_compression::none, "Unknown block batch compression" );
+
+   std::vector<block_message> blocks;
+   blocks.reserve( batch.count );
+   fc::datastream<const char*> ds( packed_blocks.data(), packed_blocks.size() );
+   for( uint32_t i = 0; i < batch.count; ++i )
+   {
+      signed_block block;
+      fc::raw::unpack( ds, block );
+      blocks.emplace_back( block );
+   }
+   FC_ASSERT( ds.remaining() == 0, "Unexpected data after the blocks of the batch" );
+   return blocks;
+}
+
+size_t count_requested_batch_blocks( const std::vector<block_message>& blocks, const std::vector<item_hash_t>& requested_blocks )
+{
+   FC_ASSERT( blocks.size() <= requested_blocks.size(), "The batch has ${count} blocks but ${requested} were requested",
+              ("count", blocks.size())("requested", requested_blocks.size()) );
+
+   size_t count = 0;
+   while( count < blocks.size() && blocks[count].block_id == requested_blocks[count] )
+      ++count;
+   return count;
+}
+
+} } // graphene::net
@@ -0,0 +1,54 @@
+#include <graphene/net/compact_block.hpp>
+#include <graphene/net/message.hpp>
+
+namespace graphene { namespace net {
+
+compact_block_message make_compact_block( const item_hash_t& block_message_hash, const signed_block& block )
+{
+   compact_block_message compact_block;
+   compact_block.block_message_hash = block_message_hash;
+   compact_block.header = block;
+   compact_block.short_transaction_ids.reserve( block.transactions.size() );
+   for( const signed_transaction& transaction : block.transactions )
+      compact_block.short_transaction_ids.push_back( compact_block_message::short_transaction_id( block_message_hash, transaction.id() ) );
+   return compact_block;
+}
+
+compact_block_reconstruction start_compact_block_reconstruction( const compact_block_message& compact_block,
+                                                                 std::vector< fc::optional<signed_transaction> > found_transactions )
+{
+   size_t transaction_count = compact_block.short_transaction_ids.size();
+   found_transactions.resize( transaction_count );
+
+   compact_block_reconstruction reconstruction;
+   static_cast<signed_block_header&>( reconstruction.block ) = compact_block.header;
+   reconstruction.block.transactions.resize( transaction_count );
+   for( uint32_t i = 0; i < transaction_count; ++i )
+   {
+      if( found_transactions[i] )
+         reconstruction.block.transactions[i] = std::move( *found_transactions[i] );
+      else
+         reconstruction.missing_transaction_indexes.push_back( i );
+   }
+   return reconstruction;
+}
+
+signed_block complete_compact_block_reconstruction( compact_block_reconstruction&& reconstruction,
+                                                    const std::vector<signed_transaction>& missing_transactions )
+{
+   const std::vector<uint32_t>& missing_transaction_indexes = reconstruction.missing_transaction_indexes;
+   FC_ASSERT( missing_transactions.size() == missing_transaction_indexes.size(),
+              "Got ${count} transactions for the ${missing} missing ones",
+              ("count", missing_transactions.size())("missing", missing_transaction_indexes.size()) );
+
+   for( size_t i = 0; i < missing_transaction_indexes.size(); ++i )
+      reconstruction.block.transactions[missing_transaction_indexes[i]] = missing_transactions[i];
+   return std::move( reconstruction.block );
+}
+
+bool is_advertised_compact_block( const block_message& rebuilt_block, const item_hash_t& block_message_hash )
+{
+   return message( rebuilt_block ).id() == block_message_hash;
+}
+
+} } // graphene::net
@@ -23,6 +23,10 @@
  */
 #include <graphene/net/core_messages.hpp>
 
+#include <fc/crypto/city.hpp>
+
+#include <cstring>
+
 
 namespace graphene { namespace net {
 
@@ -45,6 +49,20 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum fetch_block_batch_message::type               = core_message_type_enum::fetch_block_batch_message_type;
+  const core_message_type_enum block_batch_message::type                     = core_message_type_enum::block_batch_message_type;
+  const core_message_type_enum fetch_compact_block_message::type             = core_message_type_enum::fetch_compact_block_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_block_transactions_message::type        = core_message_type_enum::fetch_block_transactions_message_type;
+  const core_message_type_enum block_transactions_message::type              = core_message_type_enum::block_transactions_message_type;
+
+  uint64_t compact_block_message::short_transaction_id(const item_hash_t& block_message_hash, const transaction_id_type& transaction_id)
+  {
+    char buffer[sizeof(item_hash_t) + sizeof(transaction_id_type)];
+    memcpy(buffer, block_message_hash.data(), sizeof(item_hash_t));
+    memcpy(buffer + sizeof(item_hash_t), transaction_id.data(), sizeof(transaction_id_type));
+    return fc::city_hash64(buffer, sizeof(buffer));
+  }
 
 } } // graphene::net
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /**
+    * The sync blocks requested from a peer, see node_impl::request_sync_items_from_peer()
+    */
+   struct block_batch_requests
+   {
+      std::vector< std::vector<item_hash_t> > batches;       /// runs of consecutive blocks, each asked for with one fetch_block_batch_message
+      std::vector<item_hash_t>                single_items;  /// blocks without a neighbour, asked for with a fetch_items_message
+   };
+
+   /**
+    * Splits the sync blocks to request, in the order they are requested, into runs of consecutive block
+    * numbers of at most max_blocks_per_batch blocks.
+    */
+   block_batch_requests split_block_batch_requests( const std::vector<item_hash_t>& items_to_request, uint32_t max_blocks_per_batch );
+
+   /**
+    * Unpacks the blocks of a batch, inflating them first when they are compressed.  Throws when the
+    * batch does not hold exactly count blocks, or they would inflate to more than
+    * GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES.
+    */
+   std::vector<block_message> unpack_block_batch( const block_batch_message& batch );
+
+   /**
+    * The number of blocks of a batch that are the first ones requested, in order.  A peer sends fewer
+    * blocks when they don't fit in one message and different ones when it switched forks, the others
+    * are requested again.  Throws when the batch has more blocks than requested.
+    */
+   size_t count_requested_batch_blocks( const std::vector<block_message>& blocks, const std::vector<item_hash_t>& requested_blocks );
+
+} } // graphene::net
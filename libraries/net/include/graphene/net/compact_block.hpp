@@ -0,0 +1,44 @@
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <vector>
+
+namespace graphene { namespace net {
+
+   /**
+    * A block a peer sent us compact, waiting for the transactions we didn't have in our pending pool
+    */
+   struct compact_block_reconstruction
+   {
+      signed_block          block;
+      std::vector<uint32_t> missing_transaction_indexes;
+   };
+
+   /**
+    * The compact_block_message of the block advertised with block_message_hash: its header and the short
+    * ids of its transactions
+    */
+   compact_block_message make_compact_block( const item_hash_t& block_message_hash, const signed_block& block );
+
+   /**
+    * Starts rebuilding a compact block from the transactions found in our pending pool, one optional per
+    * short id.  The positions of those not found are the transactions to request from the peer.
+    */
+   compact_block_reconstruction start_compact_block_reconstruction( const compact_block_message& compact_block,
+                                                                    std::vector< fc::optional<signed_transaction> > found_transactions );
+
+   /**
+    * Puts the transactions the peer sent, in the order of missing_transaction_indexes, into the block.
+    * Throws when their number doesn't match.
+    */
+   signed_block complete_compact_block_reconstruction( compact_block_reconstruction&& reconstruction,
+                                                       const std::vector<signed_transaction>& missing_transactions );
+
+   /**
+    * Whether a rebuilt block is the one advertised.  A short id collision or a pending transaction with
+    * different signatures gives a different block, the full block has to be requested then.
+    */
+   bool is_advertised_compact_block( const block_message& rebuilt_block, const item_hash_t& block_message_hash );
+
+} } // graphene::net
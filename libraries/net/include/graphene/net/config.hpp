@@ -23,7 +23,10 @@
  */
 #pragma once
 
-#define GRAPHENE_NET_PROTOCOL_VERSION                        106
+#define GRAPHENE_NET_PROTOCOL_VERSION                        107
+
+/** Peers at this protocol version or later understand fetch_block_batch_message and block_batch_message */
+#define GRAPHENE_NET_BLOCK_BATCH_PROTOCOL_VERSION            107
 
 /**
  * Define this to enable debugging code in the p2p network interface.
@@ -37,6 +40,12 @@
  * 2MiB
  */
 #define MAX_MESSAGE_SIZE                                     1024*1024*2
+
+/**
+ * Size of the buffers stcp_socket decrypts reads from and encrypts writesome() calls into.  Messages are
+ * sent with stcp_socket::write_frame(), which encrypts them in place instead
+ */
+#define GRAPHENE_NET_STCP_BUFFER_SIZE                        (64 * 1024)
 #define GRAPHENE_NET_DEFAULT_PEER_CONNECTION_RETRY_TIME      30 // seconds
 
 /**
@@ -81,6 +90,44 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * During sync each peer gets a window of blocks it may have outstanding, sized so it covers the
+ * peer's round trip plus this many milliseconds of blocks at the rate the peer delivers them.
+ * Windows stay between the minimum and maximum_blocks_per_peer_during_syncing, a peer starts
+ * with the initial window until its rate is known.
+ */
+#define GRAPHENE_NET_SYNC_WINDOW_MILLISECONDS                2000
+#define GRAPHENE_NET_MIN_SYNC_WINDOW                         10
+#define GRAPHENE_NET_INITIAL_SYNC_WINDOW                     50
+
+/**
+ * A sync block is also requested from another peer once it has been outstanding this many times
+ * longer than its peer should need to deliver it, and at least the minimum.
+ */
+#define GRAPHENE_NET_SYNC_OVERDUE_FACTOR                     3
+#define GRAPHENE_NET_MIN_SYNC_OVERDUE_MILLISECONDS           1000
+
+/**
+ * A block batch carries at most this many blocks, and stops adding blocks once their packed size
+ * would go over the byte limit, which leaves room for the rest of the message.
+ */
+#define GRAPHENE_NET_MAX_BLOCKS_PER_BATCH                    GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING
+#define GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES                   (MAX_MESSAGE_SIZE - 1024)
+
+/**
+ * Threads that hash and unpack received blocks, block batches and messages of at least the minimum size,
+ * instead of the p2p thread.  Smaller messages cost less to decode than to hand over to another thread.
+ * The thread count is the default of the p2p-message-decode-threads option
+ */
+#define GRAPHENE_NET_MESSAGE_DECODE_THREADS                  2
+#define GRAPHENE_NET_MIN_MESSAGE_SIZE_TO_DECODE_IN_THREAD    4096
+
+/**
+ * The compact forms of this many of the blocks peers asked for last are kept, so the short ids of a new
+ * block are computed once however many peers ask for it
+ */
+#define GRAPHENE_NET_RECENT_COMPACT_BLOCKS                   4
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
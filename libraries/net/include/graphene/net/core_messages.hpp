@@ -44,6 +44,7 @@ namespace graphene { namespace net {
   using voilk::protocol::block_id_type;
   using voilk::protocol::transaction_id_type;
   using voilk::protocol::signed_block;
+  using voilk::protocol::signed_block_header;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -86,6 +87,12 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    fetch_block_batch_message_type               = 5018,
+    block_batch_message_type                     = 5019,
+    fetch_compact_block_message_type             = 5020,
+    compact_block_message_type                   = 5021,
+    fetch_block_transactions_message_type        = 5022,
+    block_transactions_message_type              = 5023,
     core_message_type_last                       = 5099
   };
 
@@ -397,6 +404,103 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  enum class block_batch_compression : uint8_t
+  {
+    none = 0,
+    zlib = 1
+  };
+
+  /**
+   * Requests count blocks starting at first_block on the chain of the peer, sent back in a single
+   * block_batch_message.  Only sent to peers at GRAPHENE_NET_BLOCK_BATCH_PROTOCOL_VERSION or later
+   */
+  struct fetch_block_batch_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                                         first_block;
+    uint32_t                                              count = 0;
+    fc::enum_type<uint8_t, block_batch_compression>       compression = block_batch_compression::none; /// the compression the requester accepts
+
+    fetch_block_batch_message() {}
+    fetch_block_batch_message(const block_id_type& first_block, uint32_t count, block_batch_compression compression) :
+      first_block(first_block),
+      count(count),
+      compression(compression)
+    {}
+  };
+
+  /**
+   * The packed signed_blocks of a fetch_block_batch_message, back to back, copied from the block log
+   * without deserializing them.  count is lower than requested when the blocks would not fit in one
+   * message or the peer doesn't have them all, the requester asks for the rest again
+   */
+  struct block_batch_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                                         first_block;
+    uint32_t                                              count = 0;
+    fc::enum_type<uint8_t, block_batch_compression>       compression = block_batch_compression::none;
+    std::vector<char>                                     data;
+  };
+
+  /**
+   * Requests the block advertised with block_message_hash as a compact_block_message.  Only sent during
+   * normal operation to peers that announced "compact_blocks" in their hello user data, the
+   * transactions of a new block are usually already in our pending pool
+   */
+  struct fetch_compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t block_message_hash;
+
+    fetch_compact_block_message() {}
+    fetch_compact_block_message(const item_hash_t& block_message_hash) :
+      block_message_hash(block_message_hash)
+    {}
+  };
+
+  /**
+   * A block header with a short id for each of its transactions, in block order.  The receiver rebuilds
+   * the block from its pending transactions and asks for the ones it doesn't have with a
+   * fetch_block_transactions_message
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t           block_message_hash;
+    signed_block_header   header;
+    std::vector<uint64_t> short_transaction_ids;
+
+    /** Short ids are salted with the block so a collision in one block doesn't carry over to the next */
+    static uint64_t short_transaction_id(const item_hash_t& block_message_hash, const transaction_id_type& transaction_id);
+  };
+
+  struct fetch_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t           block_message_hash;
+    std::vector<uint32_t> transaction_indexes; /// positions in the block of the transactions we are missing
+
+    fetch_block_transactions_message() {}
+    fetch_block_transactions_message(const item_hash_t& block_message_hash, const std::vector<uint32_t>& transaction_indexes) :
+      block_message_hash(block_message_hash),
+      transaction_indexes(transaction_indexes)
+    {}
+  };
+
+  struct block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t                     block_message_hash;
+    std::vector<signed_transaction> transactions; /// in the order of the transaction_indexes requested
+  };
+
 
 } } // graphene::net
 
@@ -421,6 +525,12 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (fetch_block_batch_message_type)
+                 (block_batch_message_type)
+                 (fetch_compact_block_message_type)
+                 (compact_block_message_type)
+                 (fetch_block_transactions_message_type)
+                 (block_transactions_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -505,6 +615,23 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (download_rate_one_hour)
                                                             (current_connections))
 
+FC_REFLECT_ENUM( graphene::net::block_batch_compression, (none)(zlib) )
+FC_REFLECT( graphene::net::fetch_block_batch_message, (first_block)
+                                                 (count)
+                                                 (compression) )
+FC_REFLECT( graphene::net::block_batch_message, (first_block)
+                                           (count)
+                                           (compression)
+                                           (data) )
+FC_REFLECT( graphene::net::fetch_compact_block_message, (block_message_hash) )
+FC_REFLECT( graphene::net::compact_block_message, (block_message_hash)
+                                             (header)
+                                             (short_transaction_ids) )
+FC_REFLECT( graphene::net::fetch_block_transactions_message, (block_message_hash)
+                                                        (transaction_indexes) )
+FC_REFLECT( graphene::net::block_transactions_message, (block_message_hash)
+                                                  (transactions) )
+
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
 #include <fc/crypto/sha224.hpp>
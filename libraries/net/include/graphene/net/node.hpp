@@ -118,6 +118,21 @@ namespace graphene { namespace net {
           */
          virtual message get_item( const item_id& id ) = 0;
 
+         /**
+          *  Returns the packed bodies of up to count blocks of our chain, starting at first_block.
+          *  Stops at the first block we don't have, and returns nothing when first_block isn't
+          *  on our chain.
+          */
+         virtual std::vector< std::vector<char> > get_packed_blocks( const item_hash_t& first_block, uint32_t count ) = 0;
+
+         /**
+          *  Looks up the transactions of a compact block in our pending transactions.  The result has
+          *  one entry per short id, see compact_block_message::short_transaction_id(), left empty for
+          *  the transactions we don't have.
+          */
+         virtual std::vector< fc::optional< signed_transaction > > find_pending_transactions( const item_hash_t& block_message_hash,
+                                                                                             const std::vector< uint64_t >& short_transaction_ids ) = 0;
+
          /**
           * Returns a synopsis of the blockchain used for syncing.
           * This consists of a list of selected item hashes from our current preferred
@@ -289,6 +304,12 @@ namespace graphene { namespace net {
 
         void set_total_bandwidth_limit(uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second);
 
+        /**
+         * Replaces the threads that hash and unpack blocks and other large messages.  With 0 threads they are
+         * decoded on the p2p thread.  Call it before connecting to the network
+         */
+        void set_message_decode_threads(uint32_t thread_count);
+
         fc::variant_object network_get_info() const;
         fc::variant_object network_get_usage_stats() const;
 
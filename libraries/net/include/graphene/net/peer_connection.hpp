@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/net/node.hpp>
+#include <graphene/net/compact_block.hpp>
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
@@ -208,6 +209,7 @@ namespace graphene { namespace net
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
       fc::optional<voilk::protocol::chain_id_type> chain_id;
+      bool supports_compact_blocks = false; /// the peer announced "compact_blocks" in its hello user data
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -229,11 +231,22 @@ namespace graphene { namespace net
       fc::optional<boost::tuple<std::vector<item_hash_t>, fc::time_point> > item_ids_requested_from_peer; /// we check this to detect a timed-out request and in busy()
       fc::time_point last_sync_item_received_time; /// the time we received the last sync item or the time we sent the last batch of sync item requests to this peer
       std::set<item_hash_t> sync_items_requested_from_peer; /// ids of blocks we've requested from this peer during sync.  fetch from another peer if this peer disconnects
+      std::map<item_hash_t, std::vector<item_hash_t> > sync_block_batches_requested; /// runs of sync blocks requested with one fetch_block_batch_message, by their first block
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks = false;
       /// @}
 
+      /// sync throughput data, used to size and time the sync requests sent to this peer
+      /// @{
+      fc::time_point sync_rate_sample_start; /// the time we received the last sync block from this peer, or sent it a request while nothing was outstanding
+      fc::microseconds sync_block_interval; /// moving average of the time between two sync blocks delivered by this peer, zero until we received one
+      uint32_t sync_window = GRAPHENE_NET_INITIAL_SYNC_WINDOW; /// number of sync blocks this peer may have outstanding
+      uint64_t sync_blocks_received = 0;
+      uint64_t sync_bytes_received = 0;
+      uint32_t sync_items_rerequested = 0; /// sync blocks that were overdue from this peer and that we requested from another peer too
+      /// @}
+
       /// latency timing data
       std::unordered_map< item_hash_t, fc::time_point > pending_item_request_times;
       /// @}
@@ -259,6 +272,8 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      std::map<item_hash_t, compact_block_reconstruction> compact_blocks_being_reconstructed; /// by block message hash, the block stays in items_requested_from_peer meanwhile
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
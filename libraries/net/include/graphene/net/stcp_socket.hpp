@@ -50,6 +50,18 @@ class stcp_socket : public virtual fc::iostream
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
 
+    /**
+     *  Encrypts a whole frame in place and writes it with one call, without staging it through the
+     *  write buffer.  len must be a multiple of 16, frame holds the ciphertext afterwards.
+     */
+    void             write_frame( const std::shared_ptr<char>& frame, size_t len );
+
+    /**
+     *  Reads a whole frame straight into frame and decrypts it there, without staging it through the
+     *  read buffer.  len must be a multiple of 16.
+     */
+    void             read_frame( char* frame, size_t len );
+
     virtual void     flush();
     virtual void     close();
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <fc/time.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphene { namespace net {
+
+   /**
+    * Timing of the sync blocks a peer delivers, see node_impl::update_sync_throughput()
+    */
+   struct sync_peer_timing
+   {
+      fc::microseconds block_interval;      /// moving average of the time between two sync blocks, zero until measured
+      fc::microseconds round_trip_delay;
+   };
+
+   /**
+    * Adds the blocks that arrived elapsed after the previous sample to the moving average of the
+    * block interval.  The blocks of a batch arrive together, each took its share of the time.
+    */
+   fc::microseconds average_sync_block_interval( fc::microseconds average, fc::microseconds elapsed, uint32_t block_count );
+
+   /**
+    * The number of sync blocks a peer may have outstanding: enough to cover its round trip plus
+    * GRAPHENE_NET_SYNC_WINDOW_MILLISECONDS of blocks, between GRAPHENE_NET_MIN_SYNC_WINDOW and
+    * maximum_blocks.  GRAPHENE_NET_INITIAL_SYNC_WINDOW until the peer's rate is known.
+    */
+   uint32_t compute_sync_window( const sync_peer_timing& timing, uint32_t maximum_blocks );
+
+   /**
+    * How long a sync block may be outstanding from a peer with blocks_outstanding requests before
+    * it is requested from another peer.  unmeasured_timeout applies until the peer's rate is known.
+    */
+   fc::microseconds compute_sync_overdue_timeout( const sync_peer_timing& timing, size_t blocks_outstanding,
+                                                  fc::microseconds unmeasured_timeout );
+
+} } // graphene::net
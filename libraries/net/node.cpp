@@ -67,6 +67,7 @@
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
 #include <fc/io/enum_type.hpp>
+#include <fc/compress/zlib.hpp>
 #include <fc/crypto/rand.hpp>
 #include <fc/network/rate_limiting.hpp>
 #include <fc/network/ip.hpp>
@@ -77,6 +78,9 @@
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/peer_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/sync_window.hpp>
+#include <graphene/net/block_batch.hpp>
+#include <graphene/net/compact_block.hpp>
 #include <graphene/net/config.hpp>
 #include <graphene/net/exceptions.hpp>
 
@@ -246,6 +250,50 @@ namespace graphene { namespace net {
       }
     };
 
+    // the parts of a received message that cost the most cpu: its hash and, for blocks and transactions,
+    // unpacking it.  Computed by decode_message() on one of the message decode threads for large messages,
+    // so the p2p thread only spends its time on the protocol state
+    struct decoded_message
+    {
+      message_hash_type                             message_hash;
+      fc::optional<graphene::net::block_message>    block;
+      fc::optional<graphene::net::trx_message>      transaction;
+      fc::optional<block_batch_message>             batch;
+      std::vector<graphene::net::block_message>     batch_blocks;
+      fc::oexception                                batch_error; /// the batch arrived but its blocks couldn't be unpacked
+    };
+
+    decoded_message decode_message(const message& received_message)
+    {
+      decoded_message decoded;
+      decoded.message_hash = received_message.id();
+
+      switch (received_message.msg_type)
+      {
+      case core_message_type_enum::block_message_type:
+        decoded.block = received_message.as<graphene::net::block_message>();
+        break;
+      case core_message_type_enum::trx_message_type:
+        decoded.transaction = received_message.as<graphene::net::trx_message>();
+        break;
+      case core_message_type_enum::block_batch_message_type:
+        decoded.batch = received_message.as<block_batch_message>();
+        try
+        {
+          decoded.batch_blocks = unpack_block_batch(*decoded.batch);
+        }
+        catch (const fc::exception& e)
+        {
+          decoded.batch_error = e;
+        }
+        break;
+      default:
+        break;
+      }
+
+      return decoded;
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
     class statistics_gathering_node_delegate_wrapper : public node_delegate
     {
@@ -264,6 +312,8 @@ namespace graphene { namespace net {
                                    (handle_transaction) \
                                    (get_block_ids) \
                                    (get_item) \
+                                   (get_packed_blocks) \
+                                   (find_pending_transactions) \
                                    (get_blockchain_synopsis) \
                                    (sync_status) \
                                    (connection_count_changed) \
@@ -362,6 +412,9 @@ namespace graphene { namespace net {
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
       message get_item( const item_id& id ) override;
+      std::vector< std::vector<char> > get_packed_blocks( const item_hash_t& first_block, uint32_t count ) override;
+      std::vector< fc::optional< signed_transaction > > find_pending_transactions( const item_hash_t& block_message_hash,
+                                                                                  const std::vector< uint64_t >& short_transaction_ids ) override;
       std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point,
                                                        uint32_t number_of_blocks_after_reference_point) override;
       void     sync_status( uint32_t item_type, uint32_t item_count ) override;
@@ -419,6 +472,7 @@ namespace graphene { namespace net {
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
+      std::unordered_set<item_hash_t>       _rerequested_sync_items; /// overdue sync blocks we've asked a second peer for, the copy that arrives last is dropped
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
       std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
       // @}
@@ -490,6 +544,7 @@ namespace graphene { namespace net {
       std::vector<uint32_t> _hard_fork_block_numbers; /// list of all block numbers where there are hard forks
 
       blockchain_tied_message_cache _message_cache; /// cache message we have received and might be required to provide to other peers via inventory requests
+      std::deque<compact_block_message> _recent_compact_blocks; /// the compact forms of the last blocks peers asked for, most recent first
 
       fc::rate_limiting_group _rate_limiter;
 
@@ -538,6 +593,9 @@ namespace graphene { namespace net {
       std::atomic_int        _activeCalls;
       fc::promise<void>::ptr _shutdownNotifier;
 
+      std::vector<std::unique_ptr<fc::thread> > _message_decode_threads;
+      uint32_t _next_message_decode_thread = 0;
+
       node_impl(const std::string& user_agent);
       virtual ~node_impl();
 
@@ -550,6 +608,7 @@ namespace graphene { namespace net {
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
       void fetch_sync_items_loop();
+      void update_sync_throughput( peer_connection* peer, size_t message_size, uint32_t block_count = 1 );
       void trigger_fetch_sync_items_loop();
 
       bool is_item_in_any_peers_inventory(const item_id& item) const;
@@ -581,6 +640,7 @@ namespace graphene { namespace net {
       fc::variant_object generate_hello_user_data();
       void parse_hello_user_data_for_peer( peer_connection* originating_peer, const fc::variant_object& user_data );
 
+      bool is_expected_block_message( peer_connection* originating_peer, const message& received_message );
       void on_message( peer_connection* originating_peer,
                        const message& received_message ) override;
 
@@ -611,6 +671,29 @@ namespace graphene { namespace net {
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
+      void on_fetch_block_batch_message( peer_connection* originating_peer,
+                                         const fetch_block_batch_message& fetch_block_batch_message_received );
+
+      void on_block_batch_message( peer_connection* originating_peer,
+                                   const decoded_message& decoded_batch );
+
+      void release_sync_items( peer_connection* originating_peer, const std::vector<item_hash_t>& items );
+
+      void on_fetch_compact_block_message( peer_connection* originating_peer,
+                                           const fetch_compact_block_message& fetch_compact_block_message_received );
+
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+
+      void on_fetch_block_transactions_message( peer_connection* originating_peer,
+                                                const fetch_block_transactions_message& fetch_block_transactions_message_received );
+
+      void on_block_transactions_message( peer_connection* originating_peer,
+                                          const block_transactions_message& block_transactions_message_received );
+
+      fc::optional<graphene::net::block_message> get_block_for_compact_relay( const item_hash_t& block_message_hash );
+      void process_reconstructed_compact_block( peer_connection* originating_peer, const item_hash_t& block_message_hash, const signed_block& block );
+
       void on_item_ids_inventory_message( peer_connection* originating_peer,
                                           const item_ids_inventory_message& item_ids_inventory_message_received );
 
@@ -643,10 +726,12 @@ namespace graphene { namespace net {
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
       void process_block_during_sync(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
+      void process_requested_sync_block(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
+      void fetch_more_sync_items_if_ready(peer_connection* originating_peer);
       void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
-      void process_block_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
+      void process_block_message(peer_connection* originating_peer, const graphene::net::block_message& block_message_to_process, size_t message_size, const message_hash_type& message_hash);
 
-      void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
+      void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const decoded_message& decoded);
 
       void start_synchronizing();
       void start_synchronizing_with_peer(const peer_connection_ptr& peer);
@@ -708,6 +793,7 @@ namespace graphene { namespace net {
       void                       set_allowed_peers( const std::vector<node_id_t>& allowed_peers );
       void                       clear_peer_database();
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
+      void                       set_message_decode_threads( uint32_t thread_count );
       fc::variant_object         get_call_statistics() const;
       message                    get_message_for_item(const item_id& item) override;
 
@@ -833,6 +919,8 @@ namespace graphene { namespace net {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
 
+      set_message_decode_threads(GRAPHENE_NET_MESSAGE_DECODE_THREADS);
+
       _shutdownNotifier.reset(new fc::promise<void>("Node shutdown notifier"));
     }
 
@@ -1021,7 +1109,9 @@ namespace graphene { namespace net {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting item ${item_hash} from peer ${endpoint}", ("item_hash", item_to_request )("endpoint", peer->get_remote_endpoint() ) );
       item_id item_id_to_request( graphene::net::block_message_type, item_to_request );
-      _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+      if (peer->sync_items_requested_from_peer.empty())
+        peer->sync_rate_sample_start = fc::time_point::now();
+      _active_sync_requests[item_to_request] = fc::time_point::now();
       peer->last_sync_item_received_time = fc::time_point::now();
       peer->sync_items_requested_from_peer.insert(item_to_request);
       peer->send_message( fetch_items_message(item_id_to_request.item_type, std::vector<item_hash_t>{item_id_to_request.item_hash} ) );
@@ -1032,13 +1122,36 @@ namespace graphene { namespace net {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      // the time between this request and the first block is part of the peer's delivery rate
+      if (peer->sync_items_requested_from_peer.empty())
+        peer->sync_rate_sample_start = fc::time_point::now();
       for (const item_hash_t& item_to_request : items_to_request)
       {
-        _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+        // an overdue item requested again gets a new request time, so it is not overdue from the second peer right away
+        _active_sync_requests[item_to_request] = fc::time_point::now();
         peer->last_sync_item_received_time = fc::time_point::now();
         peer->sync_items_requested_from_peer.insert(item_to_request);
       }
-      peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
+
+      if (peer->core_protocol_version < GRAPHENE_NET_BLOCK_BATCH_PROTOCOL_VERSION)
+      {
+        peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
+        return;
+      }
+
+      // ask for each run of consecutive blocks with one fetch_block_batch_message, the peer sends them back in
+      // a single message straight from its block log.  The odd single block still goes in a fetch_items_message
+      block_batch_requests requests = split_block_batch_requests(items_to_request, GRAPHENE_NET_MAX_BLOCKS_PER_BATCH);
+      for (std::vector<item_hash_t>& batch : requests.batches)
+      {
+        item_hash_t first_block = batch.front();
+        uint32_t count = uint32_t(batch.size());
+        peer->sync_block_batches_requested[first_block] = std::move(batch);
+        peer->send_message(fetch_block_batch_message(first_block, count, block_batch_compression::zlib));
+      }
+
+      if (!requests.single_items.empty())
+        peer->send_message(fetch_items_message(graphene::net::block_message_type, requests.single_items));
     }
 
     void node_impl::fetch_sync_items_loop()
@@ -1056,31 +1169,101 @@ namespace graphene { namespace net {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            // the peers we're syncing with that can take more sync requests, fastest first so the blocks
+            // we need soonest come from the peers that deliver them soonest.  Peers we haven't measured yet go last
+            std::vector<peer_connection_ptr> sync_peers;
             for( const peer_connection_ptr& peer : _active_connections )
-            {
               if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+                  !peer->inhibit_fetching_sync_blocks &&
+                  peer->items_requested_from_peer.empty() &&
+                  !peer->item_ids_requested_from_peer &&
+                  peer->sync_items_requested_from_peer.size() < peer->sync_window )
+                sync_peers.push_back( peer );
+            std::stable_sort( sync_peers.begin(), sync_peers.end(),
+                              []( const peer_connection_ptr& a, const peer_connection_ptr& b ) {
+                                if( a->sync_block_interval.count() == 0 || b->sync_block_interval.count() == 0 )
+                                  return b->sync_block_interval.count() == 0 && a->sync_block_interval.count() != 0;
+                                return a->sync_block_interval < b->sync_block_interval;
+                              } );
+
+            auto free_window = [&]( const peer_connection_ptr& peer ) -> size_t {
+              size_t used = peer->sync_items_requested_from_peer.size();
+              auto scheduled = sync_item_requests_to_send.find( peer );
+              if( scheduled != sync_item_requests_to_send.end() )
+                used += scheduled->second.size();
+              return used < peer->sync_window ? peer->sync_window - used : 0;
+            };
+
+            // the ids each sync peer has for us, as a set so checking them for every overdue item stays cheap.
+            // Built the first time a peer is considered for an overdue item
+            std::map<peer_connection_ptr, std::set<item_hash_t> > ids_to_get_by_peer;
+            auto peer_has_item = [&]( const peer_connection_ptr& peer, const item_hash_t& item ) {
+              auto ids_iter = ids_to_get_by_peer.find( peer );
+              if( ids_iter == ids_to_get_by_peer.end() )
+                ids_iter = ids_to_get_by_peer.emplace( peer, std::set<item_hash_t>( peer->ids_of_items_to_get.begin(),
+                                                                                     peer->ids_of_items_to_get.end() ) ).first;
+              return ids_iter->second.find( item ) != ids_iter->second.end();
+            };
+
+            // ask a faster peer for blocks that are overdue from the peer we asked first, each block only once.
+            // The first peer may still deliver it, so it stays in that peer's list
+            fc::time_point now = fc::time_point::now();
+            for( const peer_connection_ptr& slow_peer : _active_connections )
+            {
+              if( slow_peer->sync_items_requested_from_peer.empty() )
+                continue;
+
+              fc::time_point overdue_threshold = now - compute_sync_overdue_timeout(
+                  sync_peer_timing{ slow_peer->sync_block_interval, slow_peer->round_trip_delay },
+                  slow_peer->sync_items_requested_from_peer.size(),
+                  fc::microseconds( _node_configuration.active_ignored_request_timeout_microseconds / 2 ) );
+              for( const item_hash_t& item : slow_peer->sync_items_requested_from_peer )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                auto request_iter = _active_sync_requests.find( item );
+                if( request_iter == _active_sync_requests.end() ||
+                    request_iter->second > overdue_threshold ||
+                    _rerequested_sync_items.find( item ) != _rerequested_sync_items.end() ||
+                    sync_items_to_request.find( item ) != sync_items_to_request.end() ||
+                    have_already_received_sync_item( item ) )
+                  continue;
+
+                for( const peer_connection_ptr& peer : sync_peers )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _node_configuration.maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
+                  if( peer == slow_peer ||
+                      free_window( peer ) == 0 ||
+                      peer->sync_items_requested_from_peer.find( item ) != peer->sync_items_requested_from_peer.end() ||
+                      !peer_has_item( peer, item ) )
+                    continue;
+
+                  fc_dlog( fc::logger::get("sync"), "sync block ${item} is overdue from ${slow_peer}, also requesting it from ${peer}",
+                           ("item", item)("slow_peer", slow_peer->get_remote_endpoint())("peer", peer->get_remote_endpoint()) );
+                  sync_item_requests_to_send[peer].push_back( item );
+                  sync_items_to_request.insert( item );
+                  _rerequested_sync_items.insert( item );
+                  ++slow_peer->sync_items_rerequested;
+                  break;
+                }
+              }
+            }
+
+            // then top up the window of each peer once half of it has arrived
+            for( const peer_connection_ptr& peer : sync_peers )
+            {
+              if( peer->sync_items_requested_from_peer.size() > peer->sync_window / 2 )
+                continue;
+
+              // loop through the items it has that we don't yet have on our blockchain
+              for( unsigned i = 0; i < peer->ids_of_items_to_get.size() && free_window( peer ) > 0; ++i )
+              {
+                item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
+                // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                    sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                    _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
+                {
+                  // then schedule a request from this peer
+                  sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
+                  sync_items_to_request.insert( item_to_potentially_request );
                 }
               }
             }
@@ -1098,12 +1281,42 @@ namespace graphene { namespace net {
         {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise = fc::promise<void>::ptr( new fc::promise<void>("graphene::net::retrigger_fetch_sync_items_loop") );
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          if( _active_sync_requests.empty() )
+          {
+            _rerequested_sync_items.clear();
+            _retrigger_fetch_sync_items_loop_promise->wait();
+          }
+          else
+          {
+            // wake up regularly while sync requests are outstanding to notice the ones that became overdue
+            try
+            {
+              _retrigger_fetch_sync_items_loop_promise->wait( fc::seconds(1) );
+            }
+            catch( const fc::timeout_exception& )
+            {
+            }
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
     }
 
+    void node_impl::update_sync_throughput( peer_connection* peer, size_t message_size, uint32_t block_count /* = 1 */ )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      peer->sync_blocks_received += block_count;
+      peer->sync_bytes_received += message_size;
+
+      if( peer->sync_rate_sample_start != fc::time_point() )
+        peer->sync_block_interval = average_sync_block_interval( peer->sync_block_interval, now - peer->sync_rate_sample_start, block_count );
+
+      peer->sync_rate_sample_start = now;
+      peer->sync_window = compute_sync_window( sync_peer_timing{ peer->sync_block_interval, peer->round_trip_delay },
+                                               _node_configuration.maximum_blocks_per_peer_during_syncing );
+    }
+
     void node_impl::trigger_fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1223,8 +1436,13 @@ namespace graphene { namespace net {
                         ("endpoint", peer_and_items.peer->get_remote_endpoint())("id", id));
               }
 
-            peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
-                                                                  items_by_type.second));
+            // peers that understand compact blocks send new blocks as a header and short transaction ids
+            if (items_by_type.first == core_message_type_enum::block_message_type && peer_and_items.peer->supports_compact_blocks)
+              for (const item_hash_t& id : items_by_type.second)
+                peer_and_items.peer->send_message(fetch_compact_block_message(id));
+            else
+              peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
+                                                                    items_by_type.second));
           }
         }
         items_by_peer.clear();
@@ -1781,13 +1999,88 @@ namespace graphene { namespace net {
       }
     }
 
+    bool node_impl::is_expected_block_message(peer_connection* originating_peer, const message& received_message)
+    {
+      VERIFY_CORRECT_THREAD();
+      try
+      {
+        if (received_message.msg_type == core_message_type_enum::block_batch_message_type)
+        {
+          // first_block leads the message
+          block_id_type first_block;
+          fc::datastream<const char*> ds(received_message.data.data(), received_message.data.size());
+          fc::raw::unpack(ds, first_block);
+          return originating_peer->sync_block_batches_requested.find(first_block) != originating_peer->sync_block_batches_requested.end();
+        }
+
+        if (received_message.msg_type == core_message_type_enum::block_message_type)
+        {
+          // block_id ends the message.  Blocks requested during normal operation are known by their message
+          // hash, which costs as much as the decoding, so any outstanding block request lets the message through
+          FC_ASSERT(received_message.data.size() >= sizeof(block_id_type));
+          block_id_type block_id;
+          fc::datastream<const char*> ds(received_message.data.data() + received_message.data.size() - sizeof(block_id_type), sizeof(block_id_type));
+          fc::raw::unpack(ds, block_id);
+          if (originating_peer->sync_items_requested_from_peer.find(block_id) != originating_peer->sync_items_requested_from_peer.end())
+            return true;
+          return std::any_of(originating_peer->items_requested_from_peer.begin(), originating_peer->items_requested_from_peer.end(),
+                             [](const peer_connection::item_to_time_map_type::value_type& requested_item) {
+                               return requested_item.first.item_type == graphene::net::block_message_type;
+                             });
+        }
+      }
+      catch (const fc::exception&)
+      {
+        return false;
+      }
+      return true;
+    }
+
     void node_impl::on_message( peer_connection* originating_peer, const message& received_message )
     {
       VERIFY_CORRECT_THREAD();
 
       activity_tracer aTracer(__FUNCTION__, *this);
 
-      message_hash_type message_hash = received_message.id();
+      // blocks and other large messages are hashed and unpacked on a decode thread.  This fiber waits for
+      // it, which keeps the messages of this peer in order while the p2p thread handles the other peers
+      decoded_message decoded;
+      if (!_message_decode_threads.empty() &&
+          (received_message.msg_type == core_message_type_enum::block_message_type ||
+           received_message.msg_type == core_message_type_enum::block_batch_message_type ||
+           received_message.size >= GRAPHENE_NET_MIN_MESSAGE_SIZE_TO_DECODE_IN_THREAD))
+      {
+        // don't spend a decode thread inflating and unpacking blocks we never asked for
+        if (!is_expected_block_message(originating_peer, received_message))
+        {
+          wlog("received a block message I didn't ask for from peer ${endpoint}, disconnecting from peer",
+               ("endpoint", originating_peer->get_remote_endpoint()));
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a block that I didn't ask for"));
+          disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
+          return;
+        }
+
+        fc::thread* decode_thread = _message_decode_threads[_next_message_decode_thread++ % _message_decode_threads.size()].get();
+        // copied, the decode thread could still be reading it when this fiber is canceled
+        message message_to_decode(received_message);
+        peer_connection_ptr originating_peer_ptr = originating_peer->shared_from_this();
+        decoded = decode_thread->async([message_to_decode](){ return decode_message(message_to_decode); }, "decode_message").wait();
+
+        // other fibers ran while we waited, the peer may have been disconnected in the meantime
+        if (originating_peer->we_have_requested_close ||
+            (_active_connections.find(originating_peer_ptr) == _active_connections.end() &&
+             _handshaking_connections.find(originating_peer_ptr) == _handshaking_connections.end()))
+        {
+          dlog("dropping message ${type} from peer ${endpoint}, the connection was closed while it was decoded",
+               ("type", graphene::net::core_message_type_enum(received_message.msg_type))
+               ("endpoint", originating_peer->get_remote_endpoint()));
+          return;
+        }
+      }
+      else
+        decoded = decode_message(received_message);
+
+      const message_hash_type& message_hash = decoded.message_hash;
       send_message_timing_to_statsd( originating_peer, received_message, message_hash );
       dlog("handling message ${type} ${hash} size ${size} from peer ${endpoint}",
            ("type", graphene::net::core_message_type_enum(received_message.msg_type))("hash", message_hash)
@@ -1829,7 +2122,7 @@ namespace graphene { namespace net {
         on_closing_connection_message(originating_peer, received_message.as<closing_connection_message>());
         break;
       case core_message_type_enum::block_message_type:
-        process_block_message(originating_peer, received_message, message_hash);
+        process_block_message(originating_peer, *decoded.block, received_message.size, message_hash);
         break;
       case core_message_type_enum::current_time_request_message_type:
         on_current_time_request_message(originating_peer, received_message.as<current_time_request_message>());
@@ -1849,13 +2142,31 @@ namespace graphene { namespace net {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::fetch_block_batch_message_type:
+        on_fetch_block_batch_message(originating_peer, received_message.as<fetch_block_batch_message>());
+        break;
+      case core_message_type_enum::block_batch_message_type:
+        on_block_batch_message(originating_peer, decoded);
+        break;
+      case core_message_type_enum::fetch_compact_block_message_type:
+        on_fetch_compact_block_message(originating_peer, received_message.as<fetch_compact_block_message>());
+        break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_block_transactions_message_type:
+        on_fetch_block_transactions_message(originating_peer, received_message.as<fetch_block_transactions_message>());
+        break;
+      case core_message_type_enum::block_transactions_message_type:
+        on_block_transactions_message(originating_peer, received_message.as<block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
         // to allow us to add messages in the future
         if (received_message.msg_type < core_message_type_enum::core_message_type_first ||
             received_message.msg_type > core_message_type_enum::core_message_type_last)
-          process_ordinary_message(originating_peer, received_message, message_hash);
+          process_ordinary_message(originating_peer, received_message, decoded);
         break;
       }
     }
@@ -1893,6 +2204,7 @@ namespace graphene { namespace net {
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
       user_data["chain_id"] = _delegate->get_chain_id();
+      user_data["compact_blocks"] = true;
 
       return user_data;
     }
@@ -1918,6 +2230,8 @@ namespace graphene { namespace net {
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
       if (user_data.contains("chain_id"))
         originating_peer->chain_id = user_data["chain_id"].as<voilk::protocol::chain_id_type>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as_bool();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2866,6 +3180,7 @@ namespace graphene { namespace net {
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
+        originating_peer->compact_blocks_being_reconstructed.erase( requested_item.item_hash );
         originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
         if (is_item_in_any_peers_inventory(requested_item))
           _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
@@ -2879,6 +3194,14 @@ namespace graphene { namespace net {
       {
         originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
 
+        // the peer refuses a whole batch by refusing its first block
+        auto batch_iter = originating_peer->sync_block_batches_requested.find(requested_item.item_hash);
+        if (batch_iter != originating_peer->sync_block_batches_requested.end())
+        {
+          release_sync_items(originating_peer, batch_iter->second);
+          originating_peer->sync_block_batches_requested.erase(batch_iter);
+        }
+
         if (originating_peer->peer_needs_sync_items_from_us)
           originating_peer->inhibit_fetching_sync_blocks = true;
         else
@@ -2893,6 +3216,329 @@ namespace graphene { namespace net {
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
+    void node_impl::on_fetch_block_batch_message(peer_connection* originating_peer, const fetch_block_batch_message& fetch_block_batch_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& first_block = fetch_block_batch_message_received.first_block;
+      uint32_t count = std::min<uint32_t>(fetch_block_batch_message_received.count, GRAPHENE_NET_MAX_BLOCKS_PER_BATCH);
+      dlog("received request for a batch of ${count} blocks starting at ${first_block} from peer ${endpoint}",
+           ("count", fetch_block_batch_message_received.count)("first_block", first_block)
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      std::vector< std::vector<char> > packed_blocks;
+      try
+      {
+        packed_blocks = _delegate->get_packed_blocks(first_block, count);
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("unable to read the blocks starting at ${first_block} requested by peer ${endpoint}: ${e}",
+             ("first_block", first_block)("endpoint", originating_peer->get_remote_endpoint())("e", e));
+        packed_blocks.clear();
+      }
+
+      block_batch_message reply;
+      reply.first_block = first_block;
+      for (const std::vector<char>& packed_block : packed_blocks)
+      {
+        // whatever doesn't fit will be requested again, but a batch always carries at least one block
+        if (reply.count > 0 && reply.data.size() + packed_block.size() > GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES)
+          break;
+        reply.data.insert(reply.data.end(), packed_block.begin(), packed_block.end());
+        ++reply.count;
+      }
+
+      if (reply.count == 0)
+      {
+        dlog("we don't have block ${first_block} on our chain, telling peer ${endpoint}",
+             ("first_block", first_block)("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(item_not_available_message(item_id(block_message_type, first_block)));
+        return;
+      }
+
+      if (fetch_block_batch_message_received.compression == block_batch_compression::zlib &&
+          reply.data.size() <= GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES)
+      {
+        std::string compressed = fc::zlib_compress(std::string(reply.data.begin(), reply.data.end()));
+        if (compressed.size() < reply.data.size())
+        {
+          reply.data.assign(compressed.begin(), compressed.end());
+          reply.compression = block_batch_compression::zlib;
+        }
+      }
+
+      // update our record of the last block they've seen, like on_fetch_items_message does
+      voilk::protocol::signed_block_header last_block_header = fc::raw::unpack_from_vector<voilk::protocol::signed_block_header>(packed_blocks[reply.count - 1]);
+      originating_peer->last_block_delegate_has_seen = last_block_header.id();
+      originating_peer->last_block_time_delegate_has_seen = last_block_header.timestamp;
+
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_batch_message(peer_connection* originating_peer, const decoded_message& decoded_batch)
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_batch_message& block_batch_message_received = *decoded_batch.batch;
+      auto batch_iter = originating_peer->sync_block_batches_requested.find(block_batch_message_received.first_block);
+      if (batch_iter == originating_peer->sync_block_batches_requested.end())
+      {
+        wlog("received a block batch starting at ${first_block} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("first_block", block_batch_message_received.first_block)("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a block batch that I didn't ask for, first_block: ${first_block}",
+                                                    ("first_block", block_batch_message_received.first_block)));
+        disconnect_from_peer(originating_peer, "You sent me a block batch that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      std::vector<item_hash_t> requested_blocks = std::move(batch_iter->second);
+      originating_peer->sync_block_batches_requested.erase(batch_iter);
+
+      // the blocks were unpacked by decode_message()
+      const std::vector<graphene::net::block_message>& blocks = decoded_batch.batch_blocks;
+      fc::oexception batch_error = decoded_batch.batch_error;
+      size_t requested_blocks_received = 0;
+      if (!batch_error)
+      {
+        try
+        {
+          requested_blocks_received = count_requested_batch_blocks(blocks, requested_blocks);
+        }
+        catch (const fc::exception& e)
+        {
+          batch_error = e;
+        }
+      }
+      if (batch_error)
+      {
+        wlog("received an invalid block batch from peer ${endpoint}, disconnecting from peer: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("e", *batch_error));
+        release_sync_items(originating_peer, requested_blocks);
+        disconnect_from_peer(originating_peer, "You sent me an invalid block batch", true, *batch_error);
+        return;
+      }
+
+      uint32_t blocks_delivered = 0;
+      try
+      {
+        // the blocks after those are from another fork the peer switched to since it told us about them,
+        // they will be requested again
+        while (blocks_delivered < requested_blocks_received)
+        {
+          const graphene::net::block_message& block_message_to_process = blocks[blocks_delivered];
+          originating_peer->sync_items_requested_from_peer.erase(block_message_to_process.block_id);
+          // the blocks are never looked up by message hash while syncing
+          process_requested_sync_block(originating_peer, block_message_to_process, message_hash_type());
+          ++blocks_delivered;
+        }
+
+        update_sync_throughput(originating_peer, block_batch_message_received.data.size(), blocks_delivered);
+
+        if (blocks_delivered < requested_blocks.size())
+        {
+          dlog("peer ${endpoint} sent ${delivered} of the ${requested} blocks of the batch starting at ${first_block}",
+               ("endpoint", originating_peer->get_remote_endpoint())("delivered", blocks_delivered)
+               ("requested", requested_blocks.size())("first_block", block_batch_message_received.first_block));
+          release_sync_items(originating_peer, std::vector<item_hash_t>(requested_blocks.begin() + blocks_delivered, requested_blocks.end()));
+          trigger_fetch_sync_items_loop();
+        }
+
+        fetch_more_sync_items_if_ready(originating_peer);
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        elog("Caught unexpected exception: ${e}", ("e", e));
+        assert(false && "exceptions not expected here");
+      }
+      catch (const std::exception& e)
+      {
+        elog("Caught unexpected exception: ${e}", ("e", e.what()));
+        assert(false && "exceptions not expected here");
+      }
+    }
+
+    fc::optional<graphene::net::block_message> node_impl::get_block_for_compact_relay(const item_hash_t& block_message_hash)
+    {
+      // new blocks are served from the message cache, see on_fetch_items_message
+      try
+      {
+        message block_message_to_send = get_message_for_item(item_id(block_message_type, block_message_hash));
+        if (block_message_to_send.msg_type == block_message_type)
+          return block_message_to_send.as<graphene::net::block_message>();
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception&)
+      {
+      }
+      return fc::optional<graphene::net::block_message>();
+    }
+
+    void node_impl::on_fetch_compact_block_message(peer_connection* originating_peer, const fetch_compact_block_message& fetch_compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = fetch_compact_block_message_received.block_message_hash;
+      dlog("received compact block request for ${hash} from peer ${endpoint}",
+           ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+
+      // a new block is asked for by most of our peers at once, its transaction ids are only hashed for the first one
+      auto compact_block_iter = std::find_if(_recent_compact_blocks.begin(), _recent_compact_blocks.end(),
+                                             [&](const compact_block_message& compact_block) { return compact_block.block_message_hash == block_message_hash; });
+      if (compact_block_iter == _recent_compact_blocks.end())
+      {
+        fc::optional<graphene::net::block_message> requested_block = get_block_for_compact_relay(block_message_hash);
+        if (!requested_block)
+        {
+          originating_peer->send_message(item_not_available_message(item_id(block_message_type, block_message_hash)));
+          return;
+        }
+
+        _recent_compact_blocks.push_front(make_compact_block(block_message_hash, requested_block->block));
+        if (_recent_compact_blocks.size() > GRAPHENE_NET_RECENT_COMPACT_BLOCKS)
+          _recent_compact_blocks.pop_back();
+        compact_block_iter = _recent_compact_blocks.begin();
+      }
+
+      originating_peer->last_block_delegate_has_seen = compact_block_iter->header.id();
+      originating_peer->last_block_time_delegate_has_seen = compact_block_iter->header.timestamp;
+
+      originating_peer->send_message(*compact_block_iter);
+    }
+
+    void node_impl::on_compact_block_message(peer_connection* originating_peer, const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = compact_block_message_received.block_message_hash;
+      if (originating_peer->items_requested_from_peer.find(item_id(block_message_type, block_message_hash)) == originating_peer->items_requested_from_peer.end() ||
+          originating_peer->compact_blocks_being_reconstructed.find(block_message_hash) != originating_peer->compact_blocks_being_reconstructed.end())
+      {
+        wlog("received a compact block ${hash} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, message_id: ${hash}",
+                                                    ("hash", block_message_hash)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      const std::vector<uint64_t>& short_transaction_ids = compact_block_message_received.short_transaction_ids;
+      std::vector< fc::optional<signed_transaction> > pending_transactions;
+      try
+      {
+        pending_transactions = _delegate->find_pending_transactions(block_message_hash, short_transaction_ids);
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("unable to look up the transactions of compact block ${hash}: ${e}", ("hash", block_message_hash)("e", e));
+      }
+
+      compact_block_reconstruction reconstruction = start_compact_block_reconstruction(compact_block_message_received, std::move(pending_transactions));
+
+      if (reconstruction.missing_transaction_indexes.empty())
+      {
+        process_reconstructed_compact_block(originating_peer, block_message_hash, reconstruction.block);
+        return;
+      }
+
+      dlog("missing ${count} of the ${total} transactions of compact block ${hash}, requesting them from peer ${endpoint}",
+           ("count", reconstruction.missing_transaction_indexes.size())("total", short_transaction_ids.size())
+           ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(fetch_block_transactions_message(block_message_hash, reconstruction.missing_transaction_indexes));
+      originating_peer->compact_blocks_being_reconstructed[block_message_hash] = std::move(reconstruction);
+    }
+
+    void node_impl::on_fetch_block_transactions_message(peer_connection* originating_peer, const fetch_block_transactions_message& fetch_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = fetch_block_transactions_message_received.block_message_hash;
+
+      fc::optional<graphene::net::block_message> requested_block = get_block_for_compact_relay(block_message_hash);
+      if (!requested_block)
+      {
+        originating_peer->send_message(item_not_available_message(item_id(block_message_type, block_message_hash)));
+        return;
+      }
+
+      block_transactions_message reply;
+      reply.block_message_hash = block_message_hash;
+      reply.transactions.reserve(fetch_block_transactions_message_received.transaction_indexes.size());
+      for (uint32_t index : fetch_block_transactions_message_received.transaction_indexes)
+      {
+        if (index >= requested_block->block.transactions.size())
+        {
+          wlog("peer ${endpoint} requested transaction ${index} of block ${hash} which only has ${count}, disconnecting from peer",
+               ("endpoint", originating_peer->get_remote_endpoint())("index", index)("hash", block_message_hash)
+               ("count", requested_block->block.transactions.size()));
+          fc::exception detailed_error(FC_LOG_MESSAGE(error, "You requested a transaction the block doesn't have, message_id: ${hash}, index: ${index}",
+                                                      ("hash", block_message_hash)("index", index)));
+          disconnect_from_peer(originating_peer, "You requested a transaction the block doesn't have", true, detailed_error);
+          return;
+        }
+        reply.transactions.push_back(requested_block->block.transactions[index]);
+      }
+
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_transactions_message(peer_connection* originating_peer, const block_transactions_message& block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = block_transactions_message_received.block_message_hash;
+      auto reconstruction_iter = originating_peer->compact_blocks_being_reconstructed.find(block_message_hash);
+      if (reconstruction_iter == originating_peer->compact_blocks_being_reconstructed.end() ||
+          reconstruction_iter->second.missing_transaction_indexes.size() != block_transactions_message_received.transactions.size())
+      {
+        wlog("received transactions of block ${hash} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me block transactions that I didn't ask for, message_id: ${hash}",
+                                                    ("hash", block_message_hash)));
+        disconnect_from_peer(originating_peer, "You sent me block transactions that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      signed_block block = complete_compact_block_reconstruction(std::move(reconstruction_iter->second), block_transactions_message_received.transactions);
+      originating_peer->compact_blocks_being_reconstructed.erase(reconstruction_iter);
+
+      process_reconstructed_compact_block(originating_peer, block_message_hash, block);
+    }
+
+    void node_impl::process_reconstructed_compact_block(peer_connection* originating_peer, const item_hash_t& block_message_hash, const signed_block& block)
+    {
+      graphene::net::block_message block_message_to_process(block);
+      if (!is_advertised_compact_block(block_message_to_process, block_message_hash))
+      {
+        dlog("compact block ${hash} from peer ${endpoint} didn't rebuild to the block advertised, requesting the full block",
+             ("hash", block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(fetch_items_message(block_message_type, std::vector<item_hash_t>{block_message_hash}));
+        return;
+      }
+
+      originating_peer->items_requested_from_peer.erase(item_id(block_message_type, block_message_hash));
+      process_block_during_normal_operation(originating_peer, block_message_to_process, block_message_hash);
+      if (originating_peer->idle())
+        trigger_fetch_items_loop();
+    }
+
+    void node_impl::release_sync_items(peer_connection* originating_peer, const std::vector<item_hash_t>& items)
+    {
+      // forget the requests so the fetch loop asks a peer for these blocks again
+      for (const item_hash_t& item : items)
+        if (originating_peer->sync_items_requested_from_peer.erase(item))
+          _active_sync_requests.erase(item);
+    }
+
     void node_impl::on_item_ids_inventory_message(peer_connection* originating_peer, const item_ids_inventory_message& item_ids_inventory_message_received)
     {
       VERIFY_CORRECT_THREAD();
@@ -3601,8 +4247,46 @@ namespace graphene { namespace net {
         disconnect_from_peer(peer.get(), disconnect_reason, true, *disconnect_exception);
       }
     }
+    void node_impl::process_requested_sync_block(peer_connection* originating_peer,
+                                                 const graphene::net::block_message& block_message_to_process,
+                                                 const message_hash_type& message_hash)
+    {
+      originating_peer->last_sync_item_received_time = fc::time_point::now();
+      _active_sync_requests.erase(block_message_to_process.block_id);
+
+      // an overdue block we asked two peers for is only processed once, whichever copy arrives first
+      auto rerequested_iter = _rerequested_sync_items.find(block_message_to_process.block_id);
+      if (rerequested_iter != _rerequested_sync_items.end() &&
+          (have_already_received_sync_item(block_message_to_process.block_id) ||
+           _delegate->has_item(item_id(graphene::net::block_message_type, block_message_to_process.block_id))))
+      {
+        dlog("dropping sync block ${id} from ${endpoint}, another peer already delivered it",
+             ("id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        _rerequested_sync_items.erase(rerequested_iter);
+      }
+      else
+        process_block_during_sync(originating_peer, block_message_to_process, message_hash);
+    }
+
+    void node_impl::fetch_more_sync_items_if_ready(peer_connection* originating_peer)
+    {
+      if (originating_peer->idle())
+      {
+        // we have finished fetching a batch of items, so we either need to grab another batch of items
+        // or we need to get another list of item ids.
+        if (originating_peer->number_of_unfetched_item_ids > 0 &&
+            originating_peer->ids_of_items_to_get.size() < GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH)
+          fetch_next_batch_of_item_ids_from_peer(originating_peer);
+        else
+          trigger_fetch_sync_items_loop();
+      }
+      else if (originating_peer->sync_items_requested_from_peer.size() <= originating_peer->sync_window / 2)
+        trigger_fetch_sync_items_loop(); // half of its window arrived, it has room for another request
+    }
+
     void node_impl::process_block_message(peer_connection* originating_peer,
-                                          const message& message_to_process,
+                                          const graphene::net::block_message& block_message_to_process,
+                                          size_t message_size,
                                           const message_hash_type& message_hash)
     {
       VERIFY_CORRECT_THREAD();
@@ -3611,7 +4295,6 @@ namespace graphene { namespace net {
       // (it's possible that we request an item during normal operation and then get kicked into sync
       // mode before we receive and process the item.  In that case, we should process the item as a normal
       // item to avoid confusing the sync code)
-      graphene::net::block_message block_message_to_process(message_to_process.as<graphene::net::block_message>());
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
@@ -3633,19 +4316,9 @@ namespace graphene { namespace net {
           // of the function so we can log if this ever happens.
           try
           {
-            originating_peer->last_sync_item_received_time = fc::time_point::now();
-            _active_sync_requests.erase(block_message_to_process.block_id);
-            process_block_during_sync(originating_peer, block_message_to_process, message_hash);
-            if (originating_peer->idle())
-            {
-              // we have finished fetching a batch of items, so we either need to grab another batch of items
-              // or we need to get another list of item ids.
-              if (originating_peer->number_of_unfetched_item_ids > 0 &&
-                  originating_peer->ids_of_items_to_get.size() < GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH)
-                fetch_next_batch_of_item_ids_from_peer(originating_peer);
-              else
-                trigger_fetch_sync_items_loop();
-            }
+            update_sync_throughput(originating_peer, message_size);
+            process_requested_sync_block(originating_peer, block_message_to_process, message_hash);
+            fetch_more_sync_items_if_ready(originating_peer);
             return;
           }
           catch (const fc::canceled_exception& e)
@@ -3947,9 +4620,10 @@ namespace graphene { namespace net {
     // this just passes the message to the client, and does the bookkeeping
     // related to requesting and rebroadcasting the message.
     void node_impl::process_ordinary_message( peer_connection* originating_peer,
-                                              const message& message_to_process, const message_hash_type& message_hash )
+                                              const message& message_to_process, const decoded_message& decoded )
     {
       VERIFY_CORRECT_THREAD();
+      const message_hash_type& message_hash = decoded.message_hash;
       fc::time_point message_receive_time = fc::time_point::now();
 
       // only process it if we asked for it
@@ -3975,7 +4649,7 @@ namespace graphene { namespace net {
         {
           if (message_to_process.msg_type == trx_message_type)
           {
-            trx_message transaction_message_to_process = message_to_process.as<trx_message>();
+            const trx_message& transaction_message_to_process = *decoded.transaction;
             dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
             _delegate->handle_transaction(transaction_message_to_process);
           }
@@ -4856,6 +5530,13 @@ namespace graphene { namespace net {
           ilog( "              above peer has ${count} sync items we might need", ("count", peer->ids_of_items_to_get.size() ) );
         if (peer->inhibit_fetching_sync_blocks)
           ilog( "              we are not fetching sync blocks from the above peer (inhibit_fetching_sync_blocks == true)" );
+        if( peer->sync_blocks_received )
+          ilog( "              sync: ${rate} blocks/s, ${outstanding} of a ${window} block window outstanding, round trip ${rtt} ms, "
+                "${blocks} blocks (${bytes} bytes) received, ${rerequested} overdue blocks requested from other peers",
+                ( "rate", peer->sync_block_interval.count() > 0 ? 1000000 / peer->sync_block_interval.count() : 0 )
+                ( "outstanding", peer->sync_items_requested_from_peer.size() )( "window", peer->sync_window )
+                ( "rtt", peer->round_trip_delay.count() / 1000 )( "blocks", peer->sync_blocks_received )
+                ( "bytes", peer->sync_bytes_received )( "rerequested", peer->sync_items_rerequested ) );
 
       }
       for( const peer_connection_ptr& peer : _handshaking_connections )
@@ -5029,6 +5710,11 @@ namespace graphene { namespace net {
         peer_details["current_head_block"] = peer->last_block_delegate_has_seen;
         peer_details["current_head_block_number"] = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details["current_head_block_time"] = peer->last_block_time_delegate_has_seen;
+        peer_details["sync_blocks_per_second"] = peer->sync_block_interval.count() > 0 ? 1000000 / peer->sync_block_interval.count() : 0;
+        peer_details["sync_window"] = peer->sync_window;
+        peer_details["sync_blocks_received"] = peer->sync_blocks_received;
+        peer_details["sync_bytes_received"] = peer->sync_bytes_received;
+        peer_details["sync_items_rerequested"] = peer->sync_items_rerequested;
 
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
@@ -5179,6 +5865,14 @@ namespace graphene { namespace net {
       _rate_limiter.set_download_limit( download_bytes_per_second );
     }
 
+    void node_impl::set_message_decode_threads( uint32_t thread_count )
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_decode_threads.clear();
+      for (uint32_t i = 0; i < thread_count; ++i)
+        _message_decode_threads.emplace_back(new fc::thread("p2p_decode_" + std::to_string(i)));
+    }
+
     fc::variant_object node_impl::get_call_statistics() const
     {
       VERIFY_CORRECT_THREAD();
@@ -5401,6 +6095,11 @@ namespace graphene { namespace net {
     INVOKE_IN_IMPL(set_total_bandwidth_limit, upload_bytes_per_second, download_bytes_per_second);
   }
 
+  void node::set_message_decode_threads(uint32_t thread_count)
+  {
+    INVOKE_IN_IMPL(set_message_decode_threads, thread_count);
+  }
+
   fc::variant_object node::get_call_statistics() const
   {
     INVOKE_IN_IMPL(get_call_statistics);
@@ -5628,6 +6327,17 @@ namespace graphene { namespace net {
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
+    std::vector< std::vector<char> > statistics_gathering_node_delegate_wrapper::get_packed_blocks( const item_hash_t& first_block, uint32_t count )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_packed_blocks, first_block, count);
+    }
+
+    std::vector< fc::optional< signed_transaction > > statistics_gathering_node_delegate_wrapper::find_pending_transactions( const item_hash_t& block_message_hash,
+                                                                                                                             const std::vector< uint64_t >& short_transaction_ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(find_pending_transactions, block_message_hash, short_transaction_ids);
+    }
+
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_blockchain_synopsis(const item_hash_t& reference_point, uint32_t number_of_blocks_after_reference_point)
     {
       INVOKE_AND_COLLECT_STATISTICS(get_blockchain_synopsis, reference_point, number_of_blocks_after_reference_point);
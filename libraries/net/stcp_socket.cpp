@@ -33,6 +33,7 @@
 #include <fc/exception/exception.hpp>
 
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/config.hpp>
 
 namespace graphene { namespace net {
 
@@ -100,7 +101,8 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
+    // large enough that a block arrives in a few reads, each decrypted with one EVP call
+    const size_t read_buffer_length = GRAPHENE_NET_STCP_BUFFER_SIZE;
     if (!_read_buffer)
       _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
 
@@ -141,17 +143,11 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
+    const std::size_t write_buffer_length = GRAPHENE_NET_STCP_BUFFER_SIZE;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
     len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
-    /**
-     * every sizeof(crypt_buf) bytes the aes channel
-     * has an error and doesn't decrypt properly...  disable
-     * for now because we are going to upgrade to something
-     * better.
-     */
+    // encode() fails with an exception or writes all len bytes, the buffer doesn't need clearing first
     uint32_t ciphertext_len = _send_aes.encode( buffer, len, _write_buffer.get() );
     assert(ciphertext_len == len);
     _sock.write( _write_buffer, ciphertext_len );
@@ -163,6 +159,24 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+void stcp_socket::write_frame( const std::shared_ptr<char>& frame, size_t len )
+{ try {
+    assert( len > 0 && (len % 16) == 0 );
+    // EVP encrypts in place when input and output are the same buffer, the frame goes to the socket as is
+    uint32_t ciphertext_len = _send_aes.encode( frame.get(), len, frame.get() );
+    assert(ciphertext_len == len);
+    _sock.write( std::shared_ptr<const char>( frame ), ciphertext_len );
+} FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
+
+void stcp_socket::read_frame( char* frame, size_t len )
+{ try {
+    assert( len > 0 && (len % 16) == 0 );
+    // the ciphertext lands where the caller wants the plaintext, EVP decrypts it there with one call
+    _sock.read( frame, len );
+    uint32_t plaintext_len = _recv_aes.decode( frame, len, frame );
+    assert(plaintext_len == len);
+} FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -0,0 +1,43 @@
+#include <graphene/net/sync_window.hpp>
+#include <graphene/net/config.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net {
+
+fc::microseconds average_sync_block_interval( fc::microseconds average, fc::microseconds elapsed, uint32_t block_count )
+{
+   if( block_count == 0 )
+      return average;
+
+   fc::microseconds interval( elapsed.count() / block_count );
+   if( average.count() == 0 )
+      return interval;
+   return fc::microseconds( ( average.count() * 7 + interval.count() ) / 8 );
+}
+
+uint32_t compute_sync_window( const sync_peer_timing& timing, uint32_t maximum_blocks )
+{
+   uint32_t maximum = std::max<uint32_t>( maximum_blocks, 1 );
+   if( timing.block_interval.count() <= 0 )
+      return std::min<uint32_t>( GRAPHENE_NET_INITIAL_SYNC_WINDOW, maximum );
+
+   int64_t covered = std::max<int64_t>( timing.round_trip_delay.count(), 0 ) + fc::milliseconds( GRAPHENE_NET_SYNC_WINDOW_MILLISECONDS ).count();
+   int64_t window = ( covered + timing.block_interval.count() - 1 ) / timing.block_interval.count();
+   return uint32_t( std::max<int64_t>( std::min<int64_t>( window, maximum ), std::min<uint32_t>( GRAPHENE_NET_MIN_SYNC_WINDOW, maximum ) ) );
+}
+
+fc::microseconds compute_sync_overdue_timeout( const sync_peer_timing& timing, size_t blocks_outstanding,
+                                               fc::microseconds unmeasured_timeout )
+{
+   if( timing.block_interval.count() <= 0 )
+      return unmeasured_timeout;
+
+   // the peer should deliver everything we asked it for within its round trip plus one interval per block
+   int64_t expected = std::max<int64_t>( timing.round_trip_delay.count(), 0 ) +
+                      timing.block_interval.count() * int64_t( blocks_outstanding );
+   return fc::microseconds( std::max<int64_t>( expected * GRAPHENE_NET_SYNC_OVERDUE_FACTOR,
+                                               fc::milliseconds( GRAPHENE_NET_MIN_SYNC_OVERDUE_MILLISECONDS ).count() ) );
+}
+
+} } // graphene::net
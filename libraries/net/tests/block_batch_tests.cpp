@@ -0,0 +1,156 @@
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/block_batch.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/bitutil.hpp>
+#include <fc/compress/zlib.hpp>
+
+using namespace graphene::net;
+
+namespace
+{
+   item_hash_t block_id_of_num( uint32_t block_num )
+   {
+      item_hash_t id;
+      id._hash[0] = fc::endian_reverse_u32( block_num );
+      return id;
+   }
+
+   // count blocks following block_num, each one linked to the one before
+   std::vector<signed_block> make_blocks( uint32_t block_num, uint32_t count )
+   {
+      std::vector<signed_block> blocks;
+      item_hash_t previous = block_id_of_num( block_num );
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         signed_block block;
+         block.previous = previous;
+         block.timestamp = fc::time_point_sec( 1000000 + 3 * i );
+         previous = block.id();
+         blocks.push_back( block );
+      }
+      return blocks;
+   }
+
+   block_batch_message pack_batch( const std::vector<signed_block>& blocks, uint32_t count )
+   {
+      block_batch_message batch;
+      batch.first_block = blocks.front().id();
+      batch.count = count;
+      for( const signed_block& block : blocks )
+      {
+         std::vector<char> packed = fc::raw::pack_to_vector( block );
+         batch.data.insert( batch.data.end(), packed.begin(), packed.end() );
+      }
+      return batch;
+   }
+
+   std::vector<item_hash_t> ids_of( const std::vector<signed_block>& blocks )
+   {
+      std::vector<item_hash_t> ids;
+      for( const signed_block& block : blocks )
+         ids.push_back( block.id() );
+      return ids;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE( block_batch_tests )
+
+BOOST_AUTO_TEST_CASE( request_splitting )
+{
+   std::vector<item_hash_t> items;
+   for( uint32_t block_num : { 5, 6, 7, 9, 20, 21, 22, 23, 22 } )
+      items.push_back( block_id_of_num( block_num ) );
+
+   // runs of consecutive blocks are cut at the batch size, blocks without a neighbour are requested alone,
+   // 9 has none and 23 is followed by an earlier block
+   block_batch_requests requests = split_block_batch_requests( items, 3 );
+   BOOST_REQUIRE_EQUAL( requests.batches.size(), 2u );
+   BOOST_CHECK( requests.batches[0] == std::vector<item_hash_t>( items.begin(), items.begin() + 3 ) );
+   BOOST_CHECK( requests.batches[1] == std::vector<item_hash_t>( items.begin() + 4, items.begin() + 7 ) );
+   BOOST_CHECK( requests.single_items == std::vector<item_hash_t>( { items[3], items[7], items[8] } ) );
+
+   // with room for it, 23 joins the run before it
+   requests = split_block_batch_requests( items, GRAPHENE_NET_MAX_BLOCKS_PER_BATCH );
+   BOOST_REQUIRE_EQUAL( requests.batches.size(), 2u );
+   BOOST_CHECK( requests.batches[1] == std::vector<item_hash_t>( items.begin() + 4, items.begin() + 8 ) );
+   BOOST_CHECK( requests.single_items == std::vector<item_hash_t>( { items[3], items[8] } ) );
+
+   // a batch size of one requests every block alone
+   requests = split_block_batch_requests( items, 1 );
+   BOOST_CHECK( requests.batches.empty() );
+   BOOST_CHECK( requests.single_items == items );
+
+   BOOST_CHECK( split_block_batch_requests( std::vector<item_hash_t>(), GRAPHENE_NET_MAX_BLOCKS_PER_BATCH ).batches.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( batch_unpacking )
+{
+   std::vector<signed_block> blocks = make_blocks( 9, 3 );
+
+   block_batch_message batch = pack_batch( blocks, 3 );
+   std::vector<block_message> unpacked = unpack_block_batch( batch );
+   BOOST_REQUIRE_EQUAL( unpacked.size(), 3u );
+   for( size_t i = 0; i < blocks.size(); ++i )
+   {
+      BOOST_CHECK( unpacked[i].block_id == blocks[i].id() );
+      BOOST_CHECK_EQUAL( unpacked[i].block.block_num(), 10 + i );
+   }
+
+   std::string compressed = fc::zlib_compress( std::string( batch.data.begin(), batch.data.end() ) );
+   batch.data.assign( compressed.begin(), compressed.end() );
+   batch.compression = block_batch_compression::zlib;
+   unpacked = unpack_block_batch( batch );
+   BOOST_REQUIRE_EQUAL( unpacked.size(), 3u );
+   BOOST_CHECK( unpacked[2].block_id == blocks[2].id() );
+}
+
+BOOST_AUTO_TEST_CASE( invalid_batches )
+{
+   std::vector<signed_block> blocks = make_blocks( 9, 2 );
+
+   // the count has to match the blocks the batch holds
+   BOOST_CHECK_THROW( unpack_block_batch( pack_batch( blocks, 3 ) ), fc::exception );
+   BOOST_CHECK_THROW( unpack_block_batch( pack_batch( blocks, 1 ) ), fc::exception );
+   BOOST_CHECK_THROW( unpack_block_batch( pack_batch( blocks, 0 ) ), fc::exception );
+   BOOST_CHECK_THROW( unpack_block_batch( pack_batch( blocks, GRAPHENE_NET_MAX_BLOCKS_PER_BATCH + 1 ) ), fc::exception );
+
+   block_batch_message batch = pack_batch( blocks, 2 );
+   batch.compression = block_batch_compression( 7 );
+   BOOST_CHECK_THROW( unpack_block_batch( batch ), fc::exception );
+
+   // data that isn't a zlib stream, and one inflating to more than a batch ever holds
+   batch.compression = block_batch_compression::zlib;
+   BOOST_CHECK_THROW( unpack_block_batch( batch ), fc::exception );
+
+   std::string bomb = fc::zlib_compress( std::string( GRAPHENE_NET_MAX_BLOCK_BATCH_BYTES + 1, '\0' ) );
+   batch.data.assign( bomb.begin(), bomb.end() );
+   BOOST_CHECK_THROW( unpack_block_batch( batch ), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( short_and_mismatched_batches )
+{
+   std::vector<signed_block> blocks = make_blocks( 9, 3 );
+   std::vector<item_hash_t> requested = ids_of( blocks );
+   std::vector<block_message> received = unpack_block_batch( pack_batch( blocks, 3 ) );
+
+   BOOST_CHECK_EQUAL( count_requested_batch_blocks( received, requested ), 3u );
+
+   // the blocks that didn't fit in the message are requested again
+   received.pop_back();
+   BOOST_CHECK_EQUAL( count_requested_batch_blocks( received, requested ), 2u );
+   BOOST_CHECK_EQUAL( count_requested_batch_blocks( std::vector<block_message>(), requested ), 0u );
+
+   // the peer switched forks after the first block, the blocks of the other fork are not ours
+   std::vector<signed_block> fork = make_blocks( 9, 3 );
+   fork[1].timestamp += 1;
+   requested[1] = fork[1].id();
+   BOOST_CHECK_EQUAL( count_requested_batch_blocks( received, requested ), 1u );
+
+   // more blocks than requested is an invalid batch
+   requested.resize( 1 );
+   BOOST_CHECK_THROW( count_requested_batch_blocks( received, requested ), fc::exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
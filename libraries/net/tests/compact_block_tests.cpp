@@ -0,0 +1,103 @@
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/compact_block.hpp>
+#include <graphene/net/message.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+
+using namespace graphene::net;
+
+namespace
+{
+   signed_transaction make_transaction( uint32_t n )
+   {
+      signed_transaction transaction;
+      transaction.ref_block_num = uint16_t( n );
+      transaction.ref_block_prefix = n;
+      transaction.expiration = fc::time_point_sec( 1000000 + n );
+      return transaction;
+   }
+
+   // a block with count transactions and the hash of the block message advertising it
+   std::pair<signed_block, item_hash_t> make_block( uint32_t count )
+   {
+      signed_block block;
+      block.timestamp = fc::time_point_sec( 1000000 );
+      for( uint32_t i = 0; i < count; ++i )
+         block.transactions.push_back( make_transaction( i ) );
+      return std::make_pair( block, message( block_message( block ) ).id() );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE( compact_block_tests )
+
+BOOST_AUTO_TEST_CASE( short_transaction_ids )
+{
+   auto block = make_block( 3 );
+   transaction_id_type id = block.first.transactions[0].id();
+
+   BOOST_CHECK_EQUAL( compact_block_message::short_transaction_id( block.second, id ),
+                      compact_block_message::short_transaction_id( block.second, id ) );
+
+   // salted with the block, so a collision in one block doesn't carry over to the next
+   BOOST_CHECK_NE( compact_block_message::short_transaction_id( block.second, id ),
+                   compact_block_message::short_transaction_id( make_block( 2 ).second, id ) );
+   BOOST_CHECK_NE( compact_block_message::short_transaction_id( block.second, id ),
+                   compact_block_message::short_transaction_id( block.second, block.first.transactions[1].id() ) );
+
+   compact_block_message compact_block = make_compact_block( block.second, block.first );
+   BOOST_CHECK( compact_block.block_message_hash == block.second );
+   BOOST_CHECK( compact_block.header.id() == block.first.id() );
+   BOOST_REQUIRE_EQUAL( compact_block.short_transaction_ids.size(), 3u );
+   for( size_t i = 0; i < 3; ++i )
+      BOOST_CHECK_EQUAL( compact_block.short_transaction_ids[i],
+                         compact_block_message::short_transaction_id( block.second, block.first.transactions[i].id() ) );
+}
+
+BOOST_AUTO_TEST_CASE( reconstruction_with_missing_transactions )
+{
+   auto block = make_block( 4 );
+   compact_block_message compact_block = make_compact_block( block.second, block.first );
+
+   // everything found in the pending pool rebuilds the block at once
+   std::vector< fc::optional<signed_transaction> > found( block.first.transactions.begin(), block.first.transactions.end() );
+   compact_block_reconstruction reconstruction = start_compact_block_reconstruction( compact_block, found );
+   BOOST_CHECK( reconstruction.missing_transaction_indexes.empty() );
+   BOOST_CHECK( is_advertised_compact_block( block_message( reconstruction.block ), block.second ) );
+
+   // the transactions not found are requested by position, a short lookup result counts as not found
+   found[1].reset();
+   found.resize( 3 );
+   reconstruction = start_compact_block_reconstruction( compact_block, found );
+   BOOST_CHECK( reconstruction.missing_transaction_indexes == std::vector<uint32_t>( { 1, 3 } ) );
+   BOOST_CHECK( !is_advertised_compact_block( block_message( reconstruction.block ), block.second ) );
+
+   BOOST_CHECK_THROW( complete_compact_block_reconstruction( compact_block_reconstruction( reconstruction ),
+                                                             { block.first.transactions[1] } ), fc::exception );
+
+   signed_block rebuilt = complete_compact_block_reconstruction( std::move( reconstruction ),
+                                                                 { block.first.transactions[1], block.first.transactions[3] } );
+   BOOST_CHECK( rebuilt.id() == block.first.id() );
+   BOOST_CHECK( is_advertised_compact_block( block_message( rebuilt ), block.second ) );
+}
+
+BOOST_AUTO_TEST_CASE( hash_mismatch_falls_back_to_full_block )
+{
+   auto block = make_block( 2 );
+   compact_block_message compact_block = make_compact_block( block.second, block.first );
+
+   // our pending copy of a transaction carries another signature, its id and short id are the same
+   signed_transaction pending_copy = block.first.transactions[1];
+   pending_copy.signatures.push_back( fc::ecc::compact_signature() );
+   pending_copy.signatures.back().data[0] = 0x1f;
+   BOOST_REQUIRE( pending_copy.id() == block.first.transactions[1].id() );
+
+   std::vector< fc::optional<signed_transaction> > found = { block.first.transactions[0], pending_copy };
+   compact_block_reconstruction reconstruction = start_compact_block_reconstruction( compact_block, found );
+   BOOST_CHECK( reconstruction.missing_transaction_indexes.empty() );
+
+   // the rebuilt block isn't the one advertised, so the full block is requested instead
+   BOOST_CHECK( !is_advertised_compact_block( block_message( reconstruction.block ), block.second ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+#define BOOST_TEST_MODULE net test
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/config.hpp>
+#include <graphene/net/sync_window.hpp>
+
+using namespace graphene::net;
+
+BOOST_AUTO_TEST_SUITE( sync_window_tests )
+
+BOOST_AUTO_TEST_CASE( block_interval_average )
+{
+   // the first sample is taken as is, later ones move the average by an eighth
+   BOOST_CHECK_EQUAL( average_sync_block_interval( fc::microseconds(), fc::milliseconds( 80 ), 1 ).count(), 80000 );
+   BOOST_CHECK_EQUAL( average_sync_block_interval( fc::milliseconds( 80 ), fc::milliseconds( 160 ), 1 ).count(), 90000 );
+
+   // a batch of 40 blocks that took 400 ms is 10 ms per block
+   BOOST_CHECK_EQUAL( average_sync_block_interval( fc::microseconds(), fc::milliseconds( 400 ), 40 ).count(), 10000 );
+   BOOST_CHECK_EQUAL( average_sync_block_interval( fc::milliseconds( 18 ), fc::milliseconds( 400 ), 40 ).count(), 17000 );
+
+   // no blocks, no sample
+   BOOST_CHECK_EQUAL( average_sync_block_interval( fc::milliseconds( 18 ), fc::milliseconds( 400 ), 0 ).count(), 18000 );
+}
+
+BOOST_AUTO_TEST_CASE( window_size )
+{
+   const uint32_t maximum = GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING;
+
+   // unmeasured peers start with the initial window
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::microseconds(), fc::milliseconds( 100 ) }, maximum ),
+                      uint32_t( GRAPHENE_NET_INITIAL_SYNC_WINDOW ) );
+
+   // 50 ms per block and a 200 ms round trip: 2200 ms of blocks
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 50 ), fc::milliseconds( 200 ) }, maximum ), 44u );
+
+   // a partial block rounds up
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 30 ), fc::milliseconds( 200 ) }, maximum ), 74u );
+
+   // the round trip counts, a far away peer of the same rate gets a larger window
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 50 ), fc::milliseconds( 800 ) }, maximum ), 56u );
+
+   // a fast peer is capped at the maximum, a slow one kept at the minimum
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 2 ), fc::milliseconds( 20 ) }, maximum ), maximum );
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::seconds( 1 ), fc::milliseconds( 500 ) }, maximum ),
+                      uint32_t( GRAPHENE_NET_MIN_SYNC_WINDOW ) );
+
+   // a round trip that hasn't been measured is no round trip
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 50 ), fc::microseconds( -1 ) }, maximum ), 40u );
+
+   // the configured maximum wins over the minimum and the initial window
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::seconds( 1 ), fc::milliseconds( 500 ) }, 5 ), 5u );
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::microseconds(), fc::milliseconds( 100 ) }, 5 ), 5u );
+   BOOST_CHECK_EQUAL( compute_sync_window( sync_peer_timing{ fc::milliseconds( 50 ), fc::milliseconds( 200 ) }, 0 ), 1u );
+}
+
+BOOST_AUTO_TEST_CASE( overdue_timeout )
+{
+   const fc::microseconds unmeasured = fc::seconds( 3 );
+
+   // unmeasured peers get the caller's timeout
+   BOOST_CHECK_EQUAL( compute_sync_overdue_timeout( sync_peer_timing{ fc::microseconds(), fc::milliseconds( 100 ) }, 50, unmeasured ).count(),
+                      unmeasured.count() );
+
+   // 100 ms per block, 20 outstanding and a 200 ms round trip should take 2.2 s, overdue after three times that
+   BOOST_CHECK_EQUAL( compute_sync_overdue_timeout( sync_peer_timing{ fc::milliseconds( 100 ), fc::milliseconds( 200 ) }, 20, unmeasured ).count(),
+                      fc::milliseconds( 2200 * GRAPHENE_NET_SYNC_OVERDUE_FACTOR ).count() );
+
+   // the more a peer has outstanding, the longer its last block may take
+   BOOST_CHECK_LT( compute_sync_overdue_timeout( sync_peer_timing{ fc::milliseconds( 100 ), fc::milliseconds( 200 ) }, 10, unmeasured ).count(),
+                   compute_sync_overdue_timeout( sync_peer_timing{ fc::milliseconds( 100 ), fc::milliseconds( 200 ) }, 20, unmeasured ).count() );
+
+   // a fast nearby peer is never overdue sooner than the minimum
+   BOOST_CHECK_EQUAL( compute_sync_overdue_timeout( sync_peer_timing{ fc::milliseconds( 2 ), fc::milliseconds( 20 ) }, 10, unmeasured ).count(),
+                      fc::milliseconds( GRAPHENE_NET_MIN_SYNC_OVERDUE_MILLISECONDS ).count() );
+
+   // an unmeasured round trip is no round trip
+   BOOST_CHECK_EQUAL( compute_sync_overdue_timeout( sync_peer_timing{ fc::milliseconds( 500 ), fc::microseconds( -1 ) }, 4, unmeasured ).count(),
+                      fc::milliseconds( 2000 * GRAPHENE_NET_SYNC_OVERDUE_FACTOR ).count() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
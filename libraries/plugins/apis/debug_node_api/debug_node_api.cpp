@@ -33,6 +33,7 @@ class debug_node_api_impl
          (debug_set_hardfork)
          (debug_has_hardfork)
          (debug_get_json_schema)
+         (debug_get_chainbase_stats)
       )
 
       chain::database& _db;
@@ -150,6 +151,17 @@ DEFINE_API_IMPL( debug_node_api_impl, debug_get_json_schema )
    return { _db.get_json_schema() };
 }
 
+DEFINE_API_IMPL( debug_node_api_impl, debug_get_chainbase_stats )
+{
+   debug_get_chainbase_stats_return result;
+   result.instrumentation_enabled = _db.is_instrumentation_enabled();
+   result.indices = _db.with_read_lock( [&]() { return _db.get_index_activity(); } );
+   result.read_lock_wait = _db.get_read_lock_wait_stats();
+   result.write_lock_wait = _db.get_write_lock_wait_stats();
+   result.write_queue = appbase::app().get_plugin< chain::chain_plugin >().get_write_queue_stats();
+   return result;
+}
+
 } // detail
 
 debug_node_api::debug_node_api(): my( new detail::debug_node_api_impl() )
@@ -169,6 +181,7 @@ DEFINE_LOCKLESS_APIS( debug_node_api,
    (debug_set_hardfork)
    (debug_has_hardfork)
    (debug_get_json_schema)
+   (debug_get_chainbase_stats)
 )
 
 } } } // voilk::plugins::debug_node
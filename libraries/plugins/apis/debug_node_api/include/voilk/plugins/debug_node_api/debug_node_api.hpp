@@ -5,6 +5,8 @@
 
 #include <voilk/protocol/types.hpp>
 
+#include <chainbase/instrumentation.hpp>
+
 #include <fc/optional.hpp>
 #include <fc/variant.hpp>
 #include <fc/vector.hpp>
@@ -70,6 +72,17 @@ struct debug_get_json_schema_return
    std::string schema;
 };
 
+typedef void_type debug_get_chainbase_stats_args;
+
+struct debug_get_chainbase_stats_return
+{
+   bool                                            instrumentation_enabled = false;
+   std::vector< chainbase::index_activity_info >   indices;
+   chainbase::lock_wait_stats                      read_lock_wait;
+   chainbase::lock_wait_stats                      write_lock_wait;
+   chain::write_queue_stats                        write_queue;
+};
+
 
 class debug_node_api
 {
@@ -103,6 +116,12 @@ class debug_node_api
          (debug_set_hardfork)
          (debug_has_hardfork)
          (debug_get_json_schema)
+
+         /*
+         * Per index write counts and times, undo bytes and lock wait histograms. Counts and times
+         * require the chainbase-instrumentation option.
+         */
+         (debug_get_chainbase_stats)
       )
 
    private:
@@ -131,3 +150,12 @@ FC_REFLECT( voilk::plugins::debug_node::debug_has_hardfork_return,
 
 FC_REFLECT( voilk::plugins::debug_node::debug_get_json_schema_return,
             (schema) )
+
+FC_REFLECT( chainbase::lock_wait_stats,
+            (count)(total_us)(max_us)(buckets) )
+
+FC_REFLECT( chainbase::index_activity_info,
+            (value_type_name)(creates)(modifies)(removes)(time_ns)(undo_bytes) )
+
+FC_REFLECT( voilk::plugins::debug_node::debug_get_chainbase_stats_return,
+            (instrumentation_enabled)(indices)(read_lock_wait)(write_lock_wait)(write_queue) )
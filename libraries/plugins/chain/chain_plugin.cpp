@@ -1,4 +1,5 @@
 #include <voilk/chain/database_exceptions.hpp>
+#include <voilk/chain/util/prevalidate.hpp>
 
 #include <voilk/plugins/chain/chain_plugin.hpp>
 #include <voilk/plugins/statsd/utility.hpp>
@@ -12,8 +13,13 @@
 #include <boost/bind.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/thread/future.hpp>
-#include <boost/lockfree/queue.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <memory>
 #include <iostream>
@@ -52,32 +58,139 @@ struct write_context
    bool                          success = true;
    fc::optional< fc::exception > except;
    promise_ptr                   prom_ptr;
+   std::chrono::steady_clock::time_point queued_at;
 };
 
 namespace detail {
 
+/**
+ * The writes waiting for the write thread. Blocks, including the ones generated by this node, are served
+ * before pending transactions so a burst of incoming transactions never delays the next block.
+ */
+class write_request_queue
+{
+   public:
+      void push( write_context* cxt )
+      {
+         uint64_t depth = 0;
+
+         {
+            std::lock_guard< std::mutex > lock( _mutex );
+            cxt->queued_at = std::chrono::steady_clock::now();
+
+            if( cxt->req_ptr.which() == write_request_ptr::tag< const signed_transaction* >::value )
+               _transactions.push_back( cxt );
+            else
+               _blocks.push_back( cxt );
+
+            depth = _blocks.size() + _transactions.size();
+         }
+
+         _depth.record( depth );
+         _cond.notify_one();
+
+         if( cxt->req_ptr.which() != write_request_ptr::tag< const signed_transaction* >::value && on_block_queued )
+            on_block_queued();
+      }
+
+      /** Returns the next write without waiting, or null when the queue is empty */
+      write_context* pop()
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         return pop_front();
+      }
+
+      /** Waits for the next write, returns null once the queue is stopped */
+      write_context* wait_pop()
+      {
+         std::unique_lock< std::mutex > lock( _mutex );
+         _cond.wait( lock, [&]() { return _stopped || !_blocks.empty() || !_transactions.empty(); } );
+         return _stopped ? nullptr : pop_front();
+      }
+
+      bool has_block()const
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         return !_blocks.empty();
+      }
+
+      void stop()
+      {
+         {
+            std::lock_guard< std::mutex > lock( _mutex );
+            _stopped = true;
+         }
+
+         _cond.notify_all();
+      }
+
+      /** Called after a block or block generation is queued, to wake the write thread if it waits for readers */
+      std::function< void() >          on_block_queued;
+
+      void get_stats( write_queue_stats& stats )const
+      {
+         std::lock_guard< std::mutex > lock( _mutex );
+         stats.queued_blocks = _blocks.size();
+         stats.queued_transactions = _transactions.size();
+         stats.queue_depth = _depth.get_stats();
+      }
+
+   private:
+      write_context* pop_front()
+      {
+         std::deque< write_context* >& queue = _blocks.empty() ? _transactions : _blocks;
+         if( queue.empty() )
+            return nullptr;
+
+         write_context* cxt = queue.front();
+         queue.pop_front();
+         return cxt;
+      }
+
+      mutable std::mutex               _mutex;
+      std::condition_variable          _cond;
+      std::deque< write_context* >     _blocks;
+      std::deque< write_context* >     _transactions;
+      bool                             _stopped = false;
+      chainbase::lock_wait_histogram   _depth;
+};
+
 class chain_plugin_impl
 {
    public:
-      chain_plugin_impl() : write_queue( 64 ) {}
-      ~chain_plugin_impl() { stop_write_processing(); }
+      chain_plugin_impl() {}
+      ~chain_plugin_impl() { stop_write_processing(); stop_signature_recovery(); }
 
       void start_write_processing();
       void stop_write_processing();
 
+      void start_signature_recovery();
+      void stop_signature_recovery();
+      void recover_signatures( const signed_block& block );
+      void prevalidate_transaction( const signed_transaction& trx );
+
       uint64_t                         shared_memory_size = 0;
       uint16_t                         shared_file_full_threshold = 0;
       uint16_t                         shared_file_scale_rate = 0;
       bfs::path                        shared_memory_dir;
+      bfs::path                        load_snapshot_dir;
+      bfs::path                        export_snapshot_dir;
       bool                             replay = false;
       bool                             resync   = false;
       bool                             readonly = false;
       bool                             check_locks = false;
+      bool                             chainbase_instrumentation = false;
       bool                             validate_invariants = false;
       bool                             dump_memory_details = false;
       bool                             benchmark_is_enabled =false;
       bool                             statsd_on_replay = false;
       uint32_t                         stop_replay_at = 0;
+      uint32_t                         replay_queue_depth = 0;
+      uint32_t                         replay_decode_threads = 1;
+      uint32_t                         snapshot_threads = 1;
+      uint32_t                         signature_recovery_threads = 0;
+      uint32_t                         signature_key_cache_size = voilk::chain::util::signature_key_cache::default_max_size;
+      uint32_t                         pending_reapply_batch = 0;
       uint32_t                         benchmark_interval = 0;
       uint32_t                         flush_interval = 0;
       flat_map<uint32_t,block_id_type> loaded_checkpoints;
@@ -86,8 +199,23 @@ class chain_plugin_impl
 
       bool                             running = true;
       std::shared_ptr< std::thread >   write_processor_thread;
-      boost::lockfree::queue< write_context* > write_queue;
+      write_request_queue              write_queue;
       int16_t                          write_lock_hold_time = 500;
+      int16_t                          write_lock_yield_time = 50;
+      std::atomic< int64_t >           write_slice_us{ 0 };
+      std::atomic< uint64_t >          reader_yields{ 0 };
+      chainbase::lock_wait_histogram   write_wait_histogram;
+      chainbase::lock_wait_histogram   lock_hold_histogram;
+
+      // Published by the write thread for the checks running outside of the write lock, 0 until known
+      std::atomic< uint32_t >          head_block_time_sec{ 0 };
+      std::atomic< uint32_t >          maximum_block_size{ 0 };
+
+      boost::thread_group              signature_recovery_pool;
+      asio::io_service                 signature_recovery_ios;
+      std::unique_ptr< asio::io_service::work > signature_recovery_work;
+      std::mutex                       signature_recovery_mutex;     // Guards posting against stopping the pool
+      std::atomic< bool >              signature_recovery_stopping{ false };
 
       database  db;
 };
@@ -99,9 +227,94 @@ struct write_request_visitor
    database* db;
    uint32_t  skip = 0;
    fc::optional< fc::exception >* except;
+   voilk::chain::util::signature_key_cache_stats last_cache_stats;
+   voilk::chain::pending_transaction_stats last_pending_stats;
+   std::vector< chainbase::index_activity_info > last_index_activity;
+   chainbase::lock_wait_stats last_read_lock_waits;
+   chainbase::lock_wait_stats last_write_lock_waits;
 
    typedef bool result_type;
 
+   void report_lock_waits( const std::string& stat, const chainbase::lock_wait_stats& stats, chainbase::lock_wait_stats& last )
+   {
+      STATSD_COUNT( "chainbase", stat, "count", stats.count - last.count, 1.0f )
+      STATSD_COUNT( "chainbase", stat, "total_us", stats.total_us - last.total_us, 1.0f )
+      STATSD_GAUGE( "chainbase", stat, "max_us", stats.max_us, 1.0f )
+
+      for( size_t i = 0; i < stats.buckets.size(); ++i )
+      {
+         uint64_t last_count = i < last.buckets.size() ? last.buckets[i] : 0;
+         if( stats.buckets[i] != last_count )
+            STATSD_COUNT( "chainbase", stat, "lt_" + std::to_string( uint64_t(1) << i ) + "us", stats.buckets[i] - last_count, 1.0f )
+      }
+
+      last = stats;
+   }
+
+   /**
+    * Reports the pending transactions applied again since the last report to statsd
+    */
+   void report_pending_transactions()
+   {
+      if( !voilk::plugins::statsd::util::statsd_enabled() )
+         return;
+
+      const auto& stats = db->get_pending_transaction_stats();
+      STATSD_COUNT( "chain", "pending_tx", "reapplied", stats.reapplied - last_pending_stats.reapplied, 1.0f )
+      STATSD_COUNT( "chain", "pending_tx", "failed", stats.failed - last_pending_stats.failed, 1.0f )
+      STATSD_COUNT( "chain", "pending_tx", "dropped_included", stats.dropped_included - last_pending_stats.dropped_included, 1.0f )
+      STATSD_COUNT( "chain", "pending_tx", "dropped_expired", stats.dropped_expired - last_pending_stats.dropped_expired, 1.0f )
+      STATSD_TIMER( "chain", "pending_tx", "reapply_time", stats.reapply_time - last_pending_stats.reapply_time, 1.0f )
+      STATSD_GAUGE( "chain", "pending_tx", "backlog", db->pending_transaction_backlog_size(), 1.0f )
+      last_pending_stats = stats;
+   }
+
+   /**
+    * Applies the next batch of the pending transactions left waiting by the last block
+    */
+   void apply_pending_backlog( uint32_t batch )
+   {
+      db->apply_pending_transaction_backlog( batch );
+      report_pending_transactions();
+   }
+
+   /**
+    * Reports the chainbase activity since the last block to statsd
+    */
+   void report_chainbase_activity()
+   {
+      if( !db->is_instrumentation_enabled() || !voilk::plugins::statsd::util::statsd_enabled() )
+         return;
+
+      auto activity = db->get_index_activity();
+      last_index_activity.resize( activity.size() );
+
+      for( size_t i = 0; i < activity.size(); ++i )
+      {
+         const auto& a = activity[i];
+         auto& last = last_index_activity[i];
+
+         // Strip the namespace, statsd keys are separated by dots and colons
+         std::string name = a.value_type_name.substr( a.value_type_name.rfind( ':' ) + 1 );
+
+         if( a.creates != last.creates )
+            STATSD_COUNT( "chainbase", name, "creates", a.creates - last.creates, 1.0f )
+         if( a.modifies != last.modifies )
+            STATSD_COUNT( "chainbase", name, "modifies", a.modifies - last.modifies, 1.0f )
+         if( a.removes != last.removes )
+            STATSD_COUNT( "chainbase", name, "removes", a.removes - last.removes, 1.0f )
+         if( a.undo_bytes != last.undo_bytes )
+            STATSD_COUNT( "chainbase", name, "undo_bytes", a.undo_bytes - last.undo_bytes, 1.0f )
+         if( a.time_ns != last.time_ns )
+            STATSD_COUNT( "chainbase", name, "time_us", ( a.time_ns - last.time_ns ) / 1000, 1.0f )
+
+         last = a;
+      }
+
+      report_lock_waits( "read_lock_wait", db->get_read_lock_wait_stats(), last_read_lock_waits );
+      report_lock_waits( "write_lock_wait", db->get_write_lock_wait_stats(), last_write_lock_waits );
+   }
+
    bool operator()( const signed_block* block )
    {
       bool result = false;
@@ -111,6 +324,15 @@ struct write_request_visitor
          STATSD_START_TIMER( "chain", "write_time", "push_block", 1.0f )
          result = db->push_block( *block, skip );
          STATSD_STOP_TIMER( "chain", "write_time", "push_block" )
+
+         auto cache_stats = db->get_signature_key_cache().get_stats();
+         STATSD_COUNT( "chain", "signature_cache", "hit", cache_stats.hits - last_cache_stats.hits, 1.0f )
+         STATSD_COUNT( "chain", "signature_cache", "miss", cache_stats.misses - last_cache_stats.misses, 1.0f )
+         STATSD_GAUGE( "chain", "signature_cache", "size", cache_stats.size, 1.0f )
+         last_cache_stats = cache_stats;
+
+         report_pending_transactions();
+         report_chainbase_activity();
       }
       catch( fc::exception& e )
       {
@@ -132,7 +354,7 @@ struct write_request_visitor
       try
       {
          STATSD_START_TIMER( "chain", "write_time", "push_transaction", 1.0f )
-         db->push_transaction( *trx );
+         db->push_transaction( *trx, skip );
          STATSD_STOP_TIMER( "chain", "write_time", "push_transaction" )
 
          result = true;
@@ -196,16 +418,21 @@ struct request_promise_visitor
 
 void chain_plugin_impl::start_write_processing()
 {
+   write_queue.on_block_queued = [this]() { db.stop_waiting_for_readers(); };
+
    write_processor_thread = std::make_shared< std::thread >( [&]()
    {
       bool is_syncing = true;
+      bool has_backlog = false;
       write_context* cxt;
-      fc::time_point_sec start = fc::time_point::now();
       write_request_visitor req_visitor;
       req_visitor.db = &db;
 
       request_promise_visitor prom_visitor;
 
+      const int64_t max_slice_us = write_lock_yield_time > 0 ? int64_t( write_lock_yield_time ) * 1000 : 0;
+      write_slice_us = max_slice_us;
+
       /* This loop monitors the write request queue and performs writes to the database. These
        * can be blocks or pending transactions. Because the caller needs to know the success of
        * the write and any exceptions that are thrown, a write context is passed in the queue
@@ -213,56 +440,130 @@ void chain_plugin_impl::start_write_processing()
        * caller's responsibility to ensure the pointer to the write context remains valid until
        * the contained promise is complete.
        *
-       * The loop has two modes, sync mode and live mode. In sync mode we want to process writes
-       * as quickly as possible with minimal overhead. The outer loop busy waits on the queue
-       * and the inner loop drains the queue as quickly as possible. We exit sync mode when the
-       * head block is within 1 minute of system time.
+       * The thread sleeps on the queue until a write arrives and then drains it, taking blocks
+       * before pending transactions. The loop has two modes, sync mode and live mode. In sync mode
+       * we want to process writes as quickly as possible with minimal overhead and the lock is
+       * held until the queue is empty. We exit sync mode when the head block is within 1 minute
+       * of system time.
        *
        * Live mode needs to balance between processing pending writes and allowing readers access
        * to the database. It will batch writes together as much as possible to minimize lock
-       * overhead but will willingly give up the write lock after 500ms. The thread then sleeps for
-       * 10ms. This allows time for readers to access the database as well as more writes to come
-       * in. When the node is live the rate at which writes come in is slower and busy waiting is
-       * not an optimal use of system resources when we could give CPU time to read threads.
+       * overhead but will willingly give up the write lock after 500ms, or after a shorter slice
+       * when readers are waiting for the lock. Readers therefore always see the state between two
+       * writes. The slice adapts to how long readers actually waited: it is halved when they waited
+       * longer than write-lock-yield-time, which happens when single writes are slow, and grows back
+       * towards it while they are served quickly. After giving up the lock the thread waits for the
+       * waiting readers to get it before taking it again, unless a block is queued.
+       *
+       * Pending transactions that a block left waiting to be applied again are applied in batches
+       * after queued blocks but before new transactions, giving readers the lock between batches
+       * like any other write.
        */
       while( running )
       {
-         if( !is_syncing )
-            start = fc::time_point::now();
+         if( has_backlog )
+            cxt = write_queue.has_block() ? write_queue.pop() : nullptr;
+         else if( ( cxt = write_queue.wait_pop() ) == nullptr )
+            break;
 
-         if( write_queue.pop( cxt ) )
+         fc::time_point start = fc::time_point::now();
+         fc::time_point readers_seen;
+         bool readers_waiting = false;
+
+         db.with_write_lock( [&]()
          {
-            db.with_write_lock( [&]()
+            STATSD_START_TIMER( "chain", "lock_time", "write_lock", 1.0f )
+            while( true )
             {
-               STATSD_START_TIMER( "chain", "lock_time", "write_lock", 1.0f )
-               while( true )
+               if( cxt == nullptr )
+               {
+                  req_visitor.apply_pending_backlog( pending_reapply_batch );
+               }
+               else
                {
+                  uint64_t wait_us = std::chrono::duration_cast< std::chrono::microseconds >(
+                     std::chrono::steady_clock::now() - cxt->queued_at ).count();
+                  write_wait_histogram.record( wait_us );
+                  STATSD_TIMER( "chain", "write_queue", "wait", fc::microseconds( wait_us ), 1.0f )
+
                   req_visitor.skip = cxt->skip;
                   req_visitor.except = &(cxt->except);
                   cxt->success = cxt->req_ptr.visit( req_visitor );
                   cxt->prom_ptr.visit( prom_visitor );
+               }
 
-                  if( is_syncing && start - db.head_block_time() < fc::minutes(1) )
-                  {
-                     start = fc::time_point::now();
-                     is_syncing = false;
-                  }
+               fc::time_point now = fc::time_point::now();
+
+               if( is_syncing && now - db.head_block_time() < fc::minutes(1) )
+               {
+                  is_syncing = false;
+               }
+
+               if( !is_syncing && write_lock_hold_time >= 0 && now - start > fc::milliseconds( write_lock_hold_time ) )
+               {
+                  break;
+               }
 
-                  if( !is_syncing && write_lock_hold_time >= 0 && fc::time_point::now() - start > fc::milliseconds( write_lock_hold_time ) )
+               if( !is_syncing && write_lock_yield_time >= 0 && db.waiting_readers() )
+               {
+                  if( !readers_waiting )
                   {
-                     break;
+                     readers_waiting = true;
+                     readers_seen = now;
                   }
 
-                  if( !write_queue.pop( cxt ) )
+                  if( now - start > fc::microseconds( write_slice_us ) )
                   {
+                     ++reader_yields;
+                     STATSD_COUNT( "chain", "lock", "read_yield", 1, 1.0f )
                      break;
                   }
                }
-            });
+
+               if( db.pending_transaction_backlog_size() > 0 && !write_queue.has_block() )
+               {
+                  cxt = nullptr;
+                  continue;
+               }
+
+               cxt = write_queue.pop();
+               if( cxt == nullptr )
+               {
+                  break;
+               }
+            }
+
+            has_backlog = db.pending_transaction_backlog_size() > 0;
+            head_block_time_sec = db.head_block_num() > 0 ? db.head_block_time().sec_since_epoch() : 0;
+            maximum_block_size = db.get_dynamic_global_properties().maximum_block_size;
+         });
+
+         fc::time_point end = fc::time_point::now();
+         lock_hold_histogram.record( ( end - start ).count() );
+         STATSD_TIMER( "chain", "write_queue", "lock_hold", end - start, 1.0f )
+
+         if( readers_waiting )
+         {
+            int64_t waited = ( end - readers_seen ).count();
+            int64_t slice = write_slice_us;
+
+            if( waited > max_slice_us )
+               slice /= 2;
+            else if( waited < max_slice_us / 2 )
+               slice = std::min( max_slice_us, slice + slice / 4 + 1000 );
+
+            write_slice_us = slice;
+            STATSD_GAUGE( "chain", "write_queue", "slice_us", slice, 1.0f )
          }
 
-         if( !is_syncing )
-            boost::this_thread::sleep_for( boost::chrono::milliseconds( 10 ) );
+         if( !is_syncing && write_lock_yield_time >= 0 && db.waiting_readers() )
+         {
+            auto hand_off_end = std::chrono::steady_clock::now() + std::chrono::microseconds( std::max< int64_t >( write_slice_us, 1000 ) );
+
+            // woken by the last waiting reader getting the lock, a queued block or stop_write_processing()
+            while( running && !write_queue.has_block() && !db.wait_for_waiting_readers( hand_off_end ) &&
+                   std::chrono::steady_clock::now() < hand_off_end );
+         }
       }
    });
 }
@@ -270,6 +571,8 @@ void chain_plugin_impl::start_write_processing()
 void chain_plugin_impl::stop_write_processing()
 {
    running = false;
+   write_queue.stop();
+   db.stop_waiting_for_readers();
 
    if( write_processor_thread )
       write_processor_thread->join();
@@ -277,6 +580,134 @@ void chain_plugin_impl::stop_write_processing()
    write_processor_thread.reset();
 }
 
+void chain_plugin_impl::start_signature_recovery()
+{
+   if( signature_recovery_threads == 0 )
+      return;
+
+   signature_recovery_work.reset( new asio::io_service::work( signature_recovery_ios ) );
+
+   for( uint32_t i = 0; i < signature_recovery_threads; ++i )
+      signature_recovery_pool.create_thread( boost::bind( &asio::io_service::run, &signature_recovery_ios ) );
+}
+
+/**
+ * Jobs still queued are not dropped, their callers would wait forever. The pool runs them all, and each one
+ * fails its caller with a canceled_exception instead of doing its work.
+ */
+void chain_plugin_impl::stop_signature_recovery()
+{
+   {
+      std::lock_guard< std::mutex > lock( signature_recovery_mutex );
+      signature_recovery_stopping = true;
+      signature_recovery_work.reset();
+   }
+
+   signature_recovery_pool.join_all();
+}
+
+/**
+ * Recovers the signing keys of every transaction in the block on the worker pool and waits for them.
+ * The keys land in the database's signature key cache, so the write thread only checks authorities.
+ * Throws a canceled_exception when the pool is stopped before the keys are recovered.
+ */
+void chain_plugin_impl::recover_signatures( const signed_block& block )
+{
+   if( block.transactions.empty() )
+      return;
+
+   const auto& trxs = block.transactions;
+   chain_id_type chain_id = db.get_chain_id();
+   auto& cache = db.get_signature_key_cache();
+
+   uint32_t num_tasks = std::min< uint32_t >( signature_recovery_threads, trxs.size() );
+   std::vector< boost::promise< void > > done( num_tasks );
+
+   {
+      std::lock_guard< std::mutex > lock( signature_recovery_mutex );
+      if( !signature_recovery_work )
+         return;
+
+      for( uint32_t t = 0; t < num_tasks; ++t )
+      {
+         signature_recovery_ios.post( [this, &trxs, &chain_id, &cache, &done, num_tasks, t]()
+         {
+            if( signature_recovery_stopping )
+            {
+               done[t].set_exception( boost::copy_exception(
+                  fc::canceled_exception( FC_LOG_MESSAGE( warn, "Signature recovery stopped." ) ) ) );
+               return;
+            }
+
+            for( size_t i = t; i < trxs.size(); i += num_tasks )
+               cache.recover( trxs[i], chain_id );
+
+            done[t].set_value();
+         });
+      }
+   }
+
+   for( auto& d : done )
+      d.get_future().get();
+}
+
+/**
+ * Runs util::prevalidate_transaction before a pending transaction is queued for the write thread, so bad
+ * transactions are rejected without taking the write lock. The checks run on the signature recovery pool
+ * when it is enabled, which bounds the cpu incoming transactions can take, otherwise on the caller.
+ */
+void chain_plugin_impl::prevalidate_transaction( const signed_transaction& trx )
+{
+   auto prevalidate = [this, &trx]()
+   {
+      voilk::chain::util::prevalidate_transaction( trx, db.get_chain_id(), fc::time_point_sec( head_block_time_sec ),
+         maximum_block_size, db.get_signature_key_cache() );
+   };
+
+   boost::promise< void > done;
+   fc::optional< fc::exception > except;
+
+   {
+      std::unique_lock< std::mutex > lock( signature_recovery_mutex );
+      if( !signature_recovery_work )
+      {
+         lock.unlock();
+         prevalidate();
+         return;
+      }
+
+      signature_recovery_ios.post( [&]()
+      {
+         try
+         {
+            if( signature_recovery_stopping )
+               FC_THROW_EXCEPTION( fc::canceled_exception, "Signature recovery stopped." );
+
+            prevalidate();
+         }
+         catch( fc::exception& e )
+         {
+            except = e;
+         }
+         catch( ... )
+         {
+            except = fc::unhandled_exception( FC_LOG_MESSAGE( warn, "Unexpected exception while validating transaction." ),
+                                             std::current_exception() );
+         }
+
+         done.set_value();
+      });
+   }
+
+   done.get_future().wait();
+
+   if( except )
+   {
+      STATSD_INCREMENT( "chain", "prevalidation", "rejected", 1.0f )
+      throw *except;
+   }
+}
+
 } // detail
 
 
@@ -304,15 +735,26 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
          ("flush-state-interval", bpo::value<uint32_t>(),
             "flush shared memory changes to disk every N blocks")
+         ("write-lock-yield-time", bpo::value<int16_t>()->default_value(50),
+            "Milliseconds API readers should wait at most for the write thread to release the database lock. The thread adapts how long it keeps writing while readers wait to stay under it. -1 disables yielding to readers.")
          ;
    cli.add_options()
          ("replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and replay all blocks" )
          ("resync-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and block log" )
          ("stop-replay-at-block", bpo::value<uint32_t>(), "Stop and exit after reaching given block number")
+         ("load-snapshot", bpo::value<bfs::path>(), "Clear chain database, load the state from the snapshot in the given directory and replay the blocks after it" )
+         ("export-snapshot", bpo::value<bfs::path>(), "Write a snapshot of the state to the given directory after opening the database" )
+         ("snapshot-threads", bpo::value<uint32_t>()->default_value(std::max( std::thread::hardware_concurrency(), 1u )), "Number of indices written or loaded in parallel by load-snapshot and export-snapshot." )
+         ("replay-queue-depth", bpo::value<uint32_t>()->default_value(0), "Number of blocks read and decoded ahead of block application during replay. 0 replays serially." )
+         ("replay-decode-threads", bpo::value<uint32_t>()->default_value(std::max( std::thread::hardware_concurrency(), 2u ) - 1), "Number of threads deserializing blocks when replay-queue-depth is set." )
+         ("signature-key-cache-size", bpo::value<uint32_t>()->default_value(voilk::chain::util::signature_key_cache::default_max_size), "Number of transactions whose recovered signing keys are kept for when they are applied again." )
+         ("pending-transaction-reapply-batch", bpo::value<uint32_t>()->default_value(500), "Number of pending transactions applied again right after each block. The others are applied in batches of this size between other writes, releasing the write lock in between. 0 applies all of them with the block." )
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(std::max( std::thread::hardware_concurrency(), 2u ) - 1), "Number of threads recovering transaction signatures of incoming blocks and validating incoming transactions before they are applied. 0 recovers block signatures on the write thread and validates transactions on the calling thread." )
          ("advanced-benchmark", "Make profiling for every plugin.")
          ("set-benchmark-interval", bpo::value<uint32_t>(), "Print time and memory usage every given number of blocks")
          ("dump-memory-details", bpo::bool_switch()->default_value(false), "Dump database objects memory usage info. Use set-benchmark-interval to set dump interval.")
          ("check-locks", bpo::bool_switch()->default_value(false), "Check correctness of chainbase locking" )
+         ("chainbase-instrumentation", bpo::bool_switch()->default_value(false), "Count and time the writes to each chainbase index and the time spent waiting for database locks. Reported to statsd and by debug_node_api.debug_get_chainbase_stats." )
          ("validate-database-invariants", bpo::bool_switch()->default_value(false), "Validate all supply invariants check out" )
          ("chain-id", bpo::value< std::string >()->default_value( VOILK_CHAIN_ID ), "chain ID to connect to")
          ;
@@ -342,9 +784,31 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
    my->resync              = options.at( "resync-blockchain").as<bool>();
    my->stop_replay_at      =
       options.count( "stop-replay-at-block" ) ? options.at( "stop-replay-at-block" ).as<uint32_t>() : 0;
+   my->replay_queue_depth  = options.at( "replay-queue-depth" ).as< uint32_t >();
+   my->replay_decode_threads = options.at( "replay-decode-threads" ).as< uint32_t >();
+   my->snapshot_threads    = options.at( "snapshot-threads" ).as< uint32_t >();
+
+   if( options.count( "load-snapshot" ) )
+   {
+      my->load_snapshot_dir = options.at( "load-snapshot" ).as< bfs::path >();
+      if( my->load_snapshot_dir.is_relative() )
+         my->load_snapshot_dir = app().data_dir() / my->load_snapshot_dir;
+   }
+
+   if( options.count( "export-snapshot" ) )
+   {
+      my->export_snapshot_dir = options.at( "export-snapshot" ).as< bfs::path >();
+      if( my->export_snapshot_dir.is_relative() )
+         my->export_snapshot_dir = app().data_dir() / my->export_snapshot_dir;
+   }
+   my->signature_recovery_threads = options.at( "signature-recovery-threads" ).as< uint32_t >();
+   my->signature_key_cache_size = options.at( "signature-key-cache-size" ).as< uint32_t >();
+   my->pending_reapply_batch = options.at( "pending-transaction-reapply-batch" ).as< uint32_t >();
+   my->write_lock_yield_time = options.at( "write-lock-yield-time" ).as< int16_t >();
    my->benchmark_interval  =
       options.count( "set-benchmark-interval" ) ? options.at( "set-benchmark-interval" ).as<uint32_t>() : 0;
    my->check_locks         = options.at( "check-locks" ).as< bool >();
+   my->chainbase_instrumentation = options.at( "chainbase-instrumentation" ).as< bool >();
    my->validate_invariants = options.at( "validate-database-invariants" ).as<bool>();
    my->dump_memory_details = options.at( "dump-memory-details" ).as<bool>();
    if( options.count( "flush-state-interval" ) )
@@ -409,6 +873,9 @@ void chain_plugin::plugin_startup()
    my->db.set_flush_interval( my->flush_interval );
    my->db.add_checkpoints( my->loaded_checkpoints );
    my->db.set_require_locking( my->check_locks );
+   my->db.set_instrumentation( my->chainbase_instrumentation );
+   my->db.get_signature_key_cache().set_max_size( my->signature_key_cache_size );
+   my->db.set_pending_transaction_reapply_limit( my->pending_reapply_batch );
 
    bool dump_memory_details = my->dump_memory_details;
    voilk::utilities::benchmark_dumper dumper;
@@ -439,6 +906,8 @@ void chain_plugin::plugin_startup()
    db_open_args.shared_file_scale_rate = my->shared_file_scale_rate;
    db_open_args.do_validate_invariants = my->validate_invariants;
    db_open_args.stop_replay_at = my->stop_replay_at;
+   db_open_args.replay_queue_depth = my->replay_queue_depth;
+   db_open_args.replay_decode_threads = my->replay_decode_threads;
    db_open_args.benchmark_is_enabled = my->benchmark_is_enabled;
 
    auto benchmark_lambda = [&dumper, &get_indexes_memory_details, dump_memory_details] ( uint32_t current_block_number,
@@ -474,7 +943,31 @@ void chain_plugin::plugin_startup()
          ("pm", measure.peak_mem) );
    };
 
-   if(my->replay)
+   if( !my->load_snapshot_dir.empty() )
+   {
+      ilog("Loading snapshot on user request.");
+      db_open_args.snapshot_dir = my->load_snapshot_dir;
+      db_open_args.snapshot_threads = my->snapshot_threads;
+
+      uint32_t last_block_number = 0;
+
+      try
+      {
+         last_block_number = my->db.load_snapshot( db_open_args );
+      }
+      catch( const fc::exception& e )
+      {
+         elog("Error loading snapshot: ${e}", ("e", e.to_detail_string()));
+         exit(EXIT_FAILURE);
+      }
+
+      if( my->stop_replay_at > 0 && my->stop_replay_at == last_block_number )
+      {
+         ilog("Stopped blockchain replaying on user request. Last applied block number: ${n}.", ("n", last_block_number));
+         exit(EXIT_SUCCESS);
+      }
+   }
+   else if(my->replay)
    {
       ilog("Replaying blockchain on user request.");
       uint32_t last_block_number = 0;
@@ -518,9 +1011,23 @@ void chain_plugin::plugin_startup()
       }
    }
 
+   if( !my->export_snapshot_dir.empty() )
+   {
+      try
+      {
+         my->db.export_snapshot( my->export_snapshot_dir, my->snapshot_threads );
+      }
+      catch( const fc::exception& e )
+      {
+         elog("Error exporting snapshot: ${e}", ("e", e.to_detail_string()));
+         exit(EXIT_FAILURE);
+      }
+   }
+
    ilog( "Started on blockchain with ${n} blocks", ("n", my->db.head_block_num()) );
    on_sync();
 
+   my->start_signature_recovery();
    my->start_write_processing();
 }
 
@@ -528,6 +1035,7 @@ void chain_plugin::plugin_shutdown()
 {
    ilog("closing chain database");
    my->stop_write_processing();
+   my->stop_signature_recovery();
    my->db.close();
    ilog("database closed successfully");
 }
@@ -543,6 +1051,8 @@ bool chain_plugin::accept_block( const voilk::chain::signed_block& block, bool c
 
    check_time_in_block( block );
 
+   my->recover_signatures( block );
+
    boost::promise< void > prom;
    write_context cxt;
    cxt.req_ptr = &block;
@@ -560,9 +1070,12 @@ bool chain_plugin::accept_block( const voilk::chain::signed_block& block, bool c
 
 void chain_plugin::accept_transaction( const voilk::chain::signed_transaction& trx )
 {
+   my->prevalidate_transaction( trx );
+
    boost::promise< void > prom;
    write_context cxt;
    cxt.req_ptr = &trx;
+   cxt.skip = database::skip_validate;
    cxt.prom_ptr = &prom;
 
    my->write_queue.push( &cxt );
@@ -607,6 +1120,17 @@ int16_t chain_plugin::set_write_lock_hold_time( int16_t new_time )
    return old_time;
 }
 
+write_queue_stats chain_plugin::get_write_queue_stats() const
+{
+   write_queue_stats stats;
+   my->write_queue.get_stats( stats );
+   stats.write_slice_us = my->write_slice_us;
+   stats.reader_yields = my->reader_yields;
+   stats.queue_wait = my->write_wait_histogram.get_stats();
+   stats.lock_hold = my->lock_hold_histogram.get_stats();
+   return stats;
+}
+
 bool chain_plugin::block_is_on_preferred_chain(const voilk::chain::block_id_type& block_id )
 {
    // If it's not known, it's not preferred.
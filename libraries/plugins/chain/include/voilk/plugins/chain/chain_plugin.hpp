@@ -2,6 +2,8 @@
 #include <appbase/application.hpp>
 #include <voilk/chain/database.hpp>
 
+#include <chainbase/instrumentation.hpp>
+
 #include <boost/signals2.hpp>
 
 #define VOILK_CHAIN_PLUGIN_NAME "chain"
@@ -16,6 +18,21 @@ using namespace voilk::chain;
 
 namespace bfs = boost::filesystem;
 
+/**
+ * The state of the queue of writes waiting for the write thread. The histograms use the log2 buckets of
+ * chainbase::lock_wait_stats, queue_depth counts queued writes instead of microseconds.
+ */
+struct write_queue_stats
+{
+   uint32_t                     queued_blocks = 0;
+   uint32_t                     queued_transactions = 0;
+   int64_t                      write_slice_us = 0;  ///< How long the write thread keeps writing while readers wait
+   uint64_t                     reader_yields = 0;   ///< Times the write lock was released early for readers
+   chainbase::lock_wait_stats   queue_depth;         ///< Writes queued, sampled whenever one is added
+   chainbase::lock_wait_stats   queue_wait;          ///< Time writes spent in the queue
+   chainbase::lock_wait_stats   lock_hold;           ///< Time the write lock was held each time it was taken
+};
+
 class chain_plugin : public plugin< chain_plugin >
 {
 public:
@@ -55,6 +72,8 @@ public:
     */
    int16_t set_write_lock_hold_time( int16_t new_time );
 
+   write_queue_stats get_write_queue_stats() const;
+
    bool block_is_on_preferred_chain( const voilk::chain::block_id_type& block_id );
 
    void check_time_in_block( const voilk::chain::signed_block& block );
@@ -108,3 +127,6 @@ private:
 };
 
 } } } // voilk::plugins::chain
+
+FC_REFLECT( voilk::plugins::chain::write_queue_stats,
+            (queued_blocks)(queued_transactions)(write_slice_us)(reader_yields)(queue_depth)(queue_wait)(lock_hold) )
@@ -0,0 +1,64 @@
+#include <voilk/plugins/json_rpc/call_pool.hpp>
+
+namespace voilk { namespace plugins { namespace json_rpc {
+
+api_call_pool::api_call_pool( const std::string& name, uint32_t max_running, uint32_t max_queue )
+   : _name( name ), _max_running( max_running ), _max_queue( max_queue ) {}
+
+bool api_call_pool::run( const std::function< void() >& call )
+{
+   {
+      std::unique_lock< std::mutex > lock( _mutex );
+      if( _running + _queued >= _max_running + _max_queue )
+      {
+         ++_rejected;
+         return false;
+      }
+
+      ++_queued;
+      _call_finished.wait( lock, [this]() { return _running < _max_running; } );
+      --_queued;
+      ++_running;
+   }
+
+   try
+   {
+      call();
+   }
+   catch( ... )
+   {
+      finish();
+      throw;
+   }
+
+   finish();
+   return true;
+}
+
+void api_call_pool::finish()
+{
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+      --_running;
+      ++_executed;
+   }
+
+   _call_finished.notify_one();
+}
+
+api_call_pool_stats api_call_pool::get_stats()const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   api_call_pool_stats stats;
+   stats.name = _name;
+   stats.max_running = _max_running;
+   stats.max_queue = _max_queue;
+   stats.running = _running;
+   stats.queued = _queued;
+   stats.executed = _executed;
+   stats.rejected = _rejected;
+   return stats;
+}
+
+} } } // voilk::plugins::json_rpc
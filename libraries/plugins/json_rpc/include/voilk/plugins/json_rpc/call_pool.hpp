@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace voilk { namespace plugins { namespace json_rpc {
+
+struct api_call_pool_stats
+{
+   std::string    name;
+   uint32_t       max_running = 0;
+   uint32_t       max_queue = 0;
+   uint32_t       running = 0;
+   uint32_t       queued = 0;
+   uint64_t       executed = 0;
+   uint64_t       rejected = 0;      ///< Calls refused because max_running + max_queue calls were already admitted
+};
+
+/**
+ * Limits how many of the API calls mapped to it run at a time, so slow methods cannot take every webserver
+ * thread that serves the others.
+ *
+ * Calls run on the thread that received them. At most max_running run at a time and up to max_queue more
+ * wait for one of them to finish, further calls are refused at once instead of waiting behind them. A waiting
+ * call holds its thread, so the pool only protects the other APIs while max_running + max_queue stays below
+ * the number of threads receiving calls.
+ */
+class api_call_pool
+{
+   public:
+      api_call_pool( const std::string& name, uint32_t max_running, uint32_t max_queue );
+
+      const std::string& name()const { return _name; }
+
+      /**
+       * Runs call on the calling thread once it is admitted and rethrows what it throws. Returns false
+       * without running call when the pool is saturated.
+       */
+      bool run( const std::function< void() >& call );
+
+      api_call_pool_stats get_stats()const;
+
+   private:
+      void finish();
+
+      std::string                _name;
+      uint32_t                   _max_running;
+      uint32_t                   _max_queue;
+
+      mutable std::mutex         _mutex;
+      std::condition_variable    _call_finished;
+      uint32_t                   _running = 0;
+      uint32_t                   _queued = 0;
+      uint64_t                   _executed = 0;
+      uint64_t                   _rejected = 0;
+};
+
+} } } // voilk::plugins::json_rpc
+
+FC_REFLECT( voilk::plugins::json_rpc::api_call_pool_stats,
+   (name)(max_running)(max_queue)(running)(queued)(executed)(rejected) )
@@ -4,6 +4,7 @@
 
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/json_stream.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/exception/exception.hpp>
 
@@ -52,6 +53,7 @@
 #define JSON_RPC_NO_PARAMS          (-33331)
 #define JSON_RPC_PARSE_PARAMS_ERROR (-32002)
 #define JSON_RPC_ERROR_DURING_CALL  (-32003)
+#define JSON_RPC_SERVER_BUSY        (-32004)
 
 namespace voilk { namespace plugins { namespace json_rpc {
 
@@ -65,6 +67,13 @@ using namespace appbase;
  */
 typedef std::function< fc::variant(const fc::variant&) > api_method;
 
+/**
+ * @brief Internal type used to bind api methods
+ * to names, writing the result as json without
+ * building a variant.
+ */
+typedef std::function< void(const fc::variant&, fc::json_stream&) > api_method_stream;
+
 /**
  * @brief An API, containing APIs and Methods
  *
@@ -100,9 +109,13 @@ class json_rpc_plugin : public appbase::plugin< json_rpc_plugin >
       virtual void plugin_startup() override;
       virtual void plugin_shutdown() override;
 
-      void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
+      void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig,
+         const api_method_stream& stream = api_method_stream() );
       string call( const string& body );
 
+      /** Drops all cached API results, must be called whenever the head block changes or a transaction is applied */
+      void invalidate_cache( uint32_t head_block_num );
+
    private:
       std::unique_ptr< detail::json_rpc_plugin_impl > my;
 };
@@ -130,7 +143,11 @@ namespace detail {
                {
                   return fc::variant( (plugin.*method)( args.as< Args >(), true ) );
                },
-               api_method_signature{ fc::variant( Args() ), fc::variant( Ret() ) } );
+               api_method_signature{ fc::variant( Args() ), fc::variant( Ret() ) },
+               [&plugin,method]( const fc::variant& args, fc::json_stream& out )
+               {
+                  out.write( (plugin.*method)( args.as< Args >(), true ) );
+               } );
          }
 
       private:
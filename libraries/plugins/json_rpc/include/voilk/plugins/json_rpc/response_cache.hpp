@@ -0,0 +1,92 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace voilk { namespace plugins { namespace json_rpc {
+
+struct api_response_cache_stats
+{
+   bool        enabled = false;
+   uint32_t    head_block_num = 0;
+   uint64_t    entries = 0;
+   uint64_t    bytes = 0;
+   uint64_t    max_bytes = 0;
+   uint64_t    hits = 0;
+   uint64_t    misses = 0;
+   uint64_t    inserts = 0;
+   uint64_t    evictions = 0;      ///< Entries dropped to stay under max_bytes
+   uint64_t    expirations = 0;    ///< Entries dropped because their ttl passed
+   uint64_t    invalidations = 0;  ///< Head block changes and applied transactions that emptied the cache
+};
+
+/**
+ * A cache of the json results of read only API calls, valid until the head block or the pending state changes.
+ *
+ * Only whitelisted methods are cached. Each one can have a ttl that drops its results before the next
+ * block, a ttl of zero keeps them until the cache is invalidated. Least recently used results are evicted
+ * to keep the total size under max_bytes.
+ *
+ * A result may only be stored if no block or transaction was applied while it was computed. Callers take the generation
+ * before the call and pass it to put, which drops the result when the cache was invalidated since.
+ */
+class api_response_cache
+{
+   public:
+      void configure( uint64_t max_bytes, const std::map< std::string, fc::microseconds >& methods );
+
+      bool enabled()const { return _max_bytes > 0; }
+
+      const std::map< std::string, fc::microseconds >& methods()const { return _methods; }
+
+      /** Returns the ttl of method, or null when its results are not cached */
+      const fc::microseconds* find_method( const std::string& method )const;
+
+      uint64_t generation()const { return _generation.load( std::memory_order_acquire ); }
+
+      std::shared_ptr< const std::string > get( const std::string& key );
+      void put( const std::string& key, std::string json, uint64_t generation, const fc::microseconds& ttl );
+
+      /**
+       * Drops every entry, called whenever a block becomes the head block, including during fork switches,
+       * and after each applied transaction, which changes the pending state
+       */
+      void invalidate( uint32_t head_block_num );
+
+      api_response_cache_stats get_stats()const;
+
+   private:
+      struct entry
+      {
+         std::string                            key;
+         std::shared_ptr< const std::string >   json;
+         fc::time_point                         expiration;
+         uint64_t                               bytes = 0;
+      };
+
+      typedef std::list< entry > lru_list;
+
+      void erase( lru_list::iterator itr );
+
+      std::map< std::string, fc::microseconds >                _methods;
+      uint64_t                                                 _max_bytes = 0;
+
+      mutable std::mutex                                       _mutex;
+      lru_list                                                 _lru;       ///< Most recently used first
+      std::unordered_map< std::string, lru_list::iterator >    _index;
+      std::atomic< uint64_t >                                  _generation{ 0 };
+      api_response_cache_stats                                 _stats;
+};
+
+} } } // voilk::plugins::json_rpc
+
+FC_REFLECT( voilk::plugins::json_rpc::api_response_cache_stats,
+   (enabled)(head_block_num)(entries)(bytes)(max_bytes)(hits)(misses)(inserts)(evictions)(expirations)(invalidations) )
@@ -1,9 +1,13 @@
 #include <voilk/plugins/json_rpc/json_rpc_plugin.hpp>
 #include <voilk/plugins/json_rpc/utility.hpp>
+#include <voilk/plugins/json_rpc/response_cache.hpp>
+#include <voilk/plugins/json_rpc/call_pool.hpp>
 
 #include <voilk/plugins/statsd/utility.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
 
 #include <fc/log/logger_config.hpp>
 #include <fc/exception/exception.hpp>
@@ -12,6 +16,11 @@
 
 #include <chainbase/chainbase.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #define ENABLE_JSON_RPC_LOG
 
 namespace voilk { namespace plugins { namespace json_rpc {
@@ -37,8 +46,41 @@ namespace detail
       fc::optional< fc::variant >      result;
       fc::optional< json_rpc_error >   error;
       fc::variant                      id;
+
+      /** The result already written as json, set instead of result when the method was serialized directly */
+      fc::optional< std::string >      raw_result;
    };
 
+   /**
+    * Writes a response the same way as fc::json::to_string( response ), splicing in raw_result when it is set
+    */
+   void write_response( fc::json_stream& s, const json_rpc_response& response )
+   {
+      s.write_raw( "{\"jsonrpc\":", 11 );
+      s.write_string( response.jsonrpc );
+
+      if( response.raw_result.valid() )
+      {
+         s.write_raw( ",\"result\":", 10 );
+         s.write_raw( *response.raw_result );
+      }
+      else if( response.result.valid() )
+      {
+         s.write_raw( ",\"result\":", 10 );
+         s.write_variant( *response.result );
+      }
+
+      if( response.error.valid() )
+      {
+         s.write_raw( ",\"error\":", 9 );
+         s.write( *response.error );
+      }
+
+      s.write_raw( ",\"id\":", 6 );
+      s.write_variant( response.id );
+      s.write_raw( '}' );
+   }
+
    typedef void_type             get_methods_args;
    typedef vector< string >      get_methods_return;
 
@@ -49,6 +91,12 @@ namespace detail
 
    typedef api_method_signature  get_signature_return;
 
+   typedef void_type                get_cache_stats_args;
+   typedef api_response_cache_stats get_cache_stats_return;
+
+   typedef void_type                      get_call_pool_stats_args;
+   typedef vector< api_call_pool_stats >  get_call_pool_stats_return;
+
    class json_rpc_logger
    {
    public:
@@ -97,6 +145,8 @@ namespace detail
 
       void log(const fc::variant_object& request, json_rpc_response& response)
       {
+         std::lock_guard< std::mutex > lock( log_mutex );
+
          fc::path file(dir_name);
          bool error = response.error.valid();
          std::string counter_str;
@@ -125,6 +175,25 @@ namespace detail
        */
       uint32_t counter = 0;
       uint32_t errors = 0;
+      std::mutex log_mutex;
+   };
+
+   /**
+    * The calls of one batch request. Workers claim calls by index, so responses keep the order of the
+    * requests however the calls are spread over threads.
+    */
+   struct json_rpc_batch
+   {
+      json_rpc_batch( const vector< fc::variant >& m ) : messages( m ), count( m.size() ), responses( m.size() ) {}
+
+      const vector< fc::variant >&     messages;   ///< Only valid while calls are left to claim
+      const size_t                     count;
+      vector< json_rpc_response >      responses;
+
+      std::atomic< size_t >            next_call{ 0 };
+      size_t                           done_calls = 0;
+      std::mutex                       done_mutex;
+      std::condition_variable          done_cv;
    };
 
    class json_rpc_plugin_impl
@@ -133,15 +202,23 @@ namespace detail
          json_rpc_plugin_impl();
          ~json_rpc_plugin_impl();
 
-         void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
+         void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig,
+            const api_method_stream& stream );
 
          api_method* find_api_method( std::string api, std::string method );
          api_method* process_params( string method, const fc::variant_object& request, fc::variant& func_args, string* method_name );
          void rpc_id( const fc::variant_object& request, json_rpc_response& response );
          void rpc_jsonrpc( const fc::variant_object& request, json_rpc_response& response );
          json_rpc_response rpc( const fc::variant& message );
+         vector< json_rpc_response > rpc_batch( const vector< fc::variant >& messages );
+         void run_batch_calls( const std::shared_ptr< json_rpc_batch >& batch );
+
+         /** Returns the pool serving method_name, a pool given the method wins over one given its api */
+         api_call_pool* find_call_pool( const string& method_name );
 
          void initialize();
+         void start_batch_threads( uint32_t num_threads );
+         void stop_batch_threads();
 
          void log(const fc::variant_object& request, json_rpc_response& response)
          {
@@ -151,18 +228,63 @@ namespace detail
 
          DECLARE_API(
             (get_methods)
-            (get_signature) )
+            (get_signature)
+            (get_cache_stats)
+            (get_call_pool_stats) )
 
          map< string, api_description >                     _registered_apis;
          vector< string >                                   _methods;
          map< string, map< string, api_method_signature > > _method_sigs;
+         map< string, api_method_stream >                   _stream_methods;
          std::unique_ptr< json_rpc_logger >                 _logger;
+         bool                                               _direct_serialization = true;
+         api_response_cache                                 _cache;
+
+         uint32_t                                           _batch_concurrency = 1;
+         boost::asio::io_service                            _batch_ios;
+         std::unique_ptr< boost::asio::io_service::work >   _batch_work;
+         boost::thread_group                                _batch_threads;
+
+         vector< std::unique_ptr< api_call_pool > >         _call_pools;
+         map< string, api_call_pool* >                      _call_pool_index;   ///< api or api.method to its pool
    };
 
    json_rpc_plugin_impl::json_rpc_plugin_impl() {}
-   json_rpc_plugin_impl::~json_rpc_plugin_impl() {}
 
-   void json_rpc_plugin_impl::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig )
+   json_rpc_plugin_impl::~json_rpc_plugin_impl()
+   {
+      stop_batch_threads();
+   }
+
+   void json_rpc_plugin_impl::start_batch_threads( uint32_t num_threads )
+   {
+      _batch_work.reset( new boost::asio::io_service::work( _batch_ios ) );
+
+      for( uint32_t i = 0; i < num_threads; ++i )
+         _batch_threads.create_thread( boost::bind( &boost::asio::io_service::run, &_batch_ios ) );
+   }
+
+   void json_rpc_plugin_impl::stop_batch_threads()
+   {
+      _batch_work.reset();
+      _batch_ios.stop();
+      _batch_threads.join_all();
+   }
+
+   api_call_pool* json_rpc_plugin_impl::find_call_pool( const string& method_name )
+   {
+      if( _call_pool_index.empty() )
+         return nullptr;
+
+      auto itr = _call_pool_index.find( method_name );
+      if( itr == _call_pool_index.end() )
+         itr = _call_pool_index.find( method_name.substr( 0, method_name.find( '.' ) ) );
+
+      return itr != _call_pool_index.end() ? itr->second : nullptr;
+   }
+
+   void json_rpc_plugin_impl::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig,
+      const api_method_stream& stream )
    {
       _registered_apis[ api_name ][ method_name ] = api;
       _method_sigs[ api_name ][ method_name ] = sig;
@@ -170,6 +292,9 @@ namespace detail
       std::stringstream canonical_name;
       canonical_name << api_name << '.' << method_name;
       _methods.push_back( canonical_name.str() );
+
+      if( stream )
+         _stream_methods[ canonical_name.str() ] = stream;
    }
 
    void json_rpc_plugin_impl::initialize()
@@ -199,6 +324,23 @@ namespace detail
       return method_itr->second;
    }
 
+   get_cache_stats_return json_rpc_plugin_impl::get_cache_stats( const get_cache_stats_args& args, bool lock )
+   {
+      FC_UNUSED( lock )
+      return _cache.get_stats();
+   }
+
+   get_call_pool_stats_return json_rpc_plugin_impl::get_call_pool_stats( const get_call_pool_stats_args& args, bool lock )
+   {
+      FC_UNUSED( lock )
+      get_call_pool_stats_return stats;
+
+      for( const auto& pool : _call_pools )
+         stats.push_back( pool->get_stats() );
+
+      return stats;
+   }
+
    api_method* json_rpc_plugin_impl::find_api_method( std::string api, std::string method )
    {
       STATSD_START_TIMER( "jsonrpc", "overhead", "find_api_method", 1.0f );
@@ -306,7 +448,70 @@ namespace detail
                      if( call )
                      {
                         STATSD_START_TIMER( "jsonrpc", "api", method_name, 1.0f );
-                        response.result = (*call)( func_args );
+
+                        // The logger saves the result variant, so it needs the result built the old way
+                        const fc::microseconds* cache_ttl = _logger ? nullptr : _cache.find_method( method_name );
+                        string cache_key;
+
+                        std::shared_ptr< const std::string > cached;
+
+                        if( cache_ttl )
+                        {
+                           cache_key = method_name + ' ' + fc::json::to_string( func_args );
+                           cached = _cache.get( cache_key );
+
+                           if( cached )
+                           {
+                              STATSD_INCREMENT( "jsonrpc", "cache", "hit", 1.0f );
+                           }
+                           else
+                           {
+                              STATSD_INCREMENT( "jsonrpc", "cache", "miss", 1.0f );
+                           }
+                        }
+
+                        if( cached )
+                        {
+                           response.raw_result = *cached;
+                        }
+                        else
+                        {
+                           auto execute = [&]()
+                           {
+                              // Taken before the call, a block applied while the call runs keeps its result out of the cache
+                              uint64_t cache_generation = _cache.generation();
+                              auto stream_itr = ( _direct_serialization && !_logger ) ? _stream_methods.find( method_name ) : _stream_methods.end();
+
+                              if( stream_itr != _stream_methods.end() )
+                              {
+                                 std::string raw_result;
+                                 fc::json_stream out( raw_result );
+                                 stream_itr->second( func_args, out );
+                                 response.raw_result = std::move( raw_result );
+                              }
+                              else
+                              {
+                                 response.result = (*call)( func_args );
+                              }
+
+                              if( cache_ttl )
+                                 _cache.put( cache_key, response.raw_result.valid() ? *response.raw_result : fc::json::to_string( *response.result ),
+                                             cache_generation, *cache_ttl );
+                           };
+
+                           api_call_pool* pool = find_call_pool( method_name );
+
+                           if( pool == nullptr )
+                           {
+                              execute();
+                           }
+                           else if( !pool->run( execute ) )
+                           {
+                              STATSD_INCREMENT( "jsonrpc", "pool", pool->name() + ".rejected", 1.0f );
+                              response.error = json_rpc_error( JSON_RPC_SERVER_BUSY,
+                                 "Server busy, too many " + method_name + " calls are in progress. Please try again later." );
+                           }
+                        }
                      }
                   }
                   catch( chainbase::lock_exception& e )
@@ -397,6 +602,49 @@ namespace detail
 
       return response;
    }
+
+   vector< json_rpc_response > json_rpc_plugin_impl::rpc_batch( const vector< fc::variant >& messages )
+   {
+      STATSD_START_TIMER( "jsonrpc", "overhead", "batch", 1.0f );
+
+      size_t concurrency = std::min< size_t >( std::max< uint32_t >( _batch_concurrency, 1 ), messages.size() );
+      if( concurrency == 1 || _batch_threads.size() == 0 )
+      {
+         vector< json_rpc_response > responses;
+         responses.reserve( messages.size() );
+
+         for( auto& m : messages )
+            responses.push_back( rpc( m ) );
+
+         return responses;
+      }
+
+      auto batch = std::make_shared< json_rpc_batch >( messages );
+
+      /* The calling thread works on the batch too, so the batch completes even when every batch thread
+       * is busy with other requests. Helpers that start after all calls were claimed return immediately. */
+      for( size_t i = 1; i < concurrency; ++i )
+         _batch_ios.post( [this, batch]() { run_batch_calls( batch ); } );
+
+      run_batch_calls( batch );
+
+      std::unique_lock< std::mutex > lock( batch->done_mutex );
+      batch->done_cv.wait( lock, [&batch]() { return batch->done_calls == batch->count; } );
+
+      return std::move( batch->responses );
+   }
+
+   void json_rpc_plugin_impl::run_batch_calls( const std::shared_ptr< json_rpc_batch >& batch )
+   {
+      for( size_t i = batch->next_call++; i < batch->count; i = batch->next_call++ )
+      {
+         batch->responses[i] = rpc( batch->messages[i] );
+
+         std::lock_guard< std::mutex > lock( batch->done_mutex );
+         if( ++batch->done_calls == batch->count )
+            batch->done_cv.notify_all();
+      }
+   }
 }
 
 using detail::json_rpc_error;
@@ -410,6 +658,23 @@ void json_rpc_plugin::set_program_options( options_description& , options_descri
 {
    cfg.add_options()
       ("log-json-rpc", bpo::value< string >(), "json-rpc log directory name.")
+      ("rpc-batch-threads", bpo::value< uint32_t >()->default_value( std::max( std::thread::hardware_concurrency(), 2u ) ),
+         "Number of threads executing the calls of batch requests, shared by all batches. 0 executes batches on the thread that received them." )
+      ("rpc-batch-concurrency", bpo::value< uint32_t >()->default_value( 8 ),
+         "Maximum number of calls of a single batch request executed at the same time." )
+      ("json-rpc-direct-serialization", bpo::value< bool >()->default_value( true ),
+         "Write the results of API calls straight to json instead of converting them to a variant first." )
+      ("rpc-cache-size-mb", bpo::value< uint64_t >()->default_value( 0 ),
+         "Memory used to cache the results of the methods given by rpc-cache-method until the next block, 0 disables the cache." )
+      ("rpc-cache-method", bpo::value< vector< string > >()->composing(),
+         "api.method whose results are cached, optionally followed by :ttl with the number of milliseconds a result may be served, "
+         "e.g. condenser_api.get_dynamic_global_properties:1000. Without a ttl results are served until the next block." )
+      ("rpc-call-pool", bpo::value< vector< string > >()->composing(),
+         "Limits the calls to some APIs or methods, as name:running:queue:api[.method][,api[.method]...], "
+         "e.g. history:4:16:account_history_api,condenser_api.get_account_history. At most running calls execute at a time "
+         "and up to queue more wait for them, further calls fail with a server busy error. Calls execute and wait on the "
+         "webserver thread that received them, keep running + queue below webserver-thread-pool-size to leave threads to "
+         "the other APIs." )
       ;
 }
 
@@ -428,18 +693,97 @@ void json_rpc_plugin::plugin_initialize( const variables_map& options )
       fc::create_directories(p);
       my->_logger.reset(new json_rpc_logger(dir_name));
    }
+
+   my->_direct_serialization = options.at( "json-rpc-direct-serialization" ).as< bool >();
+
+   auto cache_size = options.at( "rpc-cache-size-mb" ).as< uint64_t >();
+   if( cache_size > 0 && options.count( "rpc-cache-method" ) )
+   {
+      FC_ASSERT( !my->_logger, "The rpc cache cannot be used together with log-json-rpc" );
+
+      map< string, fc::microseconds > methods;
+      for( const auto& m : options.at( "rpc-cache-method" ).as< vector< string > >() )
+      {
+         vector< string > parts;
+         boost::split( parts, m, boost::is_any_of( ":" ) );
+         FC_ASSERT( parts.size() <= 2 && parts[0].find( '.' ) != string::npos, "Invalid rpc-cache-method ${m}, expected api.method[:ttl]", ("m", m) );
+
+         methods[ parts[0] ] = fc::milliseconds( parts.size() == 2 ? fc::to_int64( parts[1] ) : 0 );
+      }
+
+      ilog( "Caching the results of ${n} API methods in up to ${s} MB", ("n", methods.size())("s", cache_size) );
+      my->_cache.configure( cache_size * 1024 * 1024, methods );
+   }
+
+   my->_batch_concurrency = options.at( "rpc-batch-concurrency" ).as< uint32_t >();
+   FC_ASSERT( my->_batch_concurrency > 0, "rpc-batch-concurrency must be greater than 0" );
+
+   if( options.count( "rpc-call-pool" ) )
+   {
+      for( const auto& p : options.at( "rpc-call-pool" ).as< vector< string > >() )
+      {
+         vector< string > parts;
+         boost::split( parts, p, boost::is_any_of( ":" ) );
+         FC_ASSERT( parts.size() == 4, "Invalid rpc-call-pool ${p}, expected name:running:queue:api[.method][,api[.method]...]", ("p", p) );
+
+         auto running = fc::to_uint64( parts[1] );
+         auto queue = fc::to_uint64( parts[2] );
+         FC_ASSERT( running > 0, "rpc-call-pool ${n} needs to run at least one call", ("n", parts[0]) );
+
+         my->_call_pools.emplace_back( new api_call_pool( parts[0], running, queue ) );
+
+         vector< string > targets;
+         boost::split( targets, parts[3], boost::is_any_of( "," ) );
+         for( const auto& t : targets )
+         {
+            FC_ASSERT( !t.empty(), "Invalid rpc-call-pool ${p}, empty api name", ("p", p) );
+            FC_ASSERT( my->_call_pool_index.emplace( t, my->_call_pools.back().get() ).second,
+               "${t} is assigned to more than one rpc-call-pool", ("t", t) );
+         }
+
+         ilog( "Running up to ${n} calls to ${t} at a time, queueing up to ${q} more", ("t", parts[3])("n", running)("q", queue) );
+      }
+   }
+
+   auto batch_threads = options.at( "rpc-batch-threads" ).as< uint32_t >();
+   if( my->_batch_concurrency > 1 && batch_threads > 0 )
+   {
+      ilog( "Executing batch requests on ${t} threads with up to ${c} calls per batch at a time", ("t", batch_threads)("c", my->_batch_concurrency) );
+      my->start_batch_threads( batch_threads );
+   }
 }
 
 void json_rpc_plugin::plugin_startup()
 {
    std::sort( my->_methods.begin(), my->_methods.end() );
+
+   for( const auto& m : my->_cache.methods() )
+      FC_ASSERT( std::binary_search( my->_methods.begin(), my->_methods.end(), m.first ), "Cached method ${m} does not exist", ("m", m.first) );
+
+   for( const auto& p : my->_call_pool_index )
+   {
+      if( p.first.find( '.' ) != string::npos )
+         FC_ASSERT( std::binary_search( my->_methods.begin(), my->_methods.end(), p.first ),
+            "Method ${m} of rpc-call-pool ${n} does not exist", ("m", p.first)("n", p.second->name()) );
+      else
+         FC_ASSERT( my->_registered_apis.count( p.first ), "API ${a} of rpc-call-pool ${n} does not exist", ("a", p.first)("n", p.second->name()) );
+   }
 }
 
-void json_rpc_plugin::plugin_shutdown() {}
+void json_rpc_plugin::plugin_shutdown()
+{
+   my->stop_batch_threads();
+}
 
-void json_rpc_plugin::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig )
+void json_rpc_plugin::invalidate_cache( uint32_t head_block_num )
 {
-   my->add_api_method( api_name, method_name, api, sig );
+   my->_cache.invalidate( head_block_num );
+}
+
+void json_rpc_plugin::add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig,
+   const api_method_stream& stream )
+{
+   my->add_api_method( api_name, method_name, api, sig, stream );
 }
 
 string json_rpc_plugin::call( const string& message )
@@ -447,21 +791,30 @@ string json_rpc_plugin::call( const string& message )
    STATSD_START_TIMER( "jsonrpc", "overhead", "call", 1.0f );
    try
    {
-      fc::variant v = fc::json::from_string( message );
+      fc::variant v = fc::json::from_string( message, fc::json::fast_parser );
 
       if( v.is_array() )
       {
          vector< fc::variant > messages = v.as< vector< fc::variant > >();
-         vector< json_rpc_response > responses;
 
          if( messages.size() )
          {
-            responses.reserve( messages.size() );
+            auto responses = my->rpc_batch( messages );
+
+            string out;
+            fc::json_stream s( out );
+            s.write_raw( '[' );
 
-            for( auto& m : messages )
-               responses.push_back( my->rpc( m ) );
+            for( size_t i = 0; i < responses.size(); ++i )
+            {
+               if( i )
+                  s.write_raw( ',' );
+
+               detail::write_response( s, responses[i] );
+            }
 
-            return fc::json::to_string( responses );
+            s.write_raw( ']' );
+            return out;
          }
          else
          {
@@ -473,7 +826,10 @@ string json_rpc_plugin::call( const string& message )
       }
       else
       {
-         return fc::json::to_string( my->rpc( v ) );
+         string out;
+         fc::json_stream s( out );
+         detail::write_response( s, my->rpc( v ) );
+         return out;
       }
    }
    catch( fc::exception& e )
@@ -0,0 +1,115 @@
+#include <voilk/plugins/json_rpc/response_cache.hpp>
+
+namespace voilk { namespace plugins { namespace json_rpc {
+
+// Rough cost of an entry besides its key and result, for the list node, the index node and the shared string
+static const uint64_t entry_overhead = 160;
+
+void api_response_cache::configure( uint64_t max_bytes, const std::map< std::string, fc::microseconds >& methods )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   _max_bytes = max_bytes;
+   _methods = methods;
+   _stats.enabled = enabled();
+   _stats.max_bytes = max_bytes;
+}
+
+const fc::microseconds* api_response_cache::find_method( const std::string& method )const
+{
+   if( !enabled() )
+      return nullptr;
+
+   auto itr = _methods.find( method );
+   return itr != _methods.end() ? &itr->second : nullptr;
+}
+
+std::shared_ptr< const std::string > api_response_cache::get( const std::string& key )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   auto itr = _index.find( key );
+   if( itr == _index.end() )
+   {
+      ++_stats.misses;
+      return std::shared_ptr< const std::string >();
+   }
+
+   if( itr->second->expiration <= fc::time_point::now() )
+   {
+      erase( itr->second );
+      ++_stats.expirations;
+      ++_stats.misses;
+      return std::shared_ptr< const std::string >();
+   }
+
+   _lru.splice( _lru.begin(), _lru, itr->second );
+   ++_stats.hits;
+   return itr->second->json;
+}
+
+void api_response_cache::put( const std::string& key, std::string json, uint64_t generation, const fc::microseconds& ttl )
+{
+   uint64_t bytes = key.size() * 2 + json.size() + entry_overhead;
+   if( bytes > _max_bytes )
+      return;
+
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   if( generation != _generation.load( std::memory_order_relaxed ) )
+      return;
+
+   auto existing = _index.find( key );
+   if( existing != _index.end() )
+      erase( existing->second );
+
+   while( _stats.bytes + bytes > _max_bytes )
+   {
+      erase( std::prev( _lru.end() ) );
+      ++_stats.evictions;
+   }
+
+   entry e;
+   e.key = key;
+   e.json = std::make_shared< const std::string >( std::move( json ) );
+   e.expiration = ttl.count() > 0 ? fc::time_point::now() + ttl : fc::time_point::maximum();
+   e.bytes = bytes;
+
+   _lru.push_front( std::move( e ) );
+   _index[ key ] = _lru.begin();
+   _stats.bytes += bytes;
+   ++_stats.entries;
+   ++_stats.inserts;
+}
+
+void api_response_cache::invalidate( uint32_t head_block_num )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   _generation.fetch_add( 1, std::memory_order_release );
+   _stats.head_block_num = head_block_num;
+
+   if( _lru.empty() )
+      return;
+
+   _index.clear();
+   _lru.clear();
+   _stats.entries = 0;
+   _stats.bytes = 0;
+   ++_stats.invalidations;
+}
+
+api_response_cache_stats api_response_cache::get_stats()const
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   return _stats;
+}
+
+void api_response_cache::erase( lru_list::iterator itr )
+{
+   _stats.bytes -= itr->bytes;
+   --_stats.entries;
+   _index.erase( itr->key );
+   _lru.erase( itr );
+}
+
+} } } // voilk::plugins::json_rpc
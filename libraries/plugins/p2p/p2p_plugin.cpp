@@ -2,6 +2,7 @@
 #include <voilk/plugins/p2p/p2p_default_seeds.hpp>
 #include <voilk/plugins/statsd/utility.hpp>
 
+#include <graphene/net/config.hpp>
 #include <graphene/net/node.hpp>
 #include <graphene/net/exceptions.hpp>
 
@@ -21,6 +22,7 @@
 #include <atomic>
 #include <chrono>
 #include <future>
+#include <unordered_map>
 
 using std::string;
 using std::vector;
@@ -39,6 +41,7 @@ using voilk::protocol::block_header;
 using voilk::protocol::signed_block_header;
 using voilk::protocol::signed_block;
 using voilk::protocol::block_id_type;
+using voilk::protocol::signed_transaction;
 
 namespace detail {
 
@@ -95,6 +98,8 @@ public:
    virtual void handle_message( const graphene::net::message& ) override;
    virtual std::vector< graphene::net::item_hash_t > get_block_ids( const std::vector< graphene::net::item_hash_t >&, uint32_t&, uint32_t ) override;
    virtual graphene::net::message get_item( const graphene::net::item_id& ) override;
+   virtual std::vector< std::vector< char > > get_packed_blocks( const graphene::net::item_hash_t&, uint32_t ) override;
+   virtual std::vector< fc::optional< signed_transaction > > find_pending_transactions( const graphene::net::item_hash_t&, const std::vector< uint64_t >& ) override;
    virtual std::vector< graphene::net::item_hash_t > get_blockchain_synopsis( const graphene::net::item_hash_t&, uint32_t ) override;
    virtual void sync_status( uint32_t, uint32_t ) override;
    virtual void connection_count_changed( uint32_t ) override;
@@ -110,6 +115,7 @@ public:
    string user_agent;
    fc::mutable_variant_object config;
    uint32_t max_connections = 0;
+   uint32_t message_decode_threads = GRAPHENE_NET_MESSAGE_DECODE_THREADS;
    bool force_validate = false;
    bool block_producer = false;
    std::atomic_bool   running;
@@ -343,6 +349,55 @@ graphene::net::message p2p_plugin_impl::get_item( const graphene::net::item_id&
    });
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+std::vector< std::vector< char > > p2p_plugin_impl::get_packed_blocks( const graphene::net::item_hash_t& first_block, uint32_t count )
+{ try {
+   return chain.db().with_read_lock( [&]()
+   {
+      std::vector< std::vector< char > > result;
+      uint32_t first_num = block_header::num_from_id( first_block );
+
+      if( chain.db().find_block_id_for_num( first_num ) != first_block )
+         return result;
+
+      result.reserve( count );
+      for( uint32_t num = first_num; num < first_num + count; ++num )
+      {
+         auto data = chain.db().fetch_raw_block_by_number( num );
+         if( data.empty() )
+            break;
+         result.push_back( std::move( data ) );
+      }
+
+      return result;
+   });
+} FC_CAPTURE_AND_RETHROW( (first_block)(count) ) }
+
+std::vector< fc::optional< signed_transaction > > p2p_plugin_impl::find_pending_transactions( const graphene::net::item_hash_t& block_message_hash, const std::vector< uint64_t >& short_transaction_ids )
+{ try {
+   std::vector< fc::optional< signed_transaction > > result( short_transaction_ids.size() );
+
+   std::unordered_map< uint64_t, size_t > index_of_short_id;
+   for( size_t i = 0; i < short_transaction_ids.size(); ++i )
+      index_of_short_id[ short_transaction_ids[i] ] = i;
+
+   chain.db().with_read_lock( [&]()
+   {
+      auto find = [&]( const signed_transaction& trx )
+      {
+         auto itr = index_of_short_id.find( graphene::net::compact_block_message::short_transaction_id( block_message_hash, trx.id() ) );
+         if( itr != index_of_short_id.end() && !result[ itr->second ] )
+            result[ itr->second ] = trx;
+      };
+
+      for( const auto& trx : chain.db()._pending_tx )
+         find( trx );
+      for( const auto& trx : chain.db()._pending_tx_backlog )
+         find( trx );
+   });
+
+   return result;
+} FC_CAPTURE_AND_RETHROW( (block_message_hash) ) }
+
 voilk::protocol::chain_id_type p2p_plugin_impl::get_chain_id() const
 {
    return chain.db().get_chain_id();
@@ -557,6 +612,7 @@ void p2p_plugin::set_program_options( bpo::options_description& cli, bpo::option
       ("p2p-max-connections", bpo::value<uint32_t>(), "Maxmimum number of incoming connections on P2P endpoint.")
       ("seed-node", bpo::value<vector<string>>()->composing(), "The IP address and port of a remote peer to sync with. Deprecated in favor of p2p-seed-node.")
       ("p2p-seed-node", bpo::value<vector<string>>()->composing()->default_value( default_seeds, seed_ss.str() ), "The IP address and port of a remote peer to sync with.")
+      ("p2p-message-decode-threads", bpo::value<uint32_t>()->default_value( GRAPHENE_NET_MESSAGE_DECODE_THREADS ), "Number of threads that hash and unpack received blocks and other large P2P messages. 0 decodes them on the P2P thread.")
       ("p2p-parameters", bpo::value<string>(), ("P2P network parameters. (Default: " + fc::json::to_string(graphene::net::node_configuration()) + " )").c_str() )
       ;
    cli.add_options()
@@ -618,6 +674,8 @@ void p2p_plugin::plugin_initialize(const boost::program_options::variables_map&
       }
    }
 
+   my->message_decode_threads = options.at( "p2p-message-decode-threads" ).as< uint32_t >();
+
    my->force_validate = options.at( "p2p-force-validate" ).as< bool >();
 
    if( !my->force_validate && options.at( "force-validate" ).as< bool >() )
@@ -640,6 +698,7 @@ void p2p_plugin::plugin_startup()
       my->node.reset(new graphene::net::node(my->user_agent));
       my->node->load_configuration(app().data_dir() / "p2p");
       my->node->set_node_delegate( &(*my) );
+      my->node->set_message_decode_threads( my->message_decode_threads );
 
       if( my->endpoint )
       {
@@ -151,7 +151,7 @@ comment_metadata tags_plugin_impl::filter_tags( const comment_object& c, const c
    {
       try
       {
-         meta = fc::json::from_string( to_string( con.json_metadata ) ).as< comment_metadata >();
+         meta = fc::json::from_string( to_string( con.json_metadata ), fc::json::fast_parser ).as< comment_metadata >();
       }
       catch( const fc::exception& e )
       {
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <voilk/chain/database.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/optional.hpp>
+
+#include <boost/asio.hpp>
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace voilk { namespace plugins { namespace webserver {
+
+namespace detail {
+
+   struct asio_with_stub_log : public websocketpp::config::asio
+   {
+         typedef asio_with_stub_log type;
+         typedef asio base;
+
+         typedef base::concurrency_type concurrency_type;
+
+         typedef base::request_type request_type;
+         typedef base::response_type response_type;
+
+         typedef base::message_type message_type;
+         typedef base::con_msg_manager_type con_msg_manager_type;
+         typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+
+         typedef base::alog_type alog_type;
+         typedef base::elog_type elog_type;
+         //typedef websocketpp::log::stub elog_type;
+         //typedef websocketpp::log::stub alog_type;
+
+         typedef base::rng_type rng_type;
+
+         struct transport_config : public base::transport_config
+         {
+            typedef type::concurrency_type concurrency_type;
+            typedef type::alog_type alog_type;
+            typedef type::elog_type elog_type;
+            typedef type::request_type request_type;
+            typedef type::response_type response_type;
+            typedef websocketpp::transport::asio::basic_socket::endpoint
+               socket_type;
+         };
+
+         typedef websocketpp::transport::asio::endpoint< transport_config >
+            transport_type;
+
+         static const long timeout_open_handshake = 0;
+   };
+
+} // detail
+
+using websocket_server_type = websocketpp::server< detail::asio_with_stub_log >;
+
+/**
+ * Pushes new blocks, irreversible blocks and the operations of chosen accounts to websocket clients.
+ *
+ * Clients send webserver.subscribe and webserver.unsubscribe requests with a type, one of new_block,
+ * irreversible_block or account_operation, and the accounts for the latter. Notices are
+ * webserver.notice requests without id carrying the type and the block or operation.
+ *
+ * The write thread only copies what is needed, notices are serialized once on a strand of the thread pool,
+ * which keeps them in order, and the same prepared frame is queued on every subscribed connection. A
+ * connection with more than max_buffered_bytes waiting to be sent is closed instead of letting its
+ * backlog grow without bound, its client has to connect and subscribe again.
+ *
+ * Irreversible block subscribers are sent the blocks kept since they were applied, at most max_recent_blocks
+ * of them. While irreversibility lags further behind they are read back with the block_fetcher instead.
+ */
+class subscription_manager
+{
+   public:
+      typedef websocketpp::connection_hdl connection_hdl;
+
+      /** Reads a block back from the chain, used for irreversible blocks that are no longer held */
+      typedef std::function< fc::optional< protocol::signed_block >( uint32_t ) > block_fetcher;
+
+      subscription_manager( websocket_server_type& server, boost::asio::io_service& ios ) :
+         _server( server ),
+         _strand( ios ) {}
+
+      /** Handles the request if it is a subscription request, returns false to leave it to the api */
+      bool handle_request( connection_hdl hdl, const std::string& payload, std::string& response );
+
+      void remove_connection( connection_hdl hdl );
+
+      void on_pre_apply_block( const voilk::chain::block_notification& note );
+      void on_post_apply_operation( const voilk::chain::operation_notification& note );
+      void on_post_apply_block( const voilk::chain::block_notification& note );
+      void on_irreversible_block( uint32_t block_num, const block_fetcher& fetch_block );
+
+      uint64_t                      max_buffered_bytes = 16 * 1024 * 1024;
+      uint32_t                      max_accounts = 100;
+      uint32_t                      max_recent_blocks = 64;
+
+   private:
+      typedef std::set< connection_hdl, std::owner_less< connection_hdl > > connection_set;
+
+      struct connection_subscriptions
+      {
+         bool                                   new_blocks = false;
+         bool                                   irreversible_blocks = false;
+         fc::flat_set< protocol::account_name_type > accounts;
+      };
+
+      struct account_operation
+      {
+         account_operation( const voilk::chain::operation_notification& note ) :
+            trx_id( note.trx_id ),
+            block( note.block ),
+            trx_in_block( note.trx_in_block ),
+            op_in_trx( note.op_in_trx ),
+            virtual_op( note.virtual_op ),
+            op( note.op ) {}
+
+         protocol::transaction_id_type trx_id;
+         uint32_t                      block = 0;
+         uint32_t                      trx_in_block = 0;
+         uint32_t                      op_in_trx = 0;
+         uint32_t                      virtual_op = 0;
+         protocol::operation           op;
+         std::vector< connection_hdl > subscribers;
+      };
+
+      void subscribe( connection_hdl hdl, const std::string& type, const fc::flat_set< protocol::account_name_type >& accounts );
+      void unsubscribe( connection_hdl hdl, const std::string& type, const fc::flat_set< protocol::account_name_type >& accounts );
+      void unsubscribe_accounts( connection_hdl hdl, connection_subscriptions& subs, const fc::flat_set< protocol::account_name_type >& accounts );
+
+      std::vector< connection_hdl > block_subscribers( bool irreversible );
+      void send( const std::vector< connection_hdl >& hdls, const std::string& type, const fc::variant& result );
+
+      websocket_server_type&        _server;
+      boost::asio::io_service::strand      _strand;
+
+      std::mutex                    _mutex;
+      std::map< connection_hdl, connection_subscriptions, std::owner_less< connection_hdl > > _connections;
+      std::map< protocol::account_name_type, connection_set > _account_subscribers;
+      std::map< uint32_t, std::shared_ptr< const protocol::signed_block > > _recent_blocks;
+
+      std::atomic< uint32_t >       _block_subscribers{ 0 };
+      std::atomic< uint32_t >       _irreversible_subscribers{ 0 };
+      std::atomic< uint32_t >       _account_subscriptions{ 0 };
+
+      // Only used by the write thread
+      bool                          _collecting = false;
+      std::vector< account_operation > _block_ops;
+};
+
+} } } // voilk::plugins::webserver
@@ -0,0 +1,380 @@
+#include <voilk/plugins/webserver/subscription_manager.hpp>
+
+#include <voilk/plugins/json_rpc/json_rpc_plugin.hpp>
+
+#include <voilk/chain/util/impacted.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace voilk { namespace plugins { namespace webserver {
+
+using std::string;
+
+bool subscription_manager::handle_request( connection_hdl hdl, const string& payload, string& response )
+{
+   // Avoid parsing every api call twice
+   if( payload.find( "webserver." ) == string::npos )
+      return false;
+
+   fc::variant request;
+
+   try
+   {
+      request = fc::json::from_string( payload, fc::json::fast_parser );
+   }
+   catch( ... )
+   {
+      return false;
+   }
+
+   if( !request.is_object() )
+      return false;
+
+   const auto& obj = request.get_object();
+   auto method = obj.find( "method" );
+   if( method == obj.end() || !method->value().is_string() )
+      return false;
+
+   const string& method_name = method->value().get_string();
+   bool is_subscribe = method_name == "webserver.subscribe";
+   if( !is_subscribe && method_name != "webserver.unsubscribe" )
+      return false;
+
+   fc::mutable_variant_object result;
+   result( "jsonrpc", "2.0" );
+   if( obj.contains( "id" ) )
+      result( "id", obj[ "id" ] );
+
+   try
+   {
+      FC_ASSERT( obj.contains( "params" ) && obj[ "params" ].is_object(), "params must be an object with a type" );
+      const auto& params = obj[ "params" ].get_object();
+      FC_ASSERT( params.contains( "type" ), "params must be an object with a type" );
+
+      string type = params[ "type" ].as_string();
+      fc::flat_set< protocol::account_name_type > accounts;
+      if( params.contains( "accounts" ) )
+         accounts = params[ "accounts" ].as< fc::flat_set< protocol::account_name_type > >();
+
+      if( is_subscribe )
+         subscribe( hdl, type, accounts );
+      else
+         unsubscribe( hdl, type, accounts );
+
+      result( "result", true );
+   }
+   catch( fc::exception& e )
+   {
+      result( "error", fc::mutable_variant_object( "code", JSON_RPC_INVALID_PARAMS )( "message", e.to_string() ) );
+   }
+
+   response = fc::json::to_string( result );
+   return true;
+}
+
+void subscription_manager::subscribe( connection_hdl hdl, const string& type, const fc::flat_set< protocol::account_name_type >& accounts )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto& subs = _connections[ hdl ];
+
+   if( type == "new_block" )
+   {
+      if( !subs.new_blocks )
+         ++_block_subscribers;
+      subs.new_blocks = true;
+   }
+   else if( type == "irreversible_block" )
+   {
+      if( !subs.irreversible_blocks )
+         ++_irreversible_subscribers;
+      subs.irreversible_blocks = true;
+   }
+   else if( type == "account_operation" )
+   {
+      FC_ASSERT( accounts.size(), "account_operation subscriptions need accounts" );
+
+      size_t new_accounts = 0;
+      for( const auto& a : accounts )
+         new_accounts += subs.accounts.count( a ) ? 0 : 1;
+
+      FC_ASSERT( subs.accounts.size() + new_accounts <= max_accounts,
+         "A connection can subscribe to the operations of at most ${m} accounts", ("m", max_accounts) );
+
+      for( const auto& a : accounts )
+      {
+         if( subs.accounts.insert( a ).second )
+         {
+            _account_subscribers[ a ].insert( hdl );
+            ++_account_subscriptions;
+         }
+      }
+   }
+   else
+   {
+      FC_ASSERT( false, "Unknown subscription type ${t}, expected new_block, irreversible_block or account_operation", ("t", type) );
+   }
+}
+
+void subscription_manager::unsubscribe( connection_hdl hdl, const string& type, const fc::flat_set< protocol::account_name_type >& accounts )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto itr = _connections.find( hdl );
+   if( itr == _connections.end() )
+      return;
+
+   auto& subs = itr->second;
+
+   if( type == "new_block" )
+   {
+      if( subs.new_blocks )
+         --_block_subscribers;
+      subs.new_blocks = false;
+   }
+   else if( type == "irreversible_block" )
+   {
+      if( subs.irreversible_blocks )
+         --_irreversible_subscribers;
+      subs.irreversible_blocks = false;
+   }
+   else if( type == "account_operation" )
+   {
+      // Without accounts, unsubscribe from all of them
+      unsubscribe_accounts( hdl, subs, accounts.size() ? accounts : fc::flat_set< protocol::account_name_type >( subs.accounts ) );
+   }
+   else
+   {
+      FC_ASSERT( false, "Unknown subscription type ${t}, expected new_block, irreversible_block or account_operation", ("t", type) );
+   }
+
+   if( !subs.new_blocks && !subs.irreversible_blocks && subs.accounts.empty() )
+      _connections.erase( itr );
+}
+
+void subscription_manager::unsubscribe_accounts( connection_hdl hdl, connection_subscriptions& subs, const fc::flat_set< protocol::account_name_type >& accounts )
+{
+   for( const auto& a : accounts )
+   {
+      if( !subs.accounts.erase( a ) )
+         continue;
+
+      --_account_subscriptions;
+
+      auto itr = _account_subscribers.find( a );
+      if( itr == _account_subscribers.end() )
+         continue;
+
+      itr->second.erase( hdl );
+      if( itr->second.empty() )
+         _account_subscribers.erase( itr );
+   }
+}
+
+void subscription_manager::remove_connection( connection_hdl hdl )
+{
+   std::lock_guard< std::mutex > lock( _mutex );
+   auto itr = _connections.find( hdl );
+   if( itr == _connections.end() )
+      return;
+
+   if( itr->second.new_blocks )
+      --_block_subscribers;
+   if( itr->second.irreversible_blocks )
+      --_irreversible_subscribers;
+
+   unsubscribe_accounts( hdl, itr->second, fc::flat_set< protocol::account_name_type >( itr->second.accounts ) );
+   _connections.erase( itr );
+}
+
+void subscription_manager::on_pre_apply_block( const voilk::chain::block_notification& note )
+{
+   // Operations of pending transactions are not pushed, only the ones applied as part of a block
+   _block_ops.clear();
+   _collecting = _account_subscriptions > 0;
+}
+
+void subscription_manager::on_post_apply_operation( const voilk::chain::operation_notification& note )
+{
+   if( !_collecting )
+      return;
+
+   fc::flat_set< protocol::account_name_type > impacted;
+   voilk::app::operation_get_impacted_accounts( note.op, impacted );
+
+   std::vector< connection_hdl > subscribers;
+
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+
+      for( const auto& a : impacted )
+      {
+         auto itr = _account_subscribers.find( a );
+         if( itr != _account_subscribers.end() )
+            subscribers.insert( subscribers.end(), itr->second.begin(), itr->second.end() );
+      }
+   }
+
+   if( subscribers.empty() )
+      return;
+
+   // A connection subscribed to several impacted accounts gets the operation once
+   std::sort( subscribers.begin(), subscribers.end(), std::owner_less< connection_hdl >() );
+   subscribers.erase( std::unique( subscribers.begin(), subscribers.end(),
+      []( const connection_hdl& a, const connection_hdl& b ) { return !a.owner_before( b ) && !b.owner_before( a ); } ),
+      subscribers.end() );
+
+   _block_ops.emplace_back( note );
+   _block_ops.back().subscribers = std::move( subscribers );
+}
+
+void subscription_manager::on_post_apply_block( const voilk::chain::block_notification& note )
+{
+   _collecting = false;
+
+   bool new_blocks = _block_subscribers > 0;
+   bool irreversible_blocks = _irreversible_subscribers > 0;
+
+   std::shared_ptr< const protocol::signed_block > block;
+   if( new_blocks || irreversible_blocks )
+      block = std::make_shared< const protocol::signed_block >( note.block );
+
+   if( irreversible_blocks && max_recent_blocks )
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+      // After a fork switch this replaces the block of the abandoned fork
+      _recent_blocks[ note.block_num ] = block;
+
+      // While irreversibility is stalled the oldest blocks are dropped and read back once they become irreversible
+      while( _recent_blocks.size() > max_recent_blocks )
+         _recent_blocks.erase( _recent_blocks.begin() );
+   }
+
+   auto ops = std::make_shared< std::vector< account_operation > >( std::move( _block_ops ) );
+   _block_ops.clear();
+
+   if( !new_blocks && ops->empty() )
+      return;
+
+   fc::time_point_sec timestamp = note.block.timestamp;
+
+   _strand.post( [this, block, ops, timestamp]()
+   {
+      if( block )
+      {
+         auto subscribers = block_subscribers( false );
+         if( subscribers.size() )
+            send( subscribers, "new_block",
+               fc::mutable_variant_object( "block_num", block->block_num() )( "block_id", block->id() )( "block", *block ) );
+      }
+
+      for( const auto& op : *ops )
+      {
+         send( op.subscribers, "account_operation", fc::mutable_variant_object
+            ( "trx_id", op.trx_id )
+            ( "block", op.block )
+            ( "trx_in_block", op.trx_in_block )
+            ( "op_in_trx", op.op_in_trx )
+            ( "virtual_op", op.virtual_op )
+            ( "timestamp", timestamp )
+            ( "op", op.op ) );
+      }
+   });
+}
+
+void subscription_manager::on_irreversible_block( uint32_t block_num, const block_fetcher& fetch_block )
+{
+   std::shared_ptr< const protocol::signed_block > block;
+
+   {
+      std::lock_guard< std::mutex > lock( _mutex );
+
+      if( _irreversible_subscribers == 0 )
+      {
+         _recent_blocks.clear();
+         return;
+      }
+
+      auto itr = _recent_blocks.find( block_num );
+      if( itr != _recent_blocks.end() )
+         block = itr->second;
+
+      _recent_blocks.erase( _recent_blocks.begin(), _recent_blocks.upper_bound( block_num ) );
+   }
+
+   // Blocks applied before the first subscription or dropped from the recent ones are read back
+   if( !block )
+   {
+      auto b = fetch_block( block_num );
+      if( !b )
+         return;
+
+      block = std::make_shared< const protocol::signed_block >( std::move( *b ) );
+   }
+
+   _strand.post( [this, block]()
+   {
+      auto subscribers = block_subscribers( true );
+      if( subscribers.size() )
+         send( subscribers, "irreversible_block",
+            fc::mutable_variant_object( "block_num", block->block_num() )( "block_id", block->id() )( "block", *block ) );
+   });
+}
+
+std::vector< subscription_manager::connection_hdl > subscription_manager::block_subscribers( bool irreversible )
+{
+   std::vector< connection_hdl > result;
+   std::lock_guard< std::mutex > lock( _mutex );
+
+   for( const auto& c : _connections )
+   {
+      if( irreversible ? c.second.irreversible_blocks : c.second.new_blocks )
+         result.push_back( c.first );
+   }
+
+   return result;
+}
+
+void subscription_manager::send( const std::vector< connection_hdl >& hdls, const string& type, const fc::variant& result )
+{
+   fc::mutable_variant_object notice;
+   notice( "jsonrpc", "2.0" )
+         ( "method", "webserver.notice" )
+         ( "params", fc::mutable_variant_object( "type", type )( "result", result ) );
+
+   string json = fc::json::to_string( notice );
+
+   // Frames sent by a server are not masked, so the same prepared message can be queued on every connection
+   auto msg = std::make_shared< detail::asio_with_stub_log::message_type >(
+      detail::asio_with_stub_log::message_type::con_msg_man_ptr(), websocketpp::frame::opcode::text, 0 );
+   msg->set_payload( json );
+   msg->set_header( websocketpp::frame::prepare_header(
+      websocketpp::frame::basic_header( websocketpp::frame::opcode::text, json.size(), true, false ),
+      websocketpp::frame::extended_header( json.size() ) ) );
+   msg->set_prepared( true );
+
+   for( const auto& hdl : hdls )
+   {
+      websocketpp::lib::error_code ec;
+      auto con = _server.get_con_from_hdl( hdl, ec );
+
+      if( ec )
+      {
+         remove_connection( hdl );
+         continue;
+      }
+
+      if( con->get_buffered_amount() + json.size() > max_buffered_bytes )
+      {
+         wlog( "Closing websocket subscriber ${r}, it has ${b} bytes waiting to be sent",
+            ("r", con->get_remote_endpoint())("b", con->get_buffered_amount()) );
+         remove_connection( hdl );
+         con->close( websocketpp::close::status::try_again_later, "Subscriber is too slow", ec );
+         continue;
+      }
+
+      con->send( msg );
+   }
+}
+} } } // voilk::plugins::webserver
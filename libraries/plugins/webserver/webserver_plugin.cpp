@@ -1,16 +1,21 @@
 #include <voilk/plugins/webserver/webserver_plugin.hpp>
+#include <voilk/plugins/webserver/subscription_manager.hpp>
 
 #include <voilk/plugins/chain/chain_plugin.hpp>
 
+#include <voilk/chain/util/signal.hpp>
+
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/io/json.hpp>
 #include <fc/network/resolve.hpp>
+#include <fc/compress/zlib.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
 #include <boost/bind.hpp>
 #include <boost/preprocessor/stringize.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -20,6 +25,7 @@
 #include <websocketpp/logger/stub.hpp>
 #include <websocketpp/logger/syslog.hpp>
 
+#include <cstdlib>
 #include <thread>
 #include <memory>
 #include <iostream>
@@ -39,51 +45,59 @@ typedef uint32_t thread_pool_size_t;
 
 namespace detail {
 
-   struct asio_with_stub_log : public websocketpp::config::asio
-   {
-         typedef asio_with_stub_log type;
-         typedef asio base;
-
-         typedef base::concurrency_type concurrency_type;
-
-         typedef base::request_type request_type;
-         typedef base::response_type response_type;
+enum class content_encoding
+{
+   identity,
+   deflate,
+   gzip
+};
 
-         typedef base::message_type message_type;
-         typedef base::con_msg_manager_type con_msg_manager_type;
-         typedef base::endpoint_msg_manager_type endpoint_msg_manager_type;
+/**
+ * Picks the encoding of a response from the Accept-Encoding header of its request, gzip is preferred
+ * over deflate when both are accepted. Codings with a q value of zero are refused.
+ */
+content_encoding select_content_encoding( const string& accept_encoding )
+{
+   bool gzip = false;
+   bool deflate = false;
 
-         typedef base::alog_type alog_type;
-         typedef base::elog_type elog_type;
-         //typedef websocketpp::log::stub elog_type;
-         //typedef websocketpp::log::stub alog_type;
+   std::vector< string > codings;
+   boost::split( codings, accept_encoding, boost::is_any_of( "," ) );
 
-         typedef base::rng_type rng_type;
+   for( auto& coding : codings )
+   {
+      std::vector< string > params;
+      boost::split( params, coding, boost::is_any_of( ";" ) );
 
-         struct transport_config : public base::transport_config
-         {
-            typedef type::concurrency_type concurrency_type;
-            typedef type::alog_type alog_type;
-            typedef type::elog_type elog_type;
-            typedef type::request_type request_type;
-            typedef type::response_type response_type;
-            typedef websocketpp::transport::asio::basic_socket::endpoint
-               socket_type;
-         };
+      string name = boost::algorithm::to_lower_copy( boost::algorithm::trim_copy( params[0] ) );
+      bool refused = false;
 
-         typedef websocketpp::transport::asio::endpoint< transport_config >
-            transport_type;
+      for( size_t i = 1; i < params.size(); ++i )
+      {
+         string param = boost::algorithm::trim_copy( params[i] );
+         if( param.size() > 2 && ( param[0] == 'q' || param[0] == 'Q' ) && param[1] == '=' )
+            refused = std::strtod( param.c_str() + 2, nullptr ) <= 0;
+      }
 
-         static const long timeout_open_handshake = 0;
-   };
+      if( name == "gzip" || name == "x-gzip" || name == "*" )
+         gzip = gzip || !refused;
+      else if( name == "deflate" )
+         deflate = deflate || !refused;
+   }
 
-using websocket_server_type = websocketpp::server< detail::asio_with_stub_log >;
+   if( gzip )
+      return content_encoding::gzip;
+   if( deflate )
+      return content_encoding::deflate;
+   return content_encoding::identity;
+}
 
 class webserver_plugin_impl
 {
    public:
       webserver_plugin_impl(thread_pool_size_t thread_pool_size) :
-         thread_pool_work( this->thread_pool_ios )
+         thread_pool_work( this->thread_pool_ios ),
+         subscriptions( ws_server, thread_pool_ios )
       {
          for( uint32_t i = 0; i < thread_pool_size; ++i )
             thread_pool.create_thread( boost::bind( &asio::io_service::run, &thread_pool_ios ) );
@@ -92,7 +106,7 @@ class webserver_plugin_impl
       void start_webserver();
       void stop_webserver();
 
-      void handle_ws_message( websocket_server_type*, connection_hdl, detail::websocket_server_type::message_ptr );
+      void handle_ws_message( websocket_server_type*, connection_hdl, websocket_server_type::message_ptr );
       void handle_http_message( websocket_server_type*, connection_hdl );
 
       shared_ptr< std::thread >  http_thread;
@@ -109,8 +123,18 @@ class webserver_plugin_impl
       asio::io_service           thread_pool_ios;
       asio::io_service::work     thread_pool_work;
 
+      subscription_manager       subscriptions;
+
+      /// Responses at least this large are compressed when the client accepts it, 0 never compresses
+      uint32_t                   http_compression_threshold = 1024;
+
       plugins::json_rpc::json_rpc_plugin* api;
       boost::signals2::connection         chain_sync_con;
+      boost::signals2::connection         pre_apply_block_con;
+      boost::signals2::connection         post_apply_operation_con;
+      boost::signals2::connection         post_apply_block_con;
+      boost::signals2::connection         post_apply_transaction_con;
+      boost::signals2::connection         irreversible_block_con;
 };
 
 void webserver_plugin_impl::start_webserver()
@@ -128,6 +152,7 @@ void webserver_plugin_impl::start_webserver()
             ws_server.set_reuse_addr( true );
 
             ws_server.set_message_handler( boost::bind( &webserver_plugin_impl::handle_ws_message, this, &ws_server, _1, _2 ) );
+            ws_server.set_close_handler( [this]( connection_hdl hdl ) { subscriptions.remove_connection( hdl ); } );
 
             if( http_endpoint && http_endpoint == ws_endpoint )
             {
@@ -204,16 +229,23 @@ void webserver_plugin_impl::stop_webserver()
    }
 }
 
-void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, connection_hdl hdl, detail::websocket_server_type::message_ptr msg )
+void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, connection_hdl hdl, websocket_server_type::message_ptr msg )
 {
    auto con = server->get_con_from_hdl( hdl );
 
-   thread_pool_ios.post( [con, msg, this]()
+   thread_pool_ios.post( [con, hdl, msg, this]()
    {
       try
       {
+         string response;
+
          if( msg->get_opcode() == websocketpp::frame::opcode::text )
-            con->send( api->call( msg->get_payload() ) );
+         {
+            if( !subscriptions.handle_request( hdl, msg->get_payload(), response ) )
+               response = api->call( msg->get_payload() );
+
+            con->send( response );
+         }
          else
             con->send( "error: string payload expected" );
       }
@@ -253,7 +285,25 @@ void webserver_plugin_impl::handle_http_message( websocket_server_type* server,
 
       try
       {
-         con->set_body( api->call( body ) );
+         string response = api->call( body );
+
+         if( http_compression_threshold && response.size() >= http_compression_threshold )
+         {
+            auto encoding = select_content_encoding( con->get_request_header( "Accept-Encoding" ) );
+
+            if( encoding != content_encoding::identity )
+            {
+               string compressed = encoding == content_encoding::gzip ? fc::gzip_compress( response ) : fc::zlib_compress( response );
+
+               if( compressed.size() < response.size() )
+               {
+                  response = std::move( compressed );
+                  con->append_header( "Content-Encoding", encoding == content_encoding::gzip ? "gzip" : "deflate" );
+               }
+            }
+         }
+
+         con->set_body( response );
          con->append_header( "Content-Type", "application/json" );
          con->set_status( websocketpp::http::status_code::ok );
       }
@@ -284,6 +334,9 @@ void webserver_plugin_impl::handle_http_message( websocket_server_type* server,
          }
       }
 
+      // Responses differ by Accept-Encoding, and websocketpp closes the connection after every response
+      con->append_header( "Vary", "Accept-Encoding" );
+      con->append_header( "Connection", "close" );
       con->send_http_response();
    });
 }
@@ -301,6 +354,14 @@ void webserver_plugin::set_program_options( options_description&, options_descri
       ("rpc-endpoint", bpo::value< string >(), "Local http and websocket endpoint for webserver requests. Deprecated in favor of webserver-http-endpoint and webserver-ws-endpoint" )
       ("webserver-thread-pool-size", bpo::value<thread_pool_size_t>()->default_value(32),
        "Number of threads used to handle queries. Default: 32.")
+      ("webserver-ws-subscriber-buffer-mb", bpo::value< uint32_t >()->default_value(16),
+       "Megabytes of notices a websocket subscriber may have waiting to be sent before it is disconnected as too slow.")
+      ("webserver-ws-max-subscribed-accounts", bpo::value< uint32_t >()->default_value(100),
+       "Number of accounts a websocket connection may subscribe to the operations of.")
+      ("webserver-ws-recent-blocks", bpo::value< uint32_t >()->default_value(64),
+       "Number of applied blocks kept for irreversible block subscribers, older ones are read back from the chain when they become irreversible.")
+      ("webserver-http-compression-threshold", bpo::value< uint32_t >()->default_value(1024),
+       "Size in bytes from which http responses are gzip or deflate compressed for clients that accept it. 0 disables compression.")
       ;
 }
 
@@ -311,6 +372,11 @@ void webserver_plugin::plugin_initialize( const variables_map& options )
    ilog("configured with ${tps} thread pool size", ("tps", thread_pool_size));
    my.reset(new detail::webserver_plugin_impl(thread_pool_size));
 
+   my->subscriptions.max_buffered_bytes = uint64_t( options.at( "webserver-ws-subscriber-buffer-mb" ).as< uint32_t >() ) * 1024 * 1024;
+   my->subscriptions.max_accounts = options.at( "webserver-ws-max-subscribed-accounts" ).as< uint32_t >();
+   my->subscriptions.max_recent_blocks = options.at( "webserver-ws-recent-blocks" ).as< uint32_t >();
+   my->http_compression_threshold = options.at( "webserver-http-compression-threshold" ).as< uint32_t >();
+
    if( options.count( "webserver-http-endpoint" ) )
    {
       auto http_endpoint = options.at( "webserver-http-endpoint" ).as< string >();
@@ -357,6 +423,45 @@ void webserver_plugin::plugin_startup()
    FC_ASSERT( my->api != nullptr, "Could not find API Register Plugin" );
 
    plugins::chain::chain_plugin* chain = appbase::app().find_plugin< plugins::chain::chain_plugin >();
+
+   // Cached API results are only valid for the head block they were computed at
+   if( chain != nullptr )
+   {
+      my->post_apply_block_con = chain->db().add_post_apply_block_handler( [this]( const voilk::chain::block_notification& note )
+      {
+         my->api->invalidate_cache( note.block_num );
+
+         if( my->ws_endpoint )
+            my->subscriptions.on_post_apply_block( note );
+      }, *this, 0 );
+
+      // and the pending state they saw, which every applied transaction changes, including those of the backlog
+      my->post_apply_transaction_con = chain->db().add_post_apply_transaction_handler( [this, chain]( const voilk::chain::transaction_notification& )
+      {
+         my->api->invalidate_cache( chain->db().head_block_num() );
+      }, *this, 0 );
+   }
+
+   if( chain != nullptr && my->ws_endpoint )
+   {
+      auto& db = chain->db();
+
+      my->pre_apply_block_con = db.add_pre_apply_block_handler( [this]( const voilk::chain::block_notification& note )
+      {
+         my->subscriptions.on_pre_apply_block( note );
+      }, *this, 0 );
+
+      my->post_apply_operation_con = db.add_post_apply_operation_handler( [this]( const voilk::chain::operation_notification& note )
+      {
+         my->subscriptions.on_post_apply_operation( note );
+      }, *this, 0 );
+
+      my->irreversible_block_con = db.add_irreversible_block_handler( [this, &db]( uint32_t block_num )
+      {
+         my->subscriptions.on_irreversible_block( block_num, [&db]( uint32_t num ) { return db.fetch_block_by_number( num ); } );
+      }, *this, 0 );
+   }
+
    if( chain != nullptr && chain->get_state() != appbase::abstract_plugin::started )
    {
       ilog( "Waiting for chain plugin to start" );
@@ -373,7 +478,13 @@ void webserver_plugin::plugin_startup()
 
 void webserver_plugin::plugin_shutdown()
 {
+   voilk::chain::util::disconnect_signal( my->pre_apply_block_con );
+   voilk::chain::util::disconnect_signal( my->post_apply_operation_con );
+   voilk::chain::util::disconnect_signal( my->post_apply_block_con );
+   voilk::chain::util::disconnect_signal( my->post_apply_transaction_con );
+   voilk::chain::util::disconnect_signal( my->irreversible_block_con );
    my->stop_webserver();
 }
 
 } } } // voilk::plugins::webserver
+
@@ -215,10 +215,29 @@ void signed_transaction::verify_authority(
    uint32_t max_membership,
    uint32_t max_account_auths,
    canonical_signature_type canon_type )const
+{ try {
+   verify_authority(
+      get_signature_keys( chain_id, canon_type ),
+      get_active,
+      get_owner,
+      get_posting,
+      max_recursion,
+      max_membership,
+      max_account_auths );
+} FC_CAPTURE_AND_RETHROW( (*this) ) }
+
+void signed_transaction::verify_authority(
+   const flat_set<public_key_type>& signature_keys,
+   const authority_getter& get_active,
+   const authority_getter& get_owner,
+   const authority_getter& get_posting,
+   uint32_t max_recursion,
+   uint32_t max_membership,
+   uint32_t max_account_auths )const
 { try {
    voilk::protocol::verify_authority(
       operations,
-      get_signature_keys( chain_id, canon_type ),
+      signature_keys,
       get_active,
       get_owner,
       get_posting,
@@ -229,6 +248,6 @@ void signed_transaction::verify_authority(
       flat_set< account_name_type >(),
       flat_set< account_name_type >(),
       flat_set< account_name_type >() );
-} FC_CAPTURE_AND_RETHROW( (*this) ) }
+} FC_CAPTURE_AND_RETHROW( (signature_keys) ) }
 
 } } // voilk::protocol
@@ -0,0 +1,118 @@
+#include <voilk/chain/block_log.hpp>
+#include <voilk/chain/compressed_block_log.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+namespace bpo = boost::program_options;
+
+using voilk::chain::block_log;
+using voilk::chain::compressed_block_log;
+using voilk::chain::compressed_block_log_writer;
+
+void compress( const fc::path& input, const fc::path& output, uint32_t blocks_per_chunk, compressed_block_log::compression_type compression )
+{
+   FC_ASSERT( !fc::exists( output ), "Refusing to overwrite ${f}.", ("f", output) );
+
+   block_log log;
+   log.open( input );
+   FC_ASSERT( log.head(), "Block log ${f} is empty.", ("f", input) );
+
+   uint32_t head_num = log.head()->block_num();
+   compressed_block_log_writer writer( output, blocks_per_chunk, compression );
+
+   for( uint32_t block_num = 1; block_num <= head_num; ++block_num )
+   {
+      // Packed bytes are copied straight across, blocks are never deserialized
+      writer.append_raw( block_num, log.read_raw_block_by_num( block_num ) );
+
+      if( block_num % 100000 == 0 )
+         std::cerr << "   " << double( block_num * 100 ) / head_num << "%   " << block_num << " of " << head_num << "\n";
+   }
+
+   writer.close();
+
+   uint64_t in_size = fc::file_size( input );
+   uint64_t out_size = fc::file_size( output );
+   std::cout << "Compressed " << head_num << " blocks from " << in_size << " to " << out_size << " bytes ("
+             << double( out_size * 100 ) / in_size << "%)\n";
+}
+
+void decompress( const fc::path& input, const fc::path& output )
+{
+   FC_ASSERT( !fc::exists( output ), "Refusing to overwrite ${f}.", ("f", output) );
+
+   compressed_block_log in;
+   in.open( input );
+
+   uint32_t head_num = in.head_block_num();
+   block_log log;
+   log.open( output );
+
+   for( uint32_t block_num = 1; block_num <= head_num; ++block_num )
+   {
+      auto b = in.read_block_by_num( block_num );
+      FC_ASSERT( b.valid(), "Block ${n} is missing from ${f}.", ("n", block_num)("f", input) );
+      log.append( *b );
+
+      if( block_num % 100000 == 0 )
+         std::cerr << "   " << double( block_num * 100 ) / head_num << "%   " << block_num << " of " << head_num << "\n";
+   }
+
+   log.flush();
+   std::cout << "Decompressed " << head_num << " blocks\n";
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description opts( "Convert between the block_log and the compressed block log formats" );
+      opts.add_options()
+         ("help,h", "Print this help message and exit.")
+         ("decompress,d", bpo::bool_switch()->default_value(false), "Convert a compressed block log back to a block_log.")
+         ("input,i", bpo::value< std::string >(), "The file to read.")
+         ("output,o", bpo::value< std::string >(), "The file to write. Its .index file is written alongside it.")
+         ("blocks-per-chunk", bpo::value< uint32_t >()->default_value( compressed_block_log::default_blocks_per_chunk ), "Number of blocks compressed together.")
+         ("no-compression", bpo::bool_switch()->default_value(false), "Write chunks uncompressed.")
+         ;
+
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, opts ), options );
+      bpo::notify( options );
+
+      if( options.count( "help" ) || !options.count( "input" ) || !options.count( "output" ) )
+      {
+         std::cout << opts << "\n";
+         return options.count( "help" ) ? 0 : 1;
+      }
+
+      fc::path input( options.at( "input" ).as< std::string >() );
+      fc::path output( options.at( "output" ).as< std::string >() );
+
+      if( options.at( "decompress" ).as< bool >() )
+      {
+         decompress( input, output );
+      }
+      else
+      {
+         compress( input, output, options.at( "blocks-per-chunk" ).as< uint32_t >(),
+            options.at( "no-compression" ).as< bool >() ? compressed_block_log::none : compressed_block_log::zlib );
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   catch( const std::exception& e )
+   {
+      std::cerr << e.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * Sends json rpc requests to the http endpoint of a node from several threads and reports the request rate and
+ * latency percentiles. With --gzip every request accepts a gzip response, which is checked to inflate to valid json.
+ *
+ * Usage: http_load_test host port [threads] [requests per thread] [body] [--gzip]
+ */
+
+#include <fc/compress/zlib.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+using boost::asio::ip::tcp;
+
+// The largest http body websocketpp accepts, the same bound the webserver applies to requests
+const size_t max_response_size = 32000000;
+
+struct http_response
+{
+   uint32_t       status = 0;
+   std::string    content_encoding;
+   std::string    body;
+};
+
+// websocketpp closes the connection after each response, so every request opens its own
+http_response post( asio::io_service& ios, const std::vector< tcp::endpoint >& endpoints, const std::string& host,
+                    const std::string& body, bool gzip )
+{
+   tcp::socket socket( ios );
+   asio::connect( socket, endpoints.begin(), endpoints.end() );
+
+   std::ostringstream request;
+   request << "POST / HTTP/1.1\r\n"
+           << "Host: " << host << "\r\n"
+           << "Content-Type: application/json\r\n"
+           << "Content-Length: " << body.size() << "\r\n";
+   if( gzip )
+      request << "Accept-Encoding: gzip\r\n";
+   request << "Connection: close\r\n\r\n" << body;
+
+   asio::write( socket, asio::buffer( request.str() ) );
+
+   asio::streambuf buffer;
+   boost::system::error_code ec;
+   asio::read( socket, buffer, ec );
+   if( ec && ec != asio::error::eof )
+      throw boost::system::system_error( ec );
+
+   std::string raw( asio::buffers_begin( buffer.data() ), asio::buffers_end( buffer.data() ) );
+   auto header_end = raw.find( "\r\n\r\n" );
+   if( header_end == std::string::npos )
+      throw std::runtime_error( "incomplete http response" );
+
+   http_response response;
+   response.body = raw.substr( header_end + 4 );
+
+   std::vector< std::string > lines;
+   std::string header = raw.substr( 0, header_end );
+   boost::split( lines, header, boost::is_any_of( "\n" ) );
+
+   for( auto& line : lines )
+   {
+      boost::algorithm::trim( line );
+      if( response.status == 0 )
+      {
+         auto space = line.find( ' ' );
+         response.status = space == std::string::npos ? 0 : std::stoul( line.substr( space + 1 ) );
+         continue;
+      }
+
+      auto colon = line.find( ':' );
+      if( colon != std::string::npos && boost::algorithm::iequals( line.substr( 0, colon ), "Content-Encoding" ) )
+         response.content_encoding = boost::algorithm::trim_copy( line.substr( colon + 1 ) );
+   }
+
+   return response;
+}
+
+int main( int argc, char** argv )
+{
+   std::vector< std::string > args;
+   bool gzip = false;
+   for( int i = 1; i < argc; ++i )
+   {
+      if( std::string( argv[i] ) == "--gzip" )
+         gzip = true;
+      else
+         args.push_back( argv[i] );
+   }
+
+   if( args.size() < 2 )
+   {
+      std::cerr << "Usage: " << argv[0] << " host port [threads] [requests per thread] [body] [--gzip]" << std::endl;
+      return 1;
+   }
+
+   std::string host = args[0];
+   std::string port = args[1];
+   uint32_t threads = args.size() > 2 ? std::stoul( args[2] ) : 8;
+   uint32_t requests = args.size() > 3 ? std::stoul( args[3] ) : 1000;
+   std::string body = args.size() > 4 ? args[4] :
+      "{\"jsonrpc\":\"2.0\",\"method\":\"database_api.get_dynamic_global_properties\",\"params\":{},\"id\":1}";
+
+   asio::io_service ios;
+   tcp::resolver resolver( ios );
+   std::vector< tcp::endpoint > endpoints;
+   for( tcp::resolver::iterator itr = resolver.resolve( tcp::resolver::query( host, port ) ); itr != tcp::resolver::iterator(); ++itr )
+      endpoints.push_back( *itr );
+
+   std::vector< std::vector< double > > latencies( threads );
+   std::atomic< uint64_t > errors( 0 );
+   std::atomic< uint64_t > compressed( 0 );
+   std::atomic< uint64_t > bytes( 0 );
+
+   auto start = std::chrono::steady_clock::now();
+
+   std::vector< std::thread > workers;
+   for( uint32_t t = 0; t < threads; ++t )
+   {
+      workers.emplace_back( [&, t]()
+      {
+         asio::io_service thread_ios;
+         latencies[t].reserve( requests );
+
+         for( uint32_t i = 0; i < requests; ++i )
+         {
+            auto sent = std::chrono::steady_clock::now();
+
+            try
+            {
+               auto response = post( thread_ios, endpoints, host, body, gzip );
+               latencies[t].push_back( std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - sent ).count() );
+               bytes += response.body.size();
+
+               if( response.status != 200 )
+               {
+                  ++errors;
+                  continue;
+               }
+
+               if( response.content_encoding == "gzip" )
+               {
+                  ++compressed;
+                  response.body = fc::gzip_decompress( response.body, max_response_size );
+               }
+
+               if( !fc::json::is_valid( response.body ) )
+                  ++errors;
+            }
+            catch( const std::exception& e )
+            {
+               if( errors++ == 0 )
+                  std::cerr << "request failed: " << e.what() << std::endl;
+            }
+         }
+      });
+   }
+
+   for( auto& w : workers )
+      w.join();
+
+   double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+
+   std::vector< double > all;
+   for( const auto& l : latencies )
+      all.insert( all.end(), l.begin(), l.end() );
+   std::sort( all.begin(), all.end() );
+
+   auto percentile = [&]( double p )
+   {
+      return all.empty() ? 0.0 : all[ std::min< size_t >( all.size() - 1, size_t( p * all.size() ) ) ];
+   };
+
+   std::cout << std::fixed << std::setprecision( 2 )
+             << "requests:     " << all.size() << " (" << errors.load() << " errors, " << compressed.load() << " gzip)\n"
+             << "requests/sec: " << all.size() / seconds << "\n"
+             << "body MB/s:    " << bytes.load() / seconds / ( 1024 * 1024 ) << "\n"
+             << "latency p50:  " << percentile( 0.50 ) << " ms\n"
+             << "latency p99:  " << percentile( 0.99 ) << " ms" << std::endl;
+
+   return errors.load() ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * Compares serializing typical API responses to json through a variant, as fc::json::to_string( fc::variant( v ) )
+ * does, with writing them straight to json with fc::json_stream.
+ */
+
+#include <voilk/protocol/block.hpp>
+#include <voilk/protocol/operations.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/json_stream.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace voilk::protocol;
+
+struct history_entry
+{
+   uint32_t             block = 0;
+   transaction_id_type  trx_id;
+   uint32_t             trx_in_block = 0;
+   uint32_t             op_in_trx = 0;
+   fc::time_point_sec   timestamp;
+   operation            op;
+};
+
+FC_REFLECT( history_entry, (block)(trx_id)(trx_in_block)(op_in_trx)(timestamp)(op) )
+
+signed_transaction make_transaction( uint32_t n, const fc::ecc::private_key& key, const chain_id_type& chain_id )
+{
+   signed_transaction tx;
+   tx.ref_block_num = n & 0xffff;
+   tx.ref_block_prefix = n * 2654435761u;
+   tx.expiration = fc::time_point_sec( 1500000000 + n );
+
+   transfer_operation transfer;
+   transfer.from = "alice";
+   transfer.to = "bob" + std::to_string( n % 100 );
+   transfer.amount = asset( 1000 + n, VOILK_SYMBOL );
+   transfer.memo = "Payment #" + std::to_string( n ) + " \"with quotes\" and a\nnewline";
+   tx.operations.push_back( transfer );
+
+   comment_operation comment;
+   comment.parent_permlink = "voilk";
+   comment.author = "alice";
+   comment.permlink = "post-" + std::to_string( n );
+   comment.title = "A post title";
+   comment.body = std::string( 400, 'x' ) + "\tend";
+   comment.json_metadata = "{\"tags\":[\"voilk\",\"test\"]}";
+   tx.operations.push_back( comment );
+
+   vote_operation vote;
+   vote.voter = "carol";
+   vote.author = "alice";
+   vote.permlink = comment.permlink;
+   vote.weight = VOILK_100_PERCENT;
+   tx.operations.push_back( vote );
+
+   tx.sign( key, chain_id, fc::ecc::fc_canonical );
+   return tx;
+}
+
+template< typename T >
+void run_benchmark( const std::string& name, const T& value, uint32_t iterations )
+{
+   std::string via_variant = fc::json::to_string( fc::variant( value ) );
+   std::string direct = fc::json_stream::to_string( value );
+
+   if( via_variant != direct )
+   {
+      std::cerr << name << ": json_stream output does not match fc::json" << std::endl;
+      exit( 1 );
+   }
+
+   auto time = [&]( const std::function< size_t() >& serialize )
+   {
+      size_t bytes = 0;
+      auto start = std::chrono::steady_clock::now();
+
+      for( uint32_t i = 0; i < iterations; ++i )
+         bytes += serialize();
+
+      double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+      return bytes / seconds / ( 1024 * 1024 );
+   };
+
+   double variant_rate = time( [&]() { return fc::json::to_string( fc::variant( value ) ).size(); } );
+   double direct_rate = time( [&]() { return fc::json_stream::to_string( value ).size(); } );
+
+   std::cout << std::left << std::setw( 20 ) << name
+             << std::right << std::setw( 10 ) << direct.size() << " bytes"
+             << std::fixed << std::setprecision( 1 )
+             << std::setw( 10 ) << variant_rate << " MB/s via variant"
+             << std::setw( 10 ) << direct_rate << " MB/s direct"
+             << std::setw( 8 ) << direct_rate / variant_rate << "x" << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+   uint32_t iterations = argc > 1 ? std::stoul( argv[1] ) : 200;
+
+   auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "benchmark" ) ) );
+   chain_id_type chain_id;
+
+   signed_block block;
+   block.previous = block_id_type( "0000000100000000000000000000000000000000" );
+   block.timestamp = fc::time_point_sec( 1500000000 );
+   block.witness = "initminer";
+
+   for( uint32_t i = 0; i < 200; ++i )
+      block.transactions.push_back( make_transaction( i, key, chain_id ) );
+
+   block.transaction_merkle_root = block.calculate_merkle_root();
+   block.sign( key );
+
+   std::vector< history_entry > history;
+   for( const auto& tx : block.transactions )
+   {
+      for( uint32_t i = 0; i < tx.operations.size(); ++i )
+      {
+         history_entry e;
+         e.block = 1;
+         e.trx_id = tx.id();
+         e.trx_in_block = history.size() / 3;
+         e.op_in_trx = i;
+         e.timestamp = block.timestamp;
+         e.op = tx.operations[i];
+         history.push_back( e );
+      }
+   }
+
+   run_benchmark( "signed_block", block, iterations );
+   run_benchmark( "transactions", block.transactions, iterations );
+   run_benchmark( "account_history", history, iterations );
+
+   return 0;
+}
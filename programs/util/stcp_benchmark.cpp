@@ -0,0 +1,176 @@
+/**
+ * Measures how many MB/s one core encrypts and decrypts the p2p stream at, staged through the 4 KiB buffers stcp_socket
+ * used to have, staged through its current buffers, and in place as stcp_socket::write_frame() and read_frame() do.
+ * Then sends the same data through a pair of stcp_sockets over loopback with write()/read() and with
+ * write_frame()/read_frame().
+ *
+ * Usage: stcp_benchmark [megabytes] [frame size]
+ */
+
+#include <graphene/net/config.hpp>
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/crypto/aes.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+const fc::sha256  benchmark_key = fc::sha256::hash( std::string( "stcp_benchmark" ) );
+const fc::uint128 benchmark_iv( 0x0123456789abcdefull, 0xfedcba9876543210ull );
+
+template< typename Lambda >
+double mb_per_second( size_t bytes, Lambda&& run )
+{
+   auto start = std::chrono::steady_clock::now();
+   run();
+   double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+   return bytes / seconds / ( 1024 * 1024 );
+}
+
+// what writesome() does for every chunk of a frame
+double staged_encode( std::vector< char >& frame, size_t frames, size_t buffer_size, bool clear_buffer )
+{
+   fc::aes_encoder encoder;
+   encoder.init( benchmark_key, benchmark_iv );
+   std::vector< char > buffer( buffer_size );
+
+   return mb_per_second( frames * frame.size(), [&]()
+   {
+      for( size_t f = 0; f < frames; ++f )
+         for( size_t offset = 0; offset < frame.size(); offset += buffer_size )
+         {
+            size_t len = std::min( buffer_size, frame.size() - offset );
+            if( clear_buffer )
+               memset( buffer.data(), 0, len );
+            encoder.encode( frame.data() + offset, len, buffer.data() );
+         }
+   });
+}
+
+double in_place_encode( std::vector< char >& frame, size_t frames )
+{
+   fc::aes_encoder encoder;
+   encoder.init( benchmark_key, benchmark_iv );
+
+   return mb_per_second( frames * frame.size(), [&]()
+   {
+      for( size_t f = 0; f < frames; ++f )
+         encoder.encode( frame.data(), frame.size(), frame.data() );
+   });
+}
+
+// what readsome() does for every chunk it reads
+double staged_decode( std::vector< char >& frame, size_t frames, size_t buffer_size )
+{
+   fc::aes_decoder decoder;
+   decoder.init( benchmark_key, benchmark_iv );
+   std::vector< char > output( frame.size() );
+
+   return mb_per_second( frames * frame.size(), [&]()
+   {
+      for( size_t f = 0; f < frames; ++f )
+         for( size_t offset = 0; offset < frame.size(); offset += buffer_size )
+            decoder.decode( frame.data() + offset, std::min( buffer_size, frame.size() - offset ), output.data() + offset );
+   });
+}
+
+double in_place_decode( std::vector< char >& frame, size_t frames )
+{
+   fc::aes_decoder decoder;
+   decoder.init( benchmark_key, benchmark_iv );
+
+   return mb_per_second( frames * frame.size(), [&]()
+   {
+      for( size_t f = 0; f < frames; ++f )
+         decoder.decode( frame.data(), frame.size(), frame.data() );
+   });
+}
+
+double loopback( size_t frame_size, size_t frames, bool whole_frames )
+{
+   fc::thread reader_thread( "stcp_benchmark_reader" );
+   fc::tcp_server server;
+   uint16_t port = reader_thread.async( [&]()
+   {
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+      return server.get_port();
+   }).wait();
+
+   auto received = reader_thread.async( [&]()
+   {
+      graphene::net::stcp_socket socket;
+      server.accept( socket.get_socket() );
+      socket.accept();
+
+      std::vector< char > frame( frame_size );
+      for( size_t f = 0; f < frames; ++f )
+      {
+         if( whole_frames )
+            socket.read_frame( frame.data(), frame_size );
+         else
+            socket.read( frame.data(), frame_size );
+      }
+      socket.close();
+   });
+
+   graphene::net::stcp_socket socket;
+   socket.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), port ) );
+   std::vector< char > frame( frame_size, 'x' );
+
+   double result = mb_per_second( frames * frame_size, [&]()
+   {
+      for( size_t f = 0; f < frames; ++f )
+      {
+         if( whole_frames )
+         {
+            // message_oriented_connection copies each message into a padded frame before sending it either way
+            std::shared_ptr< char > copy( new char[ frame_size ], []( char* p ){ delete[] p; } );
+            memcpy( copy.get(), frame.data(), frame_size );
+            socket.write_frame( copy, frame_size );
+         }
+         else
+            socket.write( frame.data(), frame_size );
+      }
+      socket.flush();
+      received.wait();
+   });
+
+   socket.close();
+   server.close();
+   return result;
+}
+
+int main( int argc, char** argv )
+{
+   size_t megabytes = argc > 1 ? std::stoul( argv[1] ) : 256;
+   size_t frame_size = argc > 2 ? std::stoul( argv[2] ) : 64 * 1024;
+   frame_size = 16 * ( ( std::max< size_t >( frame_size, 16 ) + 15 ) / 16 );
+   size_t frames = std::max< size_t >( megabytes * 1024 * 1024 / frame_size, 1 );
+
+   std::vector< char > frame( frame_size, 'x' );
+
+   std::cout << std::fixed << std::setprecision( 1 )
+             << "frame size " << frame_size << " bytes, " << frames * frame_size / ( 1024 * 1024 ) << " MB\n\n"
+             << "single core MB/s\n"
+             << "  encrypt, 4 KiB staging buffer cleared per write:  " << staged_encode( frame, frames, 4096, true ) << "\n"
+             << "  encrypt, " << GRAPHENE_NET_STCP_BUFFER_SIZE / 1024 << " KiB staging buffer:                  "
+             << staged_encode( frame, frames, GRAPHENE_NET_STCP_BUFFER_SIZE, false ) << "\n"
+             << "  encrypt, whole frame in place:                    " << in_place_encode( frame, frames ) << "\n"
+             << "  decrypt, 4 KiB reads:                             " << staged_decode( frame, frames, 4096 ) << "\n"
+             << "  decrypt, " << GRAPHENE_NET_STCP_BUFFER_SIZE / 1024 << " KiB reads:                            "
+             << staged_decode( frame, frames, GRAPHENE_NET_STCP_BUFFER_SIZE ) << "\n"
+             << "  decrypt, whole frame in place:                    " << in_place_decode( frame, frames ) << "\n\n"
+             << "loopback MB/s\n"
+             << "  stcp_socket::write() / read():            " << loopback( frame_size, frames, false ) << "\n"
+             << "  stcp_socket::write_frame() / read_frame(): " << loopback( frame_size, frames, true ) << std::endl;
+
+   return 0;
+}
@@ -5,9 +5,16 @@
 #include <voilk/chain/comment_object.hpp>
 #include <voilk/protocol/voilk_operations.hpp>
 #include <voilk/plugins/json_rpc/json_rpc_plugin.hpp>
+#include <voilk/plugins/json_rpc/response_cache.hpp>
+#include <voilk/plugins/json_rpc/call_pool.hpp>
 
 #include "../db_fixture/database_fixture.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 using namespace voilk::chain;
 using namespace voilk::protocol;
 
@@ -225,6 +232,175 @@ BOOST_AUTO_TEST_CASE( misc_validation )
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( batch_validation )
+{
+   try
+   {
+      // Batches are executed in parallel, responses must still come back in request order
+      std::string request = "[";
+      for( int i = 0; i < 100; ++i )
+      {
+         if( i ) request += ",";
+
+         if( i % 2 )
+            request += "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":" + fc::to_string( i ) + "}";
+         else
+            request += "{\"jsonrpc\":\"2.0\", \"method\":\"condenser_api.get_accounts\", \"params\":[[\"initminer\"]], \"id\":\"" + fc::to_string( i ) + "\"}";
+      }
+      request += "]";
+      make_array_request( request, 0, false, false );
+
+      request = "[";
+      for( int i = 0; i < 20; ++i )
+      {
+         if( i ) request += ",";
+         request += "{\"jsonrpc\":\"2.0\", \"method\":\"fake_api.fake_method\", \"id\":" + fc::to_string( i ) + "}";
+      }
+      request += "]";
+      make_array_request( request, JSON_RPC_PARSE_PARAMS_ERROR );
+
+      request = "[{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":1}]";
+      make_array_request( request, 0, false, false );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( response_cache )
+{
+   try
+   {
+      using voilk::plugins::json_rpc::api_response_cache;
+
+      api_response_cache cache;
+      BOOST_REQUIRE( !cache.enabled() );
+      BOOST_REQUIRE( cache.find_method( "database_api.get_dynamic_global_properties" ) == nullptr );
+
+      cache.configure( 1024, { { "database_api.get_dynamic_global_properties", fc::microseconds() }, { "block_api.get_block", fc::milliseconds( 1 ) } } );
+      BOOST_REQUIRE( cache.enabled() );
+      BOOST_REQUIRE( cache.find_method( "database_api.get_dynamic_global_properties" ) != nullptr );
+      BOOST_REQUIRE( cache.find_method( "database_api.find_accounts" ) == nullptr );
+
+      BOOST_TEST_MESSAGE( "--- Results are served until the cache is invalidated" );
+      auto generation = cache.generation();
+      cache.put( "dgpo", "{\"head_block_number\":1}", generation, fc::microseconds() );
+      BOOST_REQUIRE( cache.get( "dgpo" ) );
+      BOOST_REQUIRE_EQUAL( *cache.get( "dgpo" ), "{\"head_block_number\":1}" );
+      BOOST_REQUIRE( !cache.get( "missing" ) );
+
+      cache.invalidate( 2 );
+      BOOST_REQUIRE( !cache.get( "dgpo" ) );
+
+      BOOST_TEST_MESSAGE( "--- Results computed while a block was applied are not stored" );
+      cache.put( "dgpo", "{\"head_block_number\":2}", generation, fc::microseconds() );
+      BOOST_REQUIRE( !cache.get( "dgpo" ) );
+
+      BOOST_TEST_MESSAGE( "--- Results expire after their ttl" );
+      cache.put( "block", "{}", cache.generation(), fc::milliseconds( 200 ) );
+      BOOST_REQUIRE( cache.get( "block" ) );
+      std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+      BOOST_REQUIRE( !cache.get( "block" ) );
+
+      BOOST_TEST_MESSAGE( "--- Least recently used results are evicted to stay under the memory cap" );
+      std::string big( 300, 'x' );
+      cache.put( "a", big, cache.generation(), fc::microseconds() );
+      cache.put( "b", big, cache.generation(), fc::microseconds() );
+      BOOST_REQUIRE( cache.get( "a" ) );
+      cache.put( "c", big, cache.generation(), fc::microseconds() );
+      BOOST_REQUIRE( cache.get( "a" ) );
+      BOOST_REQUIRE( !cache.get( "b" ) );
+      BOOST_REQUIRE( cache.get( "c" ) );
+
+      cache.put( "huge", std::string( 2048, 'x' ), cache.generation(), fc::microseconds() );
+      BOOST_REQUIRE( !cache.get( "huge" ) );
+
+      auto stats = cache.get_stats();
+      BOOST_REQUIRE( stats.enabled );
+      BOOST_REQUIRE_EQUAL( stats.head_block_num, 2u );
+      BOOST_REQUIRE_EQUAL( stats.entries, 2u );
+      BOOST_REQUIRE( stats.bytes <= stats.max_bytes );
+      BOOST_REQUIRE_EQUAL( stats.hits, 6u );
+      BOOST_REQUIRE_EQUAL( stats.misses, 6u );
+      BOOST_REQUIRE_EQUAL( stats.evictions, 1u );
+      BOOST_REQUIRE_EQUAL( stats.expirations, 1u );
+      BOOST_REQUIRE_EQUAL( stats.invalidations, 1u );
+
+      BOOST_TEST_MESSAGE( "--- The cache statistics are available through the API" );
+      std::string request = "{\"jsonrpc\":\"2.0\", \"method\":\"jsonrpc.get_cache_stats\", \"params\":{}, \"id\":1}";
+      auto answer = make_request( request, 0, false, false );
+      BOOST_REQUIRE( !answer[ "result" ][ "enabled" ].as_bool() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( call_pool )
+{
+   try
+   {
+      using voilk::plugins::json_rpc::api_call_pool;
+
+      api_call_pool pool( "history", 1, 1 );
+
+      std::mutex m;
+      std::condition_variable cv;
+      bool release = false;
+      std::atomic< uint32_t > started( 0 );
+
+      auto slow_call = [&]()
+      {
+         ++started;
+         std::unique_lock< std::mutex > lock( m );
+         cv.wait( lock, [&]() { return release; } );
+      };
+
+      BOOST_TEST_MESSAGE( "--- Calls beyond running + queue are rejected without running" );
+      std::atomic< uint32_t > accepted( 0 );
+      std::thread first( [&]() { accepted += pool.run( slow_call ); } );
+      while( started.load() == 0 )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+      std::thread second( [&]() { accepted += pool.run( slow_call ); } );
+      while( pool.get_stats().queued == 0 )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+      bool ran = false;
+      BOOST_REQUIRE( !pool.run( [&]() { ran = true; } ) );
+      BOOST_REQUIRE( !ran );
+
+      auto stats = pool.get_stats();
+      BOOST_REQUIRE_EQUAL( stats.running, 1u );
+      BOOST_REQUIRE_EQUAL( stats.queued, 1u );
+      BOOST_REQUIRE_EQUAL( stats.rejected, 1u );
+
+      {
+         std::lock_guard< std::mutex > lock( m );
+         release = true;
+      }
+      cv.notify_all();
+      first.join();
+      second.join();
+      BOOST_REQUIRE_EQUAL( accepted.load(), 2u );
+
+      BOOST_TEST_MESSAGE( "--- Calls run on the calling thread and their exceptions reach the caller" );
+      std::thread::id call_thread;
+      BOOST_REQUIRE( pool.run( [&]() { call_thread = std::this_thread::get_id(); } ) );
+      BOOST_REQUIRE( call_thread == std::this_thread::get_id() );
+      BOOST_REQUIRE_THROW( pool.run( []() { FC_ASSERT( false, "call failed" ); } ), fc::assert_exception );
+
+      stats = pool.get_stats();
+      BOOST_REQUIRE_EQUAL( stats.running, 0u );
+      BOOST_REQUIRE_EQUAL( stats.queued, 0u );
+      BOOST_REQUIRE_EQUAL( stats.executed, 4u );
+      BOOST_REQUIRE_EQUAL( stats.rejected, 1u );
+
+      BOOST_TEST_MESSAGE( "--- The pool statistics are available through the API" );
+      std::string request = "{\"jsonrpc\":\"2.0\", \"method\":\"jsonrpc.get_call_pool_stats\", \"params\":{}, \"id\":1}";
+      auto answer = make_request( request, 0, false, false );
+      BOOST_REQUIRE( answer[ "result" ].is_array() );
+      BOOST_REQUIRE_EQUAL( answer[ "result" ].get_array().size(), 0u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( positive_validation )
 {
    try
@@ -0,0 +1,430 @@
+#include <boost/test/unit_test.hpp>
+
+#include <voilk/protocol/voilk_operations.hpp>
+#include <voilk/plugins/json_rpc/json_rpc_plugin.hpp>
+#include <voilk/plugins/webserver/subscription_manager.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace voilk::chain;
+using namespace voilk::protocol;
+using voilk::plugins::webserver::subscription_manager;
+using voilk::plugins::webserver::websocket_server_type;
+
+/// A websocket client on its own thread that keeps every message it receives
+struct test_client
+{
+   typedef websocketpp::client< websocketpp::config::asio_client > client_type;
+
+   test_client( uint16_t port )
+   {
+      client.clear_access_channels( websocketpp::log::alevel::all );
+      client.clear_error_channels( websocketpp::log::elevel::all );
+      client.init_asio();
+
+      client.set_open_handler( [this]( websocketpp::connection_hdl )
+      {
+         std::lock_guard< std::mutex > lock( mutex );
+         opened = true;
+         cv.notify_all();
+      });
+
+      client.set_message_handler( [this]( websocketpp::connection_hdl, client_type::message_ptr msg )
+      {
+         std::lock_guard< std::mutex > lock( mutex );
+         messages.push_back( fc::json::from_string( msg->get_payload() ) );
+         cv.notify_all();
+      });
+
+      client.set_close_handler( [this]( websocketpp::connection_hdl )
+      {
+         std::lock_guard< std::mutex > lock( mutex );
+         closed = true;
+         cv.notify_all();
+      });
+
+      websocketpp::lib::error_code ec;
+      con = client.get_connection( "ws://127.0.0.1:" + std::to_string( port ), ec );
+      BOOST_REQUIRE( !ec );
+      client.connect( con );
+
+      thread = std::thread( [this]() { client.run(); } );
+      BOOST_REQUIRE( wait( [this]() { return opened; } ) );
+   }
+
+   ~test_client()
+   {
+      close();
+      thread.join();
+   }
+
+   void send( const std::string& payload )
+   {
+      con->send( payload, websocketpp::frame::opcode::text );
+   }
+
+   void close()
+   {
+      websocketpp::lib::error_code ec;
+      con->close( websocketpp::close::status::normal, "", ec );
+   }
+
+   template< typename Predicate >
+   bool wait( Predicate&& done )
+   {
+      std::unique_lock< std::mutex > lock( mutex );
+      return cv.wait_for( lock, std::chrono::seconds( 10 ), done );
+   }
+
+   bool wait_for_messages( size_t count )
+   {
+      return wait( [this, count]() { return messages.size() >= count; } );
+   }
+
+   size_t message_count()
+   {
+      std::lock_guard< std::mutex > lock( mutex );
+      return messages.size();
+   }
+
+   fc::variant message( size_t i )
+   {
+      std::lock_guard< std::mutex > lock( mutex );
+      return messages.at( i );
+   }
+
+   client_type                   client;
+   client_type::connection_ptr   con;
+   std::thread                   thread;
+
+   std::mutex                    mutex;
+   std::condition_variable       cv;
+   std::vector< fc::variant >    messages;
+   bool                          opened = false;
+   bool                          closed = false;
+};
+
+/// A websocket server that hands every message to a subscription_manager, as the webserver plugin does
+struct subscription_fixture
+{
+   subscription_fixture() :
+      work( pool_ios ),
+      manager( server, pool_ios )
+   {
+      server.clear_access_channels( websocketpp::log::alevel::all );
+      server.clear_error_channels( websocketpp::log::elevel::all );
+      server.init_asio( &server_ios );
+      server.set_reuse_addr( true );
+
+      server.set_message_handler( [this]( websocketpp::connection_hdl hdl, websocket_server_type::message_ptr msg )
+      {
+         std::string response;
+         if( manager.handle_request( hdl, msg->get_payload(), response ) )
+            server.send( hdl, response, websocketpp::frame::opcode::text );
+      });
+
+      server.set_close_handler( [this]( websocketpp::connection_hdl hdl ) { manager.remove_connection( hdl ); } );
+
+      server.listen( boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+      server.start_accept();
+
+      boost::system::error_code ec;
+      port = server.get_local_endpoint( ec ).port();
+
+      server_thread = std::thread( [this]() { server_ios.run(); } );
+      pool_thread = std::thread( [this]() { pool_ios.run(); } );
+
+      fetch_block = [this]( uint32_t num ) -> fc::optional< signed_block >
+      {
+         fetched.push_back( num );
+         if( num == 0 || num > blocks.size() )
+            return fc::optional< signed_block >();
+         return blocks[ num - 1 ];
+      };
+   }
+
+   ~subscription_fixture()
+   {
+      pool_ios.stop();
+      server_ios.stop();
+      pool_thread.join();
+      server_thread.join();
+   }
+
+   const signed_block& make_block()
+   {
+      signed_block b;
+      if( blocks.size() )
+         b.previous = blocks.back().id();
+      b.timestamp = fc::time_point_sec( 3 * ( blocks.size() + 1 ) );
+      blocks.push_back( b );
+      return blocks.back();
+   }
+
+   /// Sends the notifications database::apply_block does
+   void apply_block( const signed_block& b, const std::vector< operation >& ops = std::vector< operation >() )
+   {
+      block_notification note( b );
+      manager.on_pre_apply_block( note );
+
+      for( uint32_t i = 0; i < ops.size(); ++i )
+      {
+         operation_notification op_note( ops[i] );
+         op_note.block = note.block_num;
+         op_note.op_in_trx = i;
+         manager.on_post_apply_operation( op_note );
+      }
+
+      manager.on_post_apply_block( note );
+   }
+
+   static std::string request( uint32_t id, const std::string& method, const fc::variant_object& params )
+   {
+      return fc::json::to_string( fc::mutable_variant_object( "jsonrpc", "2.0" )( "id", id )( "method", method )( "params", params ) );
+   }
+
+   static transfer_operation transfer( const std::string& from, const std::string& to )
+   {
+      transfer_operation op;
+      op.from = from;
+      op.to = to;
+      op.amount = asset( 1, VOILK_SYMBOL );
+      return op;
+   }
+
+   boost::asio::io_service             server_ios;
+   boost::asio::io_service             pool_ios;
+   boost::asio::io_service::work       work;
+   websocket_server_type               server;
+   subscription_manager                manager;
+   uint16_t                            port = 0;
+
+   std::thread                         server_thread;
+   std::thread                         pool_thread;
+
+   std::vector< signed_block >         blocks;
+   std::vector< uint32_t >             fetched;
+   subscription_manager::block_fetcher fetch_block;
+};
+
+static std::string notice_type( const fc::variant& msg )
+{
+   BOOST_REQUIRE_EQUAL( msg[ "method" ].as_string(), "webserver.notice" );
+   return msg[ "params" ][ "type" ].as_string();
+}
+
+static uint32_t notice_block_num( const fc::variant& msg )
+{
+   return msg[ "params" ][ "result" ][ "block_num" ].as< uint32_t >();
+}
+
+BOOST_FIXTURE_TEST_SUITE( webserver_subscriptions, subscription_fixture )
+
+BOOST_AUTO_TEST_CASE( subscribe_notify_unsubscribe )
+{
+   test_client c( port );
+
+   c.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 1 ) );
+   BOOST_REQUIRE_EQUAL( c.message( 0 )[ "id" ].as< uint32_t >(), 1 );
+   BOOST_REQUIRE( c.message( 0 )[ "result" ].as< bool >() );
+
+   apply_block( make_block() );
+   BOOST_REQUIRE( c.wait_for_messages( 2 ) );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 1 ) ), "new_block" );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 1 ) ), 1 );
+   BOOST_REQUIRE( c.message( 1 )[ "params" ][ "result" ][ "block_id" ].as< block_id_type >() == blocks[0].id() );
+
+   c.send( request( 2, "webserver.subscribe", fc::mutable_variant_object( "type", "irreversible_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 3 ) );
+   BOOST_REQUIRE( c.message( 2 )[ "result" ].as< bool >() );
+
+   c.send( request( 3, "webserver.unsubscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 4 ) );
+   BOOST_REQUIRE_EQUAL( c.message( 3 )[ "id" ].as< uint32_t >(), 3 );
+   BOOST_REQUIRE( c.message( 3 )[ "result" ].as< bool >() );
+
+   // Notices are sent in order, a new_block notice for block 2 would arrive before the irreversible ones
+   apply_block( make_block() );
+   manager.on_irreversible_block( 1, fetch_block );
+   manager.on_irreversible_block( 2, fetch_block );
+   BOOST_REQUIRE( c.wait_for_messages( 6 ) );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 4 ) ), "irreversible_block" );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 4 ) ), 1 );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 5 ) ), "irreversible_block" );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 5 ) ), 2 );
+
+   // Block 1 was applied before the irreversible subscription, block 2 was kept
+   BOOST_REQUIRE( fetched == std::vector< uint32_t >{ 1 } );
+
+   c.send( request( 4, "webserver.unsubscribe", fc::mutable_variant_object( "type", "irreversible_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 7 ) );
+   BOOST_REQUIRE( c.message( 6 )[ "result" ].as< bool >() );
+
+   apply_block( make_block() );
+   manager.on_irreversible_block( 3, fetch_block );
+   c.send( request( 5, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 8 ) );
+   apply_block( make_block() );
+   BOOST_REQUIRE( c.wait_for_messages( 9 ) );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 8 ) ), 4 );
+   BOOST_REQUIRE_EQUAL( c.message_count(), 9 );
+}
+
+BOOST_AUTO_TEST_CASE( invalid_subscriptions )
+{
+   manager.max_accounts = 2;
+   test_client c( port );
+
+   c.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_blocks" ) ) );
+   c.send( request( 2, "webserver.subscribe", fc::mutable_variant_object( "type", "account_operation" ) ) );
+   c.send( request( 3, "webserver.subscribe",
+      fc::mutable_variant_object( "type", "account_operation" )( "accounts", std::vector< std::string >{ "alice", "bob", "carol" } ) ) );
+   c.send( request( 4, "webserver.subscribe",
+      fc::mutable_variant_object( "type", "account_operation" )( "accounts", std::vector< std::string >{ "alice", "bob" } ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 4 ) );
+
+   for( size_t i = 0; i < 3; ++i )
+   {
+      BOOST_REQUIRE_EQUAL( c.message( i )[ "id" ].as< uint32_t >(), i + 1 );
+      BOOST_REQUIRE_EQUAL( c.message( i )[ "error" ][ "code" ].as< int64_t >(), JSON_RPC_INVALID_PARAMS );
+   }
+
+   BOOST_REQUIRE( c.message( 3 )[ "result" ].as< bool >() );
+
+   std::string response;
+   BOOST_REQUIRE( !manager.handle_request( websocketpp::connection_hdl(),
+      request( 5, "database_api.get_dynamic_global_properties", fc::variant_object() ), response ) );
+   BOOST_REQUIRE( response.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( account_operation_notices )
+{
+   test_client c( port );
+
+   c.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   c.send( request( 2, "webserver.subscribe",
+      fc::mutable_variant_object( "type", "account_operation" )( "accounts", std::vector< std::string >{ "alice", "bob" } ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 2 ) );
+
+   // Sent once although both of its accounts are subscribed, the transfer between others is not sent at all
+   apply_block( make_block(), { transfer( "alice", "bob" ), transfer( "carol", "dave" ), transfer( "dave", "bob" ) } );
+   apply_block( make_block() );
+   BOOST_REQUIRE( c.wait_for_messages( 6 ) );
+
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 2 ) ), "new_block" );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 3 ) ), "account_operation" );
+   BOOST_REQUIRE_EQUAL( c.message( 3 )[ "params" ][ "result" ][ "block" ].as< uint32_t >(), 1 );
+   BOOST_REQUIRE_EQUAL( c.message( 3 )[ "params" ][ "result" ][ "op_in_trx" ].as< uint32_t >(), 0 );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 4 ) ), "account_operation" );
+   BOOST_REQUIRE_EQUAL( c.message( 4 )[ "params" ][ "result" ][ "op_in_trx" ].as< uint32_t >(), 2 );
+   BOOST_REQUIRE_EQUAL( notice_type( c.message( 5 ) ), "new_block" );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 5 ) ), 2 );
+
+   c.send( request( 3, "webserver.unsubscribe",
+      fc::mutable_variant_object( "type", "account_operation" )( "accounts", std::vector< std::string >{ "alice" } ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 7 ) );
+   BOOST_REQUIRE( c.message( 6 )[ "result" ].as< bool >() );
+
+   apply_block( make_block(), { transfer( "alice", "carol" ), transfer( "carol", "bob" ) } );
+   apply_block( make_block() );
+   BOOST_REQUIRE( c.wait_for_messages( 10 ) );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 7 ) ), 3 );
+   BOOST_REQUIRE_EQUAL( c.message( 8 )[ "params" ][ "result" ][ "op_in_trx" ].as< uint32_t >(), 1 );
+   BOOST_REQUIRE_EQUAL( notice_block_num( c.message( 9 ) ), 4 );
+   BOOST_REQUIRE_EQUAL( c.message_count(), 10 );
+}
+
+BOOST_AUTO_TEST_CASE( recent_blocks_are_capped )
+{
+   manager.max_recent_blocks = 2;
+   test_client c( port );
+
+   c.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "irreversible_block" ) ) );
+   BOOST_REQUIRE( c.wait_for_messages( 1 ) );
+
+   for( int i = 0; i < 5; ++i )
+      apply_block( make_block() );
+
+   for( uint32_t num = 1; num <= 5; ++num )
+      manager.on_irreversible_block( num, fetch_block );
+
+   BOOST_REQUIRE( c.wait_for_messages( 6 ) );
+
+   for( uint32_t num = 1; num <= 5; ++num )
+   {
+      BOOST_REQUIRE_EQUAL( notice_type( c.message( num ) ), "irreversible_block" );
+      BOOST_REQUIRE_EQUAL( notice_block_num( c.message( num ) ), num );
+   }
+
+   // Only the two most recent blocks were kept, the others were read back
+   BOOST_REQUIRE( fetched == std::vector< uint32_t >( { 1, 2, 3 } ) );
+}
+
+BOOST_AUTO_TEST_CASE( connection_closed_during_notifications )
+{
+   test_client a( port );
+   test_client b( port );
+
+   a.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   b.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( a.wait_for_messages( 1 ) );
+   BOOST_REQUIRE( b.wait_for_messages( 1 ) );
+
+   // a closes while notices for it are queued on the strand and in its send buffer
+   for( int i = 0; i < 50; ++i )
+   {
+      apply_block( make_block() );
+      if( i == 10 )
+         a.close();
+   }
+
+   BOOST_REQUIRE( a.wait( [&a]() { return a.closed; } ) );
+
+   for( int i = 0; i < 10; ++i )
+      apply_block( make_block() );
+
+   BOOST_REQUIRE( b.wait_for_messages( 61 ) );
+   for( uint32_t num = 1; num <= 60; ++num )
+      BOOST_REQUIRE_EQUAL( notice_block_num( b.message( num ) ), num );
+
+   size_t received = a.message_count();
+   BOOST_REQUIRE( received < 61 );
+   for( uint32_t num = 1; num < received; ++num )
+      BOOST_REQUIRE_EQUAL( notice_block_num( a.message( num ) ), num );
+}
+
+BOOST_AUTO_TEST_CASE( slow_subscriber_is_closed )
+{
+   test_client a( port );
+   test_client b( port );
+
+   a.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( a.wait_for_messages( 1 ) );
+
+   // No notice fits, so the subscriber is closed instead of queueing it
+   manager.max_buffered_bytes = 1;
+   apply_block( make_block() );
+
+   BOOST_REQUIRE( a.wait( [&a]() { return a.closed; } ) );
+   BOOST_REQUIRE_EQUAL( a.con->get_remote_close_code(), websocketpp::close::status::try_again_later );
+   BOOST_REQUIRE_EQUAL( a.message_count(), 1 );
+
+   // The closed subscriber is forgotten, others can subscribe and are sent notices
+   manager.max_buffered_bytes = 16 * 1024 * 1024;
+   b.send( request( 1, "webserver.subscribe", fc::mutable_variant_object( "type", "new_block" ) ) );
+   BOOST_REQUIRE( b.wait_for_messages( 1 ) );
+   apply_block( make_block() );
+   BOOST_REQUIRE( b.wait_for_messages( 2 ) );
+   BOOST_REQUIRE_EQUAL( notice_block_num( b.message( 1 ) ), 2 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
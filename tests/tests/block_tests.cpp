@@ -26,9 +26,12 @@
 
 #include <voilk/protocol/exceptions.hpp>
 
+#include <voilk/chain/compressed_block_log.hpp>
+#include <voilk/chain/database_exceptions.hpp>
 #include <voilk/chain/database.hpp>
 #include <voilk/chain/voilk_objects.hpp>
 #include <voilk/chain/history_object.hpp>
+#include <voilk/chain/util/prevalidate.hpp>
 
 #include <voilk/plugins/account_history/account_history_plugin.hpp>
 
@@ -38,6 +41,9 @@
 
 #include "../db_fixture/database_fixture.hpp"
 
+#include <fstream>
+#include <limits>
+
 using namespace voilk;
 using namespace voilk::chain;
 using namespace voilk::protocol;
@@ -174,6 +180,254 @@ BOOST_AUTO_TEST_CASE( undo_block )
    }
 }
 
+BOOST_AUTO_TEST_CASE( pipelined_reindex )
+{
+   try {
+      fc::temp_directory data_dir( voilk::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      uint32_t last_irreversible_num = 0;
+      block_id_type last_irreversible_id;
+
+      {
+         database db;
+         db._log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+
+         for( uint32_t i = 0; i < 200; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+         last_irreversible_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+         last_irreversible_id = db.get_block_id_for_num( last_irreversible_num );
+         db.close();
+      }
+
+      {
+         database db;
+         db._log_hardforks = false;
+
+         database::open_args args;
+         args.data_dir = data_dir.path();
+         args.shared_mem_dir = data_dir.path();
+         args.initial_supply = INITIAL_TEST_SUPPLY;
+         args.shared_file_size = TEST_SHARED_MEM_SIZE;
+         args.replay_queue_depth = 16;
+         args.replay_decode_threads = 3;
+
+         BOOST_REQUIRE_EQUAL( db.reindex( args ), last_irreversible_num );
+         BOOST_REQUIRE( db.head_block_id() == last_irreversible_id );
+         db.close();
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_round_trip )
+{
+   try {
+      fc::temp_directory data_dir( voilk::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( voilk::utilities::temp_directory_path() );
+      fc::temp_directory shared_mem_dir( voilk::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      uint32_t last_irreversible_num = 0;
+      block_id_type last_irreversible_id;
+      asset current_supply;
+
+      {
+         database db;
+         db._log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+
+         for( uint32_t i = 0; i < 200; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+         last_irreversible_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+         last_irreversible_id = db.get_block_id_for_num( last_irreversible_num );
+         db.close();
+      }
+
+      database::open_args args;
+      args.data_dir = data_dir.path();
+      args.shared_mem_dir = data_dir.path();
+      args.initial_supply = INITIAL_TEST_SUPPLY;
+      args.shared_file_size = TEST_SHARED_MEM_SIZE;
+
+      // Snapshot the state at block 100, then replay the rest of the block log on top of it
+      {
+         database db;
+         db._log_hardforks = false;
+         args.stop_replay_at = 100;
+         BOOST_REQUIRE_EQUAL( db.reindex( args ), 100 );
+
+         db.export_snapshot( snapshot_dir.path(), 4 );
+         VOILK_REQUIRE_THROW( db.export_snapshot( snapshot_dir.path(), 4 ), fc::exception );
+
+         args.stop_replay_at = 0;
+         BOOST_REQUIRE_EQUAL( db.reindex( args ), last_irreversible_num );
+         current_supply = db.get_dynamic_global_properties().current_supply;
+         db.close();
+      }
+
+      {
+         database db;
+         db._log_hardforks = false;
+         args.shared_mem_dir = shared_mem_dir.path();
+         args.snapshot_dir = snapshot_dir.path();
+         args.snapshot_threads = 4;
+
+         BOOST_REQUIRE_EQUAL( db.load_snapshot( args ), last_irreversible_num );
+         BOOST_REQUIRE( db.head_block_id() == last_irreversible_id );
+         BOOST_REQUIRE( db.get_dynamic_global_properties().current_supply == current_supply );
+         BOOST_REQUIRE_EQUAL( db.revision(), last_irreversible_num );
+         db.validate_invariants();
+
+         // The loaded state keeps accepting blocks
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         BOOST_REQUIRE_EQUAL( db.head_block_num(), last_irreversible_num + 1 );
+         db.close();
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( checkpointed_blocks_commit_undo )
+{
+   try {
+      fc::temp_directory data_dir1( voilk::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( voilk::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+
+      database db1;
+      db1._log_hardforks = false;
+      open_test_database( db1, data_dir1.path() );
+      database db2;
+      db2._log_hardforks = false;
+      open_test_database( db2, data_dir2.path() );
+
+      std::vector< signed_block > blocks;
+      for( uint32_t i = 0; i < 12; ++i )
+         blocks.push_back( db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing ) );
+
+      flat_map< uint32_t, block_id_type > checkpoints;
+      checkpoints[ 10 ] = blocks[ 9 ].id();
+      db2.add_checkpoints( checkpoints );
+
+      for( uint32_t i = 0; i < 5; ++i )
+         PUSH_BLOCK( db2, blocks[i] );
+
+      // A bad block between checkpoints is rolled back instead of leaving the state half applied
+      signed_block bad_block = blocks[5];
+      bad_block.transaction_merkle_root = checksum_type::hash( string( "bad" ) );
+      BOOST_REQUIRE_THROW( PUSH_BLOCK( db2, bad_block ), fc::exception );
+      BOOST_REQUIRE( db2.head_block_id() == blocks[4].id() );
+      BOOST_REQUIRE_EQUAL( db2.revision(), 5 );
+
+      for( uint32_t i = 5; i < 10; ++i )
+      {
+         PUSH_BLOCK( db2, blocks[i] );
+         BOOST_REQUIRE( !db2.is_undo_disabled() );
+      }
+
+      // The undo history of checkpointed blocks is committed, but the revision still follows the head block
+      BOOST_REQUIRE_EQUAL( db2.head_block_num(), 10 );
+      BOOST_REQUIRE_EQUAL( db2.revision(), 10 );
+
+      // Blocks after the last checkpoint can be popped again
+      PUSH_BLOCK( db2, blocks[10] );
+      BOOST_REQUIRE_EQUAL( db2.revision(), 11 );
+      db2.pop_block();
+      BOOST_REQUIRE( db2.head_block_id() == blocks[9].id() );
+
+      PUSH_BLOCK( db2, blocks[10] );
+      PUSH_BLOCK( db2, blocks[11] );
+      BOOST_REQUIRE( db2.head_block_id() == db1.head_block_id() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( compressed_block_log_round_trip )
+{
+   try {
+      fc::temp_directory data_dir( voilk::utilities::temp_directory_path() );
+      std::vector< signed_block > blocks;
+
+      {
+         block_log log;
+         log.open( data_dir.path() / "block_log" );
+
+         block_id_type previous;
+         for( uint32_t i = 0; i < 250; ++i )
+         {
+            signed_block b;
+            b.previous = previous;
+            b.witness = "initminer";
+            b.timestamp = fc::time_point_sec( VOILK_TESTING_GENESIS_TIMESTAMP + i * VOILK_BLOCK_INTERVAL );
+            log.append( b );
+            previous = b.id();
+            blocks.push_back( b );
+         }
+         log.flush();
+
+         compressed_block_log_writer writer( data_dir.path() / "block_log.compressed", 16 );
+         for( uint32_t i = 1; i <= blocks.size(); ++i )
+            writer.append_raw( i, log.read_raw_block_by_num( i ) );
+         writer.close();
+      }
+
+      compressed_block_log log;
+      log.open( data_dir.path() / "block_log.compressed" );
+      BOOST_REQUIRE_EQUAL( log.head_block_num(), blocks.size() );
+      BOOST_REQUIRE( !log.read_block_by_num( 0 ).valid() );
+      BOOST_REQUIRE( !log.read_block_by_num( blocks.size() + 1 ).valid() );
+
+      // Read out of order to exercise the chunk index rather than the cached chunk
+      for( uint32_t i = 0; i < blocks.size(); ++i )
+      {
+         uint32_t block_num = ( i * 37 ) % blocks.size() + 1;
+         auto b = log.read_block_by_num( block_num );
+         BOOST_REQUIRE( b.valid() );
+         BOOST_REQUIRE( b->id() == blocks[ block_num - 1 ].id() );
+      }
+
+      // The index can be rebuilt from the log alone
+      log.close();
+      fc::remove( data_dir.path() / "block_log.compressed.index" );
+      log.open( data_dir.path() / "block_log.compressed" );
+      BOOST_REQUIRE_EQUAL( log.head_block_num(), blocks.size() );
+      BOOST_REQUIRE( log.read_block_by_num( 17 )->id() == blocks[ 16 ].id() );
+
+      // An empty index is rebuilt too instead of opening the log without blocks
+      log.close();
+      std::ofstream( ( data_dir.path() / "block_log.compressed.index" ).generic_string(), std::ios::binary | std::ios::trunc );
+      log.open( data_dir.path() / "block_log.compressed" );
+      BOOST_REQUIRE_EQUAL( log.head_block_num(), blocks.size() );
+
+      // A chunk position past the end of the log fails the read of that chunk only
+      log.close();
+      {
+         std::fstream index( ( data_dir.path() / "block_log.compressed.index" ).generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         uint64_t pos = std::numeric_limits< uint64_t >::max() - 4;
+         index.write( (char*)&pos, sizeof( pos ) );
+      }
+      log.open( data_dir.path() / "block_log.compressed" );
+      VOILK_REQUIRE_THROW( log.read_block_by_num( 1 ), fc::exception );
+      BOOST_REQUIRE( log.read_block_by_num( 17 )->id() == blocks[ 16 ].id() );
+
+      // So does a chunk that does not decompress, here the zlib header of the first chunk is overwritten
+      log.close();
+      fc::remove( data_dir.path() / "block_log.compressed.index" );
+      {
+         std::fstream file( ( data_dir.path() / "block_log.compressed" ).generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         file.seekp( 4 * sizeof( uint32_t ) + 2 * sizeof( uint32_t ) );
+         file.write( "\0\0", 2 );
+      }
+      log.open( data_dir.path() / "block_log.compressed" );
+      BOOST_REQUIRE_EQUAL( log.head_block_num(), blocks.size() );
+      VOILK_REQUIRE_THROW( log.read_block_by_num( 1 ), fc::exception );
+      BOOST_REQUIRE( log.read_block_by_num( 17 )->id() == blocks[ 16 ].id() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( fork_blocks )
 {
    try {
@@ -521,6 +775,203 @@ BOOST_FIXTURE_TEST_CASE( double_sign_check, clean_database_fixture )
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_FIXTURE_TEST_CASE( recovered_signature_keys, clean_database_fixture )
+{ try {
+   generate_block();
+   ACTORS( (alice)(bob) );
+   fund( "alice", 10000 );
+
+   auto& cache = db->get_signature_key_cache();
+   cache.clear();
+
+   transfer_operation t;
+   t.from = "alice";
+   t.to = "bob";
+   t.amount = asset( 1000, VOILK_SYMBOL );
+   trx.operations.push_back( t );
+   trx.set_expiration( db->head_block_time() + VOILK_MAX_TIME_UNTIL_EXPIRATION );
+   trx.validate();
+
+   BOOST_TEST_MESSAGE( "Verify that transactions with invalid signatures are not cached" );
+   sign( trx, alice_private_key );
+   sign( trx, alice_private_key );
+   cache.recover( trx, db->get_chain_id() );
+   BOOST_REQUIRE_EQUAL( cache.size(), 0u );
+   VOILK_REQUIRE_THROW( db->push_transaction( trx, 0 ), tx_duplicate_sig );
+   BOOST_REQUIRE_EQUAL( cache.size(), 0u );
+   trx.signatures.pop_back();
+
+   BOOST_TEST_MESSAGE( "Verify that keys are not handed out for different signatures" );
+   cache.recover( trx, db->get_chain_id() );
+   BOOST_REQUIRE_EQUAL( cache.size(), 1u );
+   auto other_sigs = trx.signatures;
+   other_sigs[0] = bob_private_key.sign_compact( trx.sig_digest( db->get_chain_id() ) );
+   BOOST_REQUIRE( !cache.get( trx.id(), other_sigs, fc::ecc::non_canonical ).valid() );
+
+   BOOST_TEST_MESSAGE( "Verify that cached keys match the keys recovered on the write thread" );
+   auto keys = cache.get( trx.id(), trx.signatures, fc::ecc::non_canonical );
+   BOOST_REQUIRE( keys.valid() );
+   BOOST_REQUIRE( *keys == trx.get_signature_keys( db->get_chain_id(), fc::ecc::non_canonical ) );
+
+   BOOST_TEST_MESSAGE( "Verify that pushing a transaction fills the cache and block application hits it" );
+   cache.clear();
+   auto stats = cache.get_stats();
+   db->push_transaction( trx, 0 );
+   BOOST_REQUIRE_EQUAL( cache.size(), 1u );
+   BOOST_REQUIRE_EQUAL( cache.get_stats().misses, stats.misses + 1 );
+
+   auto bob_balance = db->get_account( "bob" ).balance;
+   auto old_skip = default_skip;
+   default_skip &= ~database::skip_authority_check;
+   generate_block();
+   default_skip = old_skip;
+   BOOST_REQUIRE( db->get_account( "bob" ).balance == bob_balance );
+   BOOST_REQUIRE_GT( cache.get_stats().hits, stats.hits );
+   BOOST_REQUIRE_EQUAL( cache.get_stats().misses, stats.misses + 1 );
+
+   BOOST_TEST_MESSAGE( "Verify that the least recently used keys are evicted" );
+   cache.set_max_size( 2 );
+   signed_transaction trx2 = trx;
+   trx2.set_expiration( trx.expiration - 1 );
+   signed_transaction trx3 = trx;
+   trx3.set_expiration( trx.expiration - 2 );
+   cache.recover( trx2, db->get_chain_id() );
+   BOOST_REQUIRE( cache.get( trx.id(), trx.signatures, fc::ecc::non_canonical ).valid() );
+   cache.recover( trx3, db->get_chain_id() );
+   BOOST_REQUIRE_EQUAL( cache.size(), 2u );
+   BOOST_REQUIRE( cache.get( trx.id(), trx.signatures, fc::ecc::non_canonical ).valid() );
+   BOOST_REQUIRE( !cache.get( trx2.id(), trx2.signatures, fc::ecc::non_canonical ).valid() );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( prevalidated_transactions, clean_database_fixture )
+{ try {
+   generate_block();
+   ACTORS( (alice)(bob) );
+   fund( "alice", 10000 );
+   generate_block();
+
+   auto& cache = db->get_signature_key_cache();
+   cache.clear();
+
+   fc::time_point_sec head_time = db->head_block_time();
+   uint32_t max_block_size = db->get_dynamic_global_properties().maximum_block_size;
+   size_t pending = db->_pending_tx.size();
+
+   transfer_operation t;
+   t.from = "alice";
+   t.to = "bob";
+   t.amount = asset( 1000, VOILK_SYMBOL );
+
+   auto prevalidate = [&]( const signed_transaction& tx, uint32_t block_size )
+   {
+      voilk::chain::util::prevalidate_transaction( tx, db->get_chain_id(), head_time, block_size, cache );
+   };
+
+   BOOST_TEST_MESSAGE( "Verify that invalid operations are rejected" );
+   signed_transaction tx;
+   tx.operations.push_back( t );
+   tx.operations.back().get< transfer_operation >().amount = asset( 0, VOILK_SYMBOL );
+   tx.set_expiration( head_time + VOILK_MAX_TIME_UNTIL_EXPIRATION );
+   sign( tx, alice_private_key );
+   VOILK_REQUIRE_THROW( prevalidate( tx, max_block_size ), fc::assert_exception );
+
+   BOOST_TEST_MESSAGE( "Verify that expired transactions and those expiring too late are rejected" );
+   tx.clear();
+   tx.operations.push_back( t );
+   tx.set_expiration( head_time - 1 );
+   sign( tx, alice_private_key );
+   VOILK_REQUIRE_THROW( prevalidate( tx, max_block_size ), transaction_expiration_exception );
+   tx.set_expiration( head_time + VOILK_MAX_TIME_UNTIL_EXPIRATION + 1 );
+   tx.signatures.clear();
+   sign( tx, alice_private_key );
+   VOILK_REQUIRE_THROW( prevalidate( tx, max_block_size ), transaction_expiration_exception );
+
+   BOOST_TEST_MESSAGE( "Verify that transactions too large for a block are rejected" );
+   tx.set_expiration( head_time + VOILK_MAX_TIME_UNTIL_EXPIRATION );
+   tx.signatures.clear();
+   sign( tx, alice_private_key );
+   VOILK_REQUIRE_THROW( prevalidate( tx, 256 + fc::raw::pack_size( tx ) - 1 ), fc::assert_exception );
+
+   BOOST_REQUIRE_EQUAL( cache.size(), 0u );
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), pending );
+
+   BOOST_TEST_MESSAGE( "Verify that a valid transaction is applied with skip_validate using the recovered keys" );
+   prevalidate( tx, 256 + fc::raw::pack_size( tx ) );
+   BOOST_REQUIRE_EQUAL( cache.size(), 1u );
+
+   auto stats = cache.get_stats();
+   auto bob_balance = db->get_account( "bob" ).balance;
+   db->push_transaction( tx, database::skip_validate );
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), pending + 1 );
+   BOOST_REQUIRE( db->get_account( "bob" ).balance == bob_balance + t.amount );
+   BOOST_REQUIRE_EQUAL( cache.get_stats().hits, stats.hits + 1 );
+   BOOST_REQUIRE_EQUAL( cache.get_stats().misses, stats.misses );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( pending_transaction_backlog, clean_database_fixture )
+{ try {
+   generate_block();
+   ACTORS( (alice)(bob) );
+   fund( "alice", 10000 );
+   generate_block();
+
+   BOOST_TEST_MESSAGE( "Include six transfers in a block and pop it" );
+   transfer_operation t;
+   t.from = "alice";
+   t.to = "bob";
+   t.amount = asset( 1, VOILK_SYMBOL );
+
+   fc::time_point_sec head_time = db->head_block_time();
+   for( int i = 0; i < 6; ++i )
+   {
+      signed_transaction tx;
+      tx.operations.push_back( t );
+      // The first one expires with the block replacing the popped one
+      tx.set_expiration( i == 0 ? head_time + VOILK_BLOCK_INTERVAL : head_time + VOILK_MAX_TIME_UNTIL_EXPIRATION - i );
+      sign( tx, alice_private_key );
+      db->push_transaction( tx, 0 );
+   }
+
+   generate_block();
+   BOOST_REQUIRE_EQUAL( db->fetch_block_by_number( db->head_block_num() )->transactions.size(), 6u );
+   db->pop_block();
+   BOOST_REQUIRE_EQUAL( db->_popped_tx.size(), 6u );
+
+   BOOST_TEST_MESSAGE( "Verify that only two of them are applied again with the next block" );
+   db->set_pending_transaction_reapply_limit( 2 );
+   auto stats = db->get_pending_transaction_stats();
+   generate_block();
+   BOOST_REQUIRE_EQUAL( db->fetch_block_by_number( db->head_block_num() )->transactions.size(), 0u );
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 2u );
+   BOOST_REQUIRE_EQUAL( db->pending_transaction_backlog_size(), 3u );
+   BOOST_REQUIRE_EQUAL( db->get_pending_transaction_stats().reapplied, stats.reapplied + 2 );
+   BOOST_REQUIRE_EQUAL( db->get_pending_transaction_stats().dropped_expired, stats.dropped_expired + 1 );
+
+   BOOST_TEST_MESSAGE( "Verify that the backlog is applied in batches" );
+   BOOST_REQUIRE_EQUAL( db->apply_pending_transaction_backlog( 2 ), 1u );
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 4u );
+
+   BOOST_TEST_MESSAGE( "Verify that generated blocks include the backlog" );
+   generate_block();
+   BOOST_REQUIRE_EQUAL( db->fetch_block_by_number( db->head_block_num() )->transactions.size(), 5u );
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 0u );
+   BOOST_REQUIRE_EQUAL( db->pending_transaction_backlog_size(), 0u );
+   BOOST_REQUIRE_EQUAL( db->get_pending_transaction_stats().dropped_included, stats.dropped_included + 5 );
+   BOOST_REQUIRE_EQUAL( db->get_pending_transaction_stats().failed, stats.failed );
+
+   BOOST_TEST_MESSAGE( "Verify that clear_pending() drops the backlog" );
+   db->pop_block();
+   generate_block();
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 2u );
+   BOOST_REQUIRE_EQUAL( db->pending_transaction_backlog_size(), 3u );
+   db->clear_pending();
+   BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 0u );
+   BOOST_REQUIRE_EQUAL( db->pending_transaction_backlog_size(), 0u );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE( pop_block_twice, clean_database_fixture )
 {
    try
@@ -32,16 +32,62 @@
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/elliptic.hpp>
+#include <fc/io/json_fast.hpp>
+#include <fc/io/json_stream.hpp>
 #include <fc/reflect/variant.hpp>
 
 #include "../db_fixture/database_fixture.hpp"
 
 #include <cmath>
+#include <cstring>
+#include <random>
 
 using namespace voilk;
 using namespace voilk::chain;
 using namespace voilk::protocol;
 
+// The type and value of every node of v, so parsers that agree on the json text still differ here when one of
+// them returns an int64 where the other returns a uint64 or a double
+static std::string describe_variant( const fc::variant& v )
+{
+   switch( v.get_type() )
+   {
+      case fc::variant::null_type:
+         return "null";
+      case fc::variant::int64_type:
+         return "int64 " + std::to_string( v.as_int64() );
+      case fc::variant::uint64_type:
+         return "uint64 " + std::to_string( v.as_uint64() );
+      case fc::variant::double_type:
+      {
+         double d = v.as_double();
+         uint64_t bits;
+         memcpy( &bits, &d, sizeof( bits ) );
+         return "double " + std::to_string( bits );
+      }
+      case fc::variant::bool_type:
+         return v.as_bool() ? "true" : "false";
+      case fc::variant::string_type:
+         return "string " + std::to_string( v.get_string().size() ) + " " + v.get_string();
+      case fc::variant::array_type:
+      {
+         std::string result = "[";
+         for( const auto& item : v.get_array() )
+            result += describe_variant( item ) + ",";
+         return result + "]";
+      }
+      case fc::variant::object_type:
+      {
+         std::string result = "{";
+         for( const auto& entry : v.get_object() )
+            result += entry.key() + "=" + describe_variant( entry.value() ) + ",";
+         return result + "}";
+      }
+      default:
+         return "blob";
+   }
+}
+
 BOOST_FIXTURE_TEST_SUITE( serialization_tests, clean_database_fixture )
 
    /*
@@ -392,6 +438,140 @@ BOOST_AUTO_TEST_CASE( json_tests )
    }
 }
 
+BOOST_AUTO_TEST_CASE( json_stream_test )
+{
+   try
+   {
+      // json_stream must produce exactly what json::to_string produces from a variant
+      auto check = []( const auto& v )
+      {
+         BOOST_CHECK_EQUAL( fc::json_stream::to_string( v ), fc::json::to_string( fc::variant( v ) ) );
+         BOOST_CHECK_EQUAL( fc::json_stream::to_string( v, fc::json::legacy_generator ), fc::json::to_string( fc::variant( v ), fc::json::legacy_generator ) );
+      };
+
+      signed_transaction tx;
+      tx.set_expiration( db->head_block_time() + VOILK_MAX_TIME_UNTIL_EXPIRATION );
+
+      transfer_operation transfer;
+      transfer.from = "alice";
+      transfer.to = "bob";
+      transfer.amount = asset( 123456789, VOILK_SYMBOL );
+      transfer.memo = "quote \" backslash \\ newline \n tab \t bell \a unit \x1f del \x7f utf8 \xc3\xbc";
+      tx.operations.push_back( transfer );
+
+      comment_operation comment;
+      comment.author = "alice";
+      comment.permlink = "test";
+      comment.parent_permlink = "test";
+      comment.title = "{\"json\":[1,2,3]}";
+      comment.body = std::string( "nul \0 byte", 11 );
+      tx.operations.push_back( comment );
+      tx.sign( init_account_priv_key, db->get_chain_id(), fc::ecc::fc_canonical );
+
+      signed_block block;
+      block.witness = "initminer";
+      block.timestamp = db->head_block_time();
+      block.transactions.push_back( tx );
+      block.transactions.push_back( tx );
+
+      check( tx );
+      check( block );
+      check( voilk::plugins::condenser_api::legacy_signed_transaction( tx ) );
+      check( db->get_dynamic_global_properties() );
+      check( db->get_account( "initminer" ) );
+      check( authority::owner );
+
+      std::map< std::string, uint64_t > string_map = { { "small", 1 }, { "large", uint64_t( 0xffffffff ) + 1 } };
+      std::map< uint32_t, std::string > int_map = { { 1, "one" }, { 2, "two" } };
+      flat_map< account_name_type, int64_t > flat = { { "alice", -( int64_t( 0xffffffff ) + 1 ) }, { "bob", int64_t( 0xffffffff ) + 1 } };
+      std::vector< fc::optional< int32_t > > optionals = { 1, fc::optional< int32_t >(), -1 };
+      std::pair< double, bool > pair( 0.5, true );
+      std::vector< char > bytes = { 'a', 'b', '\0' };
+
+      check( string_map );
+      check( int_map );
+      check( flat );
+      check( optionals );
+      check( pair );
+      check( bytes );
+      check( fc::variant() );
+      check( std::vector< std::string >() );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( json_fast_parser_test )
+{
+   try
+   {
+      // The fast parser must return exactly what the legacy parser returns, or throw exactly what it throws
+      auto parse = []( const std::string& s, fc::json::parse_type ptype ) -> std::string
+      {
+         try
+         {
+            return describe_variant( fc::json::from_string( s, ptype ) ) + ( fc::json::is_valid( s, ptype ) ? " valid" : " invalid" );
+         }
+         catch( const fc::exception& e )
+         {
+            return "error " + std::to_string( e.code() ) + " " + e.to_string();
+         }
+      };
+
+      std::vector< std::string > corpus = {
+         "{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":\"e\\\\f\\\"g\\n\\t\\r\\u0041\\/\"}}", "[]", "{}", "  [ 1 , , 2 ,]  ", "{,\"a\":true,,}",
+         "-1", "-0", "0", "007", "1.5", "-.5", ".5", "5.", "-", "-.", ".", "1e5", "1.2.3", "123456789012345678", "1234567890123456789",
+         "12345678901234567890", "123456789012345678901", "-9223372036854775808", "-9223372036854775809",
+         "9223372036854775807", "9223372036854775808", "18446744073709551615", "18446744073709551616", "-123456789012345678",
+         "-1234567890123456789", "[9223372036854775807,9223372036854775808,-9223372036854775808,18446744073709551615,-0.0,0.1,-1]",
+         "{\"a\":-42,\"b\":42,\"c\":4.2,\"d\":\"42\",\"e\":18446744073709551615}", "[-1e5,1.5e3,-007,-0,-00]",
+         "null", "true", "false", "nul", "truex", "truee", "nullnull", "\"abc", "\"a\\", "\"\x04\"", "{\"a\" 1}", "{\"a\":1", "[1,2",
+         "{\"a\":1}garbage", "\"x\" y", "[\"\\u00e9\", \"\xc3\xa9\"]", "{a:1}", "[1,{\"x\":[null,false,{\"y\":-3.25}]}]", "\t\r\n 42 ", "",
+         "{\"a\":1,\"a\":2}", std::string( "[1\0 2]", 6 ), "[0x10]", "{\"k\":\"" + std::string( 100, 'z' ) + "\\\\" + std::string( 40, 'q' ) + "\"}",
+         std::string( 99, '[' ) + std::string( 99, ']' ), std::string( 100, '[' ) + std::string( 100, ']' ), "{\"[[[\":\"]]]\"}",
+         fc::json::to_string( db->get_dynamic_global_properties() ), fc::json::to_string( db->get_account( "initminer" ) )
+      };
+
+      // Random edits of the corpus with json punctuation make up a small fuzz corpus
+      std::mt19937 rng( 0 );
+      const char alphabet_chars[] = "{}[]\",:\\ \t\n-.0123456789eEntrufalsx\x04\x01\x80";
+      const std::string alphabet( alphabet_chars, sizeof( alphabet_chars ) - 1 );
+      size_t base = corpus.size();
+
+      for( size_t i = 0; i < 5000; ++i )
+      {
+         std::string s = corpus[ rng() % base ];
+
+         for( uint32_t edits = 1 + rng() % 4; edits > 0; --edits )
+         {
+            size_t pos = rng() % ( s.size() + 1 );
+            char c = alphabet[ rng() % alphabet.size() ];
+
+            switch( rng() % 3 )
+            {
+               case 0: s.insert( pos, 1, c ); break;
+               case 1: if( pos < s.size() ) s.erase( pos, 1 ); break;
+               default: if( pos < s.size() ) s[ pos ] = c; break;
+            }
+         }
+
+         corpus.push_back( s );
+      }
+
+      auto max_level = fc::json_fast::max_simd_level();
+      for( int level = fc::json_fast::scalar; level <= max_level; ++level )
+      {
+         fc::json_fast::set_simd_level( fc::json_fast::simd_level( level ) );
+         BOOST_TEST_MESSAGE( "Testing simd level " << level );
+
+         for( const auto& s : corpus )
+            BOOST_REQUIRE_EQUAL( parse( s, fc::json::fast_parser ), parse( s, fc::json::legacy_parser ) );
+      }
+
+      fc::json_fast::set_simd_level( max_level );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( extended_private_key_type_test )
 {
    try